@@ -0,0 +1,27 @@
+#ifndef UDCHUNKPOOL_H
+#define UDCHUNKPOOL_H
+//
+// Copyright (c) Euclideon Pty Ltd
+//
+// Recycles fixed size chunks for udChunkedArray so arrays that are repeatedly built and torn down don't go back to the system allocator
+// Freed chunks are cached in one of several shards, each thread sticks to its own shard so it gets back the chunks it last freed (still warm in cache)
+//
+
+#include "udResult.h"
+#include "udChunkedArray.h"
+
+struct udChunkPool;
+
+// Create a pool handing out chunks of up to chunkSize bytes, at most maxCachedChunks freed chunks are kept before they go back to the system
+udResult udChunkPool_Create(udChunkPool **ppPool, size_t chunkSize, uint32_t maxCachedChunks = 256);
+
+// Destroy the pool and free its cached chunks, every array using the pool must be deinitialised first
+void udChunkPool_Destroy(udChunkPool **ppPool);
+
+// Allocator to pass to udChunkedArray::Init, requests larger than the pool's chunk size fall through to udAlloc
+udChunkAllocator *udChunkPool_GetAllocator(udChunkPool *pPool);
+
+// Number of freed chunks currently cached across all shards
+uint32_t udChunkPool_GetCachedCount(udChunkPool *pPool);
+
+#endif // UDCHUNKPOOL_H
@@ -11,6 +11,14 @@
 #include "udPlatform.h"
 #include "udResult.h"
 
+// --------------------------------------------------------------------------
+// Optional source of chunk memory for udChunkedArray (see udChunkPool.h), chunkSize is always passed back on free
+struct udChunkAllocator
+{
+  void *(*pAllocChunk)(udChunkAllocator *pAllocator, size_t chunkSize);
+  void (*pFreeChunk)(udChunkAllocator *pAllocator, void *pChunk, size_t chunkSize);
+};
+
 // --------------------------------------------------------------------------
 template <typename T>
 struct udChunkedArrayIterator
@@ -27,7 +35,7 @@ struct udChunkedArrayIterator
 template <typename T>
 struct udChunkedArray
 {
-  udResult Init(size_t chunkElementCount);
+  udResult Init(size_t chunkElementCount, udChunkAllocator *pChunkAllocator = nullptr); // Chunks come from pChunkAllocator if set, otherwise udAlloc
   udResult Deinit();
   udResult Clear();
 
@@ -55,6 +63,10 @@ struct udChunkedArray
 
   udResult ToArray(T *pArray, size_t arrayLength, size_t startIndex = 0, size_t count = 0) const; // Copy elements to an array supplied by caller
   udResult ToArray(T **ppArray, size_t startIndex = 0, size_t count = 0) const;                   // Copy elements to an array allocated and returned to caller
+  udResult CopyFrom(const T *pArray, size_t startIndex, size_t count);                            // Overwrite existing elements from an array supplied by caller
+  udResult AppendRange(const T *pArray, size_t count);                                             // Push back a copy of count elements from an array supplied by caller
+  udResult Fill(const T &value, size_t startIndex = 0, size_t count = 0);                          // Set a range of elements (count of 0 is to the end) to value
+  udResult Sort(int (*pCompare)(const void *pA, const void *pB));                                   // Sort all elements in place with a qsort style comparison (heapsort when spread over chunks, not stable)
 
   udResult GrowBack(size_t numberOfNewElements); // Push back a number of new elements, zeroing the memory
   udResult ReserveBack(size_t newCapacity);      // Reserve memory for a given number of elements without changing 'length'  NOTE: Does not reduce in size
@@ -76,10 +88,15 @@ struct udChunkedArray
   T **ppChunks;
   size_t ptrArraySize;
   size_t chunkElementCount;
+  size_t chunkElementShift; // log2(chunkElementCount), chunk sizes are powers of two so indexing never needs a divide
   size_t chunkCount;
 
   size_t length;
   size_t inset;
+  udChunkAllocator *pChunkAllocator;
+
+  T *AllocChunk();
+  void FreeChunk(T *pChunk);
 };
 
 // --------------------------------------------------------------------------
@@ -115,13 +132,15 @@ bool udChunkedArrayIterator<T>::operator!=(const udChunkedArrayIterator<T> &rhs)
 // --------------------------------------------------------------------------
 // Author: David Ely, May 2015
 template <typename T>
-inline udResult udChunkedArray<T>::Init(size_t a_chunkElementCount)
+inline udResult udChunkedArray<T>::Init(size_t a_chunkElementCount, udChunkAllocator *a_pChunkAllocator /*= nullptr*/)
 {
   udResult result = udR_Success;
   size_t c = 0;
 
+  pChunkAllocator = a_pChunkAllocator;
   ppChunks = nullptr;
   chunkElementCount = 0;
+  chunkElementShift = 0;
   chunkCount = 0;
   length = 0;
   inset = 0;
@@ -130,6 +149,8 @@ inline udResult udChunkedArray<T>::Init(size_t a_chunkElementCount)
   UD_ERROR_IF(!a_chunkElementCount || (a_chunkElementCount & (a_chunkElementCount - 1)), udR_InvalidParameter_);
 
   chunkElementCount = a_chunkElementCount;
+  while (((size_t)1 << chunkElementShift) < chunkElementCount)
+    ++chunkElementShift;
   chunkCount = 1;
 
   if (chunkCount > ptrArrayInc)
@@ -142,7 +163,7 @@ inline udResult udChunkedArray<T>::Init(size_t a_chunkElementCount)
 
   for (; c < chunkCount; ++c)
   {
-    ppChunks[c] = udAllocType(T, chunkElementCount, udAF_None);
+    ppChunks[c] = AllocChunk();
     UD_ERROR_NULL(ppChunks[c], udR_MemoryAllocationFailure);
   }
 
@@ -150,7 +171,7 @@ epilogue:
   if (result != udR_Success)
   {
     for (size_t i = 0; i < c; ++i)
-      udFree(ppChunks[i]);
+      FreeChunk(ppChunks[i]);
     udFree(ppChunks);
   }
 
@@ -163,7 +184,7 @@ template <typename T>
 inline udResult udChunkedArray<T>::Deinit()
 {
   for (size_t c = 0; c < chunkCount; ++c)
-    udFree(ppChunks[c]);
+    FreeChunk(ppChunks[c]);
 
   udFree(ppChunks);
 
@@ -185,6 +206,31 @@ inline udResult udChunkedArray<T>::Clear()
   return udR_Success;
 }
 
+// --------------------------------------------------------------------------
+template <typename T>
+inline T *udChunkedArray<T>::AllocChunk()
+{
+  if (pChunkAllocator)
+    return (T*)pChunkAllocator->pAllocChunk(pChunkAllocator, sizeof(T) * chunkElementCount);
+
+  return udAllocType(T, chunkElementCount, udAF_None);
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline void udChunkedArray<T>::FreeChunk(T *pChunk)
+{
+  if (pChunkAllocator)
+  {
+    if (pChunk)
+      pChunkAllocator->pFreeChunk(pChunkAllocator, pChunk, sizeof(T) * chunkElementCount);
+  }
+  else
+  {
+    udFree(pChunk);
+  }
+}
+
 // --------------------------------------------------------------------------
 // Author: David Ely, May 2015
 template <typename T>
@@ -208,7 +254,7 @@ inline udResult udChunkedArray<T>::AddChunks(size_t numberOfNewChunks)
 
   for (size_t c = chunkCount; c < newChunkCount; ++c)
   {
-    ppChunks[c] = udAllocType(T, chunkElementCount, udAF_None);
+    ppChunks[c] = AllocChunk();
     if (!ppChunks[c])
     {
       chunkCount = c;
@@ -230,23 +276,23 @@ inline udResult udChunkedArray<T>::GrowBack(size_t numberOfNewElements)
 
   size_t oldLength = inset + length;
   size_t newLength = oldLength + numberOfNewElements;
-  size_t prevUsedChunkCount = (oldLength + chunkElementCount - 1) / chunkElementCount;
+  size_t prevUsedChunkCount = (oldLength + chunkElementCount - 1) >> chunkElementShift;
 
   udResult res = ReserveBack(length + numberOfNewElements);
   if (res != udR_Success)
     return res;
 
   // Zero new elements
-  size_t newUsedChunkCount = (newLength + chunkElementCount - 1) / chunkElementCount;
+  size_t newUsedChunkCount = (newLength + chunkElementCount - 1) >> chunkElementShift;
   size_t usedChunkDelta = newUsedChunkCount - prevUsedChunkCount;
-  size_t head = oldLength % chunkElementCount;
+  size_t head = oldLength & (chunkElementCount - 1);
 
   if (usedChunkDelta)
   {
     if (head)
       memset(&ppChunks[prevUsedChunkCount - 1][head], 0, (chunkElementCount - head) * sizeof(T));
 
-    size_t tail = newLength % chunkElementCount;
+    size_t tail = newLength & (chunkElementCount - 1);
 
     for (size_t chunkIndex = prevUsedChunkCount; chunkIndex < (newUsedChunkCount - 1 + !tail); ++chunkIndex)
       memset(ppChunks[chunkIndex], 0, sizeof(T) * chunkElementCount);
@@ -273,7 +319,7 @@ inline udResult udChunkedArray<T>::ReserveBack(size_t newCapacity)
   size_t oldCapacity = chunkElementCount * chunkCount - inset;
   if (newCapacity > oldCapacity)
   {
-    size_t newChunksCount = (newCapacity - oldCapacity + chunkElementCount - 1) / chunkElementCount;
+    size_t newChunksCount = (newCapacity - oldCapacity + chunkElementCount - 1) >> chunkElementShift;
     res = AddChunks(newChunksCount);
   }
   return res;
@@ -286,8 +332,8 @@ inline T &udChunkedArray<T>::operator[](size_t index)
 {
   UDASSERT(index < length, "Index out of bounds");
   index += inset;
-  size_t chunkIndex = index / chunkElementCount;
-  return ppChunks[chunkIndex][index % chunkElementCount];
+  size_t chunkIndex = index >> chunkElementShift;
+  return ppChunks[chunkIndex][index & (chunkElementCount - 1)];
 }
 
 // --------------------------------------------------------------------------
@@ -297,8 +343,8 @@ inline const T &udChunkedArray<T>::operator[](size_t index) const
 {
   UDASSERT(index < length, "Index out of bounds");
   index += inset;
-  size_t chunkIndex = index / chunkElementCount;
-  return ppChunks[chunkIndex][index % chunkElementCount];
+  size_t chunkIndex = index >> chunkElementShift;
+  return ppChunks[chunkIndex][index & (chunkElementCount - 1)];
 }
 
 // --------------------------------------------------------------------------
@@ -308,8 +354,8 @@ inline T* udChunkedArray<T>::GetElement(size_t index)
 {
   UDASSERT(index < length, "Index out of bounds");
   index += inset;
-  size_t chunkIndex = index / chunkElementCount;
-  return &ppChunks[chunkIndex][index % chunkElementCount];
+  size_t chunkIndex = index >> chunkElementShift;
+  return &ppChunks[chunkIndex][index & (chunkElementCount - 1)];
 }
 
 // --------------------------------------------------------------------------
@@ -319,8 +365,8 @@ inline const T* udChunkedArray<T>::GetElement(size_t index) const
 {
   UDASSERT(index < length, "Index out of bounds");
   index += inset;
-  size_t chunkIndex = index / chunkElementCount;
-  return &ppChunks[chunkIndex][index % chunkElementCount];
+  size_t chunkIndex = index >> chunkElementShift;
+  return &ppChunks[chunkIndex][index & (chunkElementCount - 1)];
 }
 
 // --------------------------------------------------------------------------
@@ -350,8 +396,8 @@ inline void udChunkedArray<T>::SetElement(size_t index, const T &data)
 {
   UDASSERT(index < length, "Index out of bounds");
   index += inset;
-  size_t chunkIndex = index / chunkElementCount;
-  ppChunks[chunkIndex][index % chunkElementCount] = data;
+  size_t chunkIndex = index >> chunkElementShift;
+  ppChunks[chunkIndex][index & (chunkElementCount - 1)] = data;
 }
 
 // --------------------------------------------------------------------------
@@ -366,9 +412,9 @@ inline udResult udChunkedArray<T>::PushBack(T **ppElement)
     return res;
 
   size_t newIndex = inset + length;
-  size_t chunkIndex = size_t(newIndex / chunkElementCount);
+  size_t chunkIndex = size_t(newIndex >> chunkElementShift);
 
-  *ppElement = ppChunks[chunkIndex] + (newIndex % chunkElementCount);
+  *ppElement = ppChunks[chunkIndex] + (newIndex & (chunkElementCount - 1));
 
   ++length;
   return udR_Success;
@@ -443,7 +489,7 @@ inline udResult udChunkedArray<T>::PushFront(T **ppElement)
       }
       else
       {
-        T *pNewBlock = udAllocType(T, chunkElementCount, udAF_None);
+        T *pNewBlock = AllocChunk();
         if (!pNewBlock)
         {
           memmove(ppChunks, ppChunks + 1, chunkCount * sizeof(T*));
@@ -557,11 +603,11 @@ inline void udChunkedArray<T>::RemoveAt(size_t index)
   {
     index += inset;
 
-    size_t chunkIndex = index / chunkElementCount;
+    size_t chunkIndex = index >> chunkElementShift;
 
     // Move within the chunk of the remove item
-    if ((index % chunkElementCount) != (chunkElementCount - 1)) // If there are items after the remove item
-      memmove(&ppChunks[chunkIndex][index % chunkElementCount], &ppChunks[chunkIndex][(index + 1) % chunkElementCount], sizeof(T) * (chunkElementCount - 1 - (index % chunkElementCount)));
+    if ((index & (chunkElementCount - 1)) != (chunkElementCount - 1)) // If there are items after the remove item
+      memmove(&ppChunks[chunkIndex][index & (chunkElementCount - 1)], &ppChunks[chunkIndex][(index + 1) & (chunkElementCount - 1)], sizeof(T) * (chunkElementCount - 1 - (index & (chunkElementCount - 1))));
 
     // Handle middle chunks
     for (size_t i = (chunkIndex + 1); i < (chunkCount - 1); ++i)
@@ -580,7 +626,7 @@ inline void udChunkedArray<T>::RemoveAt(size_t index)
       memcpy(&ppChunks[chunkCount - 2][chunkElementCount - 1], &ppChunks[chunkCount - 1][0], sizeof(T));
 
       // Move remaining items
-      memmove(&ppChunks[chunkCount - 1][0], &ppChunks[chunkCount - 1][1], sizeof(T) * ((length + (inset - 1)) % chunkElementCount));
+      memmove(&ppChunks[chunkCount - 1][0], &ppChunks[chunkCount - 1][1], sizeof(T) * ((length + (inset - 1)) & (chunkElementCount - 1)));
     }
 
     PopBack();
@@ -658,6 +704,126 @@ epilogue:
   return result;
 }
 
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udChunkedArray<T>::CopyFrom(const T *pArray, size_t startIndex, size_t count)
+{
+  udResult result;
+
+  UD_ERROR_IF(startIndex > length || count > (length - startIndex), udR_OutOfRange);
+  UD_ERROR_IF(pArray == nullptr && count > 0, udR_InvalidParameter_);
+  while (count)
+  {
+    size_t runLen = GetElementRunLength(startIndex);
+    if (runLen > count)
+      runLen = count;
+    memcpy(GetElement(startIndex), pArray, runLen * sizeof(T));
+    pArray += runLen;
+    startIndex += runLen;
+    count -= runLen;
+  }
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udChunkedArray<T>::AppendRange(const T *pArray, size_t count)
+{
+  udResult result;
+  size_t startIndex = length;
+
+  UD_ERROR_IF(pArray == nullptr && count > 0, udR_InvalidParameter_);
+  UD_ERROR_CHECK(ReserveBack(length + count));
+
+  length += count;
+  UD_ERROR_CHECK(CopyFrom(pArray, startIndex, count));
+
+epilogue:
+  return result;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udChunkedArray<T>::Fill(const T &value, size_t startIndex, size_t count)
+{
+  udResult result;
+
+  UD_ERROR_IF(startIndex > length, udR_OutOfRange);
+  if (count == 0)
+    count = length - startIndex;
+  UD_ERROR_IF(count > (length - startIndex), udR_OutOfRange);
+  while (count)
+  {
+    size_t runLen = GetElementRunLength(startIndex);
+    if (runLen > count)
+      runLen = count;
+    T *pRun = GetElement(startIndex);
+    for (size_t i = 0; i < runLen; ++i)
+      pRun[i] = value;
+    startIndex += runLen;
+    count -= runLen;
+  }
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udChunkedArray<T>::Sort(int (*pCompare)(const void *pA, const void *pB))
+{
+  udResult result;
+
+  UD_ERROR_NULL(pCompare, udR_InvalidParameter_);
+
+  if (GetElementRunLength(0) == length)
+  {
+    // Everything is contiguous already, sort it where it is
+    if (length > 1)
+      qsort(GetElement(0), length, sizeof(T), pCompare);
+  }
+  else
+  {
+    // Heapsort through operator[] so nothing larger than one element is ever allocated
+    for (size_t end = length, start = length / 2; end > 1; )
+    {
+      size_t root;
+      if (start > 0)
+      {
+        root = --start; // Still building the heap
+      }
+      else
+      {
+        --end; // Move the largest to the end, then restore the heap below it
+        T temp = (*this)[0];
+        (*this)[0] = (*this)[end];
+        (*this)[end] = temp;
+        root = 0;
+      }
+
+      for (size_t child = root * 2 + 1; child < end; child = root * 2 + 1)
+      {
+        if (child + 1 < end && pCompare(GetElement(child), GetElement(child + 1)) < 0)
+          ++child;
+        if (pCompare(GetElement(root), GetElement(child)) >= 0)
+          break;
+        T temp = (*this)[root];
+        (*this)[root] = (*this)[child];
+        (*this)[child] = temp;
+        root = child;
+      }
+    }
+  }
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
 // --------------------------------------------------------------------------
 // Author: Dave Pevreal, May 2018
 template <typename T>
@@ -710,7 +876,7 @@ inline size_t udChunkedArray<T>::GetElementRunLength(size_t index, bool elements
 {
   if (index < length)
   {
-    size_t indexInChunk = ((index + inset) % chunkElementCount);
+    size_t indexInChunk = ((index + inset) & (chunkElementCount - 1));
     if (elementsBehind)
       return ((index + inset) >= chunkElementCount) ? indexInChunk : (indexInChunk - inset);
     size_t runLength = chunkElementCount - indexInChunk;
@@ -732,7 +898,7 @@ inline typename udChunkedArray<T>::iterator udChunkedArray<T>::begin()
 template <typename T>
 inline typename udChunkedArray<T>::iterator udChunkedArray<T>::end()
 {
-  return udChunkedArray<T>::iterator{ &ppChunks[(inset + length) / chunkElementCount], (inset + length) % chunkElementCount, chunkElementCount };
+  return udChunkedArray<T>::iterator{ &ppChunks[(inset + length) >> chunkElementShift], (inset + length) & (chunkElementCount - 1), chunkElementCount };
 }
 
 #endif // UDCHUNKEDARRAY_H
@@ -0,0 +1,272 @@
+#ifndef UDCONCURRENTCHUNKEDARRAY_H
+#define UDCONCURRENTCHUNKEDARRAY_H
+//
+// Copyright (c) Euclideon Pty Ltd
+//
+// Append-only chunked array that many threads can push to while other threads read what has been published
+// Writers claim slots by advancing the reserved length without a lock, chunks are added under a lock that is only taken once per chunk
+// Appends are not lock-free: publishing is in reservation order, so a writer spin-waits (then yields) until every earlier writer has published
+// The chunk pointer array is republished (not reallocated in place) when it grows, so readers never see it freed underneath them
+// Lengths are 32-bit as claiming slots needs a compare-exchange and only udInterlockedAdd64 exists at 64-bit, not udInterlockedCompareExchange
+//
+
+#include "udPlatform.h"
+#include "udResult.h"
+#include "udChunkedArray.h"
+#include "udThread.h"
+
+template <typename T>
+struct udConcurrentChunkedArray
+{
+  udResult Init(size_t chunkElementCount); // Not thread safe
+  udResult Deinit();                       // Not thread safe
+
+  // Thread safe, these don't return until every earlier push has published, so a stalled writer holds up later ones
+  udResult PushBack(const T &v, size_t *pIndex = nullptr);
+  udResult AppendRange(const T *pArray, size_t count, size_t *pFirstIndex = nullptr); // The range is contiguous in the array
+
+  // Number of elements readers can safely access, elements before this never change
+  size_t GetPublishedLength() const;
+
+  // Only valid for index < GetPublishedLength() (or for an index the calling thread has pushed)
+  T &operator[](size_t index);
+  const T &operator[](size_t index) const;
+  T *GetElement(size_t index);
+  const T *GetElement(size_t index) const;
+
+  // At element index, return the number of published elements including index that follow in the same chunk
+  size_t GetElementRunLength(size_t index) const;
+  size_t ChunkElementCount() const { return chunkElementCount; }
+
+  enum { ptrArrayInc = 32 };
+
+  T **ppChunks; // Replaced as a whole when it grows, reads are ordered by the barriers around capacity and publishedLength
+  size_t ptrArraySize; // Only accessed with pGrowMutex held
+  size_t chunkElementCount;
+  size_t chunkElementShift;
+
+  volatile int32_t capacity;        // Elements covered by allocated chunks
+  volatile int32_t reservedLength;  // Slots claimed by writers
+  volatile int32_t publishedLength; // Slots written, always <= reservedLength
+
+  udMutex *pGrowMutex;
+  udChunkedArray<T**> retiredPtrArrays; // Replaced pointer arrays, readers may still be using them so they're freed in Deinit
+
+  udResult Grow(int32_t requiredCapacity);
+};
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udConcurrentChunkedArray<T>::Init(size_t a_chunkElementCount)
+{
+  udResult result;
+
+  ppChunks = nullptr;
+  ptrArraySize = 0;
+  chunkElementCount = 0;
+  chunkElementShift = 0;
+  capacity = 0;
+  reservedLength = 0;
+  publishedLength = 0;
+  pGrowMutex = nullptr;
+
+  UD_ERROR_CHECK(retiredPtrArrays.Init(ptrArrayInc));
+
+  // Must be power of 2.
+  UD_ERROR_IF(!a_chunkElementCount || (a_chunkElementCount & (a_chunkElementCount - 1)) || a_chunkElementCount > INT32_MAX, udR_InvalidParameter_);
+  chunkElementCount = a_chunkElementCount;
+  while (((size_t)1 << chunkElementShift) < chunkElementCount)
+    ++chunkElementShift;
+
+  pGrowMutex = udCreateMutex();
+  UD_ERROR_NULL(pGrowMutex, udR_MemoryAllocationFailure);
+
+epilogue:
+  if (result != udR_Success)
+    retiredPtrArrays.Deinit();
+
+  return result;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udConcurrentChunkedArray<T>::Deinit()
+{
+  size_t chunkCount = (size_t)capacity >> chunkElementShift;
+  for (size_t c = 0; c < chunkCount; ++c)
+    udFree(ppChunks[c]);
+  udFree(ppChunks);
+
+  T **ppRetired;
+  while (retiredPtrArrays.PopBack(&ppRetired))
+    udFree(ppRetired);
+  retiredPtrArrays.Deinit();
+
+  udDestroyMutex(&pGrowMutex);
+
+  capacity = 0;
+  reservedLength = 0;
+  publishedLength = 0;
+
+  return udR_Success;
+}
+
+// --------------------------------------------------------------------------
+// Adds chunks until requiredCapacity elements are covered, only one thread grows the array at a time
+template <typename T>
+inline udResult udConcurrentChunkedArray<T>::Grow(int32_t requiredCapacity)
+{
+  udResult result = udR_Success;
+  udMutex *pMutex = udLockMutex(pGrowMutex);
+
+  UD_ERROR_NULL(pMutex, udR_NotInitialized_);
+
+  while (capacity < requiredCapacity)
+  {
+    size_t chunkIndex = (size_t)capacity >> chunkElementShift;
+
+    if (chunkIndex == ptrArraySize)
+    {
+      // Readers may be part way through a lookup in the old array, so publish a copy and retire the old one
+      size_t newPtrArraySize = udMax(ptrArraySize * 2, (size_t)ptrArrayInc);
+      T **ppNewChunks = udAllocType(T*, newPtrArraySize, udAF_Zero);
+      UD_ERROR_NULL(ppNewChunks, udR_MemoryAllocationFailure);
+
+      if (ppChunks)
+      {
+        memcpy(ppNewChunks, ppChunks, ptrArraySize * sizeof(T*));
+        result = retiredPtrArrays.PushBack(ppChunks);
+        if (result != udR_Success)
+          udFree(ppNewChunks);
+        UD_ERROR_HANDLE();
+      }
+
+      udMemoryBarrier();
+      ppChunks = ppNewChunks;
+      ptrArraySize = newPtrArraySize;
+    }
+
+    T *pChunk = udAllocType(T, chunkElementCount, udAF_None);
+    UD_ERROR_NULL(pChunk, udR_MemoryAllocationFailure);
+    ppChunks[chunkIndex] = pChunk;
+
+    udMemoryBarrier(); // The chunk pointer must be visible before the capacity that covers it
+    capacity = capacity + (int32_t)chunkElementCount;
+  }
+
+epilogue:
+  udReleaseMutex(pMutex);
+
+  return result;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udConcurrentChunkedArray<T>::PushBack(const T &v, size_t *pIndex)
+{
+  return AppendRange(&v, 1, pIndex);
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udConcurrentChunkedArray<T>::AppendRange(const T *pArray, size_t count, size_t *pFirstIndex)
+{
+  udResult result;
+  int32_t firstIndex;
+
+  UD_ERROR_IF(pArray == nullptr && count > 0, udR_InvalidParameter_);
+  UD_ERROR_IF(count > (size_t)INT32_MAX, udR_CountExceeded);
+
+  // Capacity is made sure of before the slots are claimed, so a claimed slot can never fail to be written
+  firstIndex = reservedLength;
+  for (;;)
+  {
+    UD_ERROR_IF(firstIndex > INT32_MAX - (int32_t)count, udR_CountExceeded);
+    if (firstIndex + (int32_t)count > capacity)
+      UD_ERROR_CHECK(Grow(firstIndex + (int32_t)count));
+
+    int32_t previous = udInterlockedCompareExchange(&reservedLength, firstIndex + (int32_t)count, firstIndex);
+    if (previous == firstIndex)
+      break;
+    firstIndex = previous;
+  }
+
+  for (size_t index = (size_t)firstIndex, remaining = count; remaining > 0;)
+  {
+    size_t runLength = udMin(chunkElementCount - (index & (chunkElementCount - 1)), remaining);
+    memcpy(&ppChunks[index >> chunkElementShift][index & (chunkElementCount - 1)], pArray, runLength * sizeof(T));
+    pArray += runLength;
+    index += runLength;
+    remaining -= runLength;
+  }
+
+  // Publish in order, waiting for any earlier writers to publish first
+  for (int spinCount = 0; publishedLength != firstIndex; ++spinCount)
+  {
+    if (spinCount < 1000)
+      udSpinPause();
+    else
+      udYield();
+  }
+  udMemoryBarrier(); // The elements must be visible before the length that covers them
+  publishedLength = firstIndex + (int32_t)count;
+
+  if (pFirstIndex)
+    *pFirstIndex = (size_t)firstIndex;
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline size_t udConcurrentChunkedArray<T>::GetPublishedLength() const
+{
+  size_t length = (size_t)publishedLength;
+  udMemoryBarrier(); // Reads of the elements mustn't be done before the length
+  return length;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline T &udConcurrentChunkedArray<T>::operator[](size_t index)
+{
+  return *GetElement(index);
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline const T &udConcurrentChunkedArray<T>::operator[](size_t index) const
+{
+  return *GetElement(index);
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline T *udConcurrentChunkedArray<T>::GetElement(size_t index)
+{
+  UDASSERT(index < (size_t)reservedLength, "Index out of bounds");
+  return &ppChunks[index >> chunkElementShift][index & (chunkElementCount - 1)];
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline const T *udConcurrentChunkedArray<T>::GetElement(size_t index) const
+{
+  UDASSERT(index < (size_t)reservedLength, "Index out of bounds");
+  return &ppChunks[index >> chunkElementShift][index & (chunkElementCount - 1)];
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline size_t udConcurrentChunkedArray<T>::GetElementRunLength(size_t index) const
+{
+  size_t length = GetPublishedLength();
+  if (index >= length)
+    return 0;
+
+  return udMin(chunkElementCount - (index & (chunkElementCount - 1)), length - index);
+}
+
+#endif // UDCONCURRENTCHUNKEDARRAY_H
@@ -70,6 +70,7 @@ udResult udCryptoCipher_Create(udCryptoCipherContext **ppCtx, udCryptoCiphers ci
 udResult udCrypto_CreateIVForCTRMode(udCryptoCipherContext *pCtx, udCryptoIV *pIV, uint64_t nonce, uint64_t counter);
 
 // Encrypt/decrypt using current mode/iv/nonce. Optional pOutIV arameter only applicable to CBC mode
+// A CTR mode context isn't modified by these, so any number of threads can use it at once
 udResult udCryptoCipher_Encrypt(udCryptoCipherContext *pCtx, const udCryptoIV *pIV, const void *pPlainText, size_t plainTextLen, void *pCipherText, size_t cipherTextLen, size_t *pPaddedCipherTextLen = nullptr, udCryptoIV *pOutIV = nullptr);
 udResult udCryptoCipher_Decrypt(udCryptoCipherContext *pCtx, const udCryptoIV *pIV, const void *pCipherText, size_t cipherTextLen, void *pPlainText, size_t plainTextLen, size_t *pActualPlainTextLen = nullptr, udCryptoIV *pOutIV = nullptr);
 
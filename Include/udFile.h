@@ -17,13 +17,16 @@
 #include "udCompression.h"
 
 struct udFile;
+struct udWorkerPool;
 enum udFileOpenFlags
 {
   udFOF_Read  = 1,
   udFOF_Write = 2,
   udFOF_Create = 4,
-  udFOF_Multithread = 8,
-  udFOF_FastOpen = 16   // No checks performed, file length not supported. Currently functional for FILE (deferred open) and HTTP (stateless)
+  udFOF_Multithread = 8, // Safe to use from multiple threads. Local files use pread/pwrite where available so reads don't serialize
+  udFOF_FastOpen = 16,  // No checks performed, file length not supported. Currently functional for FILE (deferred open) and HTTP (stateless)
+  udFOF_MemoryMap = 32, // Map local files into memory when reading only, reads don't lock and udFile_Borrow is supported. Falls back to FILE where mapping isn't available
+  udFOF_Cache = 64      // Read through the block cache shared by handles with the same filename (see udFile_ConfigureCache). Ignored when writing or if the cache isn't configured
 };
 // Inline of operator to allow flags to be combined and retain type-safety
 inline udFileOpenFlags operator|(udFileOpenFlags a, udFileOpenFlags b) { return (udFileOpenFlags)(int(a) | int(b)); }
@@ -38,7 +41,16 @@ enum udFileSeekWhence
 // An opaque structure to hold state for the underlying file handler to process a pipelined request
 struct udFilePipelinedRequest
 {
-  uint64_t reserved[6];
+  uint64_t reserved[6]; // Handlers may use the first 4, the rest are used by udFile (to decrypt encrypted requests)
+};
+
+// A single read for udFile_ReadV
+struct udFileReadRequest
+{
+  void *pBuffer;
+  size_t bufferLength;
+  int64_t seekOffset;  // Relative to the seek base, as with udFSW_SeekSet
+  size_t *pActualRead; // Optional, as with udFile_Read it's an error to read less than bufferLength when this is null
 };
 
 // A structure to return performance info about a given file
@@ -47,9 +59,12 @@ struct udFilePerformance
   uint64_t throughput;
   float mbPerSec;
   int requestsInFlight;
+  uint64_t cacheHits;   // Blocks found in the cache, for files opened with udFOF_Cache
+  uint64_t cacheMisses; // Blocks read from the handler to add to the cache
 };
 
 // Load an entire file, appending a nul terminator. Calls Open/Read/Close internally.
+// Doesn't use the block cache or its read-ahead, the file is read in one request where the length is known (udImage_Load is the same)
 udResult udFile_Load(const char *pFilename, void **ppMemory, int64_t *pFileLengthInBytes = nullptr);
 
 template<typename T>
@@ -76,15 +91,38 @@ const char *udFile_GetFilename(udFile *pFile);
 // Get performance information
 udResult udFile_GetPerformance(udFile *pFile, udFilePerformance *pPerformance);
 
+// Set the block size and memory budget of the cache used by files opened with udFOF_Cache, a budget of zero frees the cache
+// Sequential reads on those files grow a read-ahead window, fetched in the background if also opened with udFOF_Multithread
+// To read ahead on a scan, open with udFOF_Read | udFOF_Cache (| udFOF_Multithread) and udFile_Read in order rather than using udFile_Load
+// Not thread safe with opening files, and returns udR_NotAllowed while any files using the cache are open
+udResult udFile_ConfigureCache(size_t blockSize, size_t memoryBudget);
+
+// Set a worker pool that large encrypted reads are decrypted on, in slices alongside the reading thread. Null (the default) decrypts on the reading thread only
+// The pool must outlive any reads, and isn't owned by udFile
+void udFile_SetWorkerPool(udWorkerPool *pPool);
+
 // Seek and read some data
 udResult udFile_Read(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t seekOffset = 0, udFileSeekWhence seekWhence = udFSW_SeekCur, size_t *pActualRead = nullptr, int64_t *pFilePos = nullptr, udFilePipelinedRequest *pPipelinedRequest = nullptr);
 
+// Perform a batch of reads, requests that are adjacent in the file are combined into a single read by the handler
+// The file position is left at the end of the last request
+udResult udFile_ReadV(udFile *pFile, const udFileReadRequest *pRequests, size_t count);
+
+// Get a pointer to length bytes at seekOffset (relative to the seek base) without copying, valid until the file is closed
+// The file position isn't changed. Returns udR_Unsupported if the handler can't (or the file is encrypted), in which case use udFile_Read
+udResult udFile_Borrow(udFile *pFile, const void **ppData, size_t length, int64_t seekOffset, size_t *pActualLength = nullptr);
+
 // Seek and write some data
 udResult udFile_Write(udFile *pFile, const void *pBuffer, size_t bufferLength, int64_t seekOffset = 0, udFileSeekWhence seekWhence = udFSW_SeekCur, size_t *pActualWritten = nullptr, int64_t *pFilePos = nullptr);
 
 // Receive the data for a piped request, returning an error if attempting to receive pipelined requests out of order
+// Every pipelined request must be received. Local files opened with udFOF_Multithread read asynchronously and can be received in any order
 udResult udFile_BlockForPipelinedRequest(udFile *pFile, udFilePipelinedRequest *pPipelinedRequest, size_t *pActualRead = nullptr);
 
+// Set how many pipelined reads on local udFOF_Multithread files can be outstanding at once (default 8, at most 255)
+// Each is a thread blocked in pread as io_uring isn't supported. Returns udR_NotAllowed while any files have pipelined reads open
+udResult udFile_ConfigureAsyncReads(int queueDepth);
+
 // Release the underlying file handle (optional) to be re-opened upon next use - used to have more open files than internal (o/s) limits would otherwise allow
 udResult udFile_Release(udFile *pFile);
 
@@ -98,6 +136,10 @@ udResult udFile_TranslatePath(const char **ppNewPath, const char *pPath);
 // Optional handlers (optional as it requires networking libraries, WS2_32.lib on Windows platform)
 udResult udFile_RegisterHTTP();
 
+// Set the most connections multithreaded HTTP files keep to each host, and how long unused connections are kept open
+// Reads on a multithreaded file each lease their own connection (pipelined requests use the file's own), a maximum of zero turns this off so reads share the file's connection
+udResult udFile_ConfigureHTTPConnections(int maxConnectionsPerHost, int idleTimeoutMs);
+
 // Helper function to output a raw filename for a given buffer to ppResultFilename, or debug output if ppResultFilename is null (line-breaking at charsPerLine characters)
 udResult udFile_GenerateRawFilename(const char **ppResultFilename, const void *pBuffer, size_t bufferLen, udCompressionType ct = udCT_None, const char *pOriginalFilename = nullptr, size_t allocationSize = 0, uint32_t charsPerLine = 64);
 
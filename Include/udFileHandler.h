@@ -28,6 +28,13 @@ typedef udResult udFile_LoadHandlerFunc(udFile *pFile, void **ppBuffer, int64_t
 // Perform a seek followed by read
 typedef udResult udFile_SeekReadHandlerFunc(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t seekOffset, size_t *pActualRead, udFilePipelinedRequest *pPipelinedRequest);
 
+// Perform a batch of reads (optional, a loop over SeekRead is used otherwise), the seek offsets already include the seek base
+// Each element of pActualReads is set with the amount read for the matching request
+typedef udResult udFile_ReadVHandlerFunc(udFile *pFile, const udFileReadRequest *pRequests, size_t count, size_t *pActualReads);
+
+// Return a pointer to data in place (optional), the pointer must remain valid until the file is closed
+typedef udResult udFile_BorrowHandlerFunc(udFile *pFile, const void **ppData, size_t length, int64_t seekOffset, size_t *pActualLength);
+
 // Perform a seek followed by write
 typedef udResult udFile_SeekWriteHandlerFunc(udFile *pFile, const void *pBuffer, size_t bufferLength, int64_t seekOffset, size_t *pActualWritten);
 
@@ -48,6 +55,8 @@ struct udFile
   udFile_SetSubFilenameFunc *fpSetSubFilename; // Optional, for handlers of archive files such as zip etc
   udFile_LoadHandlerFunc *fpLoad;              // Optional, for handlers that can optimize the Open/Read/Close approach of udFile_Load, such as HTTP
   udFile_SeekReadHandlerFunc *fpRead;
+  udFile_ReadVHandlerFunc *fpReadV;            // Optional, for handlers that can do a batch of reads natively. A generic implementation is assigned if null
+  udFile_BorrowHandlerFunc *fpBorrow;          // Optional, for handlers that can return pointers to data without copying, such as memory mapped files
   udFile_SeekWriteHandlerFunc *fpWrite;
   udFile_BlockForPipelinedRequestHandlerFunc *fpBlockPipedRequest;
   udFile_ReleaseHandlerFunc *fpRelease;
@@ -57,10 +66,16 @@ struct udFile
   int64_t seekBase;
   int64_t filePos;
   int64_t fileLength;
-  uint32_t msAccumulator;
-  uint32_t requestsInFlight;
-  uint64_t totalBytes;
+  volatile int32_t msAccumulator;         // Time spent with at least one request in flight, updated with interlocked operations so handlers can read without locking
+  volatile int32_t requestsInFlight;
+  volatile int64_t totalBytes;
   float mbPerSec;
+  struct udFileCacheName *pCacheName;    // Set by udFile, not handlers, when reads go through the block cache
+  uint64_t cacheHits;                     // Updated with the cache mutex held
+  uint64_t cacheMisses;
+  int64_t readAheadOffset;                // Where the next read would start if access is sequential
+  int32_t readAheadBlocks;                // Read-ahead window, doubles with each sequential read
+  int64_t readAheadFirst, readAheadEnd;   // Blocks being read in the background, guarded by the cache mutex
   bool filenameCopyRequiresFree;          // Set if the filename copy was allocated, will be freed prior to calling handler close function
 };
 
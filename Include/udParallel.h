@@ -0,0 +1,103 @@
+#ifndef UDPARALLEL_H
+#define UDPARALLEL_H
+//
+// Copyright (c) Euclideon Pty Ltd
+//
+// Parallel-for and parallel-reduce over an index range (or a udChunkedArray) using a udWorkerPool
+// The range is split into grains which are handed out in shrinking runs, so early claims are large and the tail balances across threads
+// The calling thread takes part and these block until the whole range is done, they are safe to call from inside a worker
+//
+
+#include "udResult.h"
+#include "udCallback.h"
+#include "udWorkerPool.h"
+#include "udChunkedArray.h"
+
+// Called with a contiguous range [startIndex, endIndex), participant is unique to the thread running it for the duration of the call
+using udParallelRangeCallback = udCallback<void(size_t startIndex, size_t endIndex, uint32_t participant)>;
+
+// Number of distinct participant values the pool can pass to a udParallelRangeCallback (worker threads plus the calling thread)
+uint32_t udParallel_GetParticipantCount(udWorkerPool *pPool);
+
+// Runs func over [startIndex, endIndex) with each call starting and ending on a multiple of grainSize (other than at the ends of the range)
+// A grainSize of 0 picks one from the range and pool size. If pPool is null the whole range is run on the calling thread
+udResult udParallel_Run(udWorkerPool *pPool, size_t startIndex, size_t endIndex, size_t grainSize, const udParallelRangeCallback &func);
+
+// Runs func over [startIndex, endIndex), see udParallel_Run for grainSize
+udResult udParallelFor(udWorkerPool *pPool, size_t startIndex, size_t endIndex, size_t grainSize, udCallback<void(size_t startIndex, size_t endIndex)> func);
+
+// Runs func over every element of array, each call gets a contiguous run of elements that never crosses a chunk
+// grainSize is rounded up to a whole number of chunks so threads work on separate chunks
+template <typename T>
+udResult udParallelFor(udWorkerPool *pPool, udChunkedArray<T> &array, size_t grainSize, udCallback<void(T *pElements, size_t startIndex, size_t count)> func);
+
+// Folds func over [startIndex, endIndex) into one partial per participating thread, then combines the partials into *pResult
+// func is given the partial so far (starting at identity) and returns the new partial; combine must be associative and commutative
+template <typename T>
+udResult udParallelReduce(udWorkerPool *pPool, size_t startIndex, size_t endIndex, size_t grainSize, const T &identity, udCallback<T(size_t startIndex, size_t endIndex, T partial)> func, udCallback<T(T a, T b)> combine, T *pResult);
+
+// ****************************************************************************
+template <typename T>
+udResult udParallelFor(udWorkerPool *pPool, udChunkedArray<T> &array, size_t grainSize, udCallback<void(T *pElements, size_t startIndex, size_t count)> func)
+{
+  if (!func)
+    return udR_InvalidParameter_;
+
+  // Grains are laid out from the start of the first chunk (before the inset) so each one covers whole chunks
+  size_t chunkElementCount = array.ChunkElementCount();
+  size_t inset = array.inset;
+  grainSize = udMax((size_t)1, (grainSize + chunkElementCount - 1) / chunkElementCount) * chunkElementCount;
+
+  udParallelRangeCallback runFunc = [&array, &func, inset](size_t startIndex, size_t endIndex, uint32_t /*participant*/)
+  {
+    for (size_t index = startIndex - inset; index < endIndex - inset;)
+    {
+      size_t runLength = udMin(array.GetElementRunLength(index), endIndex - inset - index);
+      func(array.GetElement(index), index, runLength);
+      index += runLength;
+    }
+  };
+
+  return udParallel_Run(pPool, inset, inset + array.length, grainSize, runFunc);
+}
+
+// ****************************************************************************
+template <typename T>
+udResult udParallelReduce(udWorkerPool *pPool, size_t startIndex, size_t endIndex, size_t grainSize, const T &identity, udCallback<T(size_t startIndex, size_t endIndex, T partial)> func, udCallback<T(T a, T b)> combine, T *pResult)
+{
+  udResult result;
+  uint32_t participantCount = udParallel_GetParticipantCount(pPool);
+  T *pPartials = nullptr;
+
+  UD_ERROR_NULL(pResult, udR_InvalidParameter_);
+  UD_ERROR_IF(!func || !combine, udR_InvalidParameter_);
+
+  pPartials = udAllocType(T, participantCount, udAF_None);
+  UD_ERROR_NULL(pPartials, udR_MemoryAllocationFailure);
+  for (uint32_t i = 0; i < participantCount; ++i)
+    new (&pPartials[i]) T(identity);
+
+  {
+    udParallelRangeCallback runFunc = [pPartials, &func](size_t rangeStart, size_t rangeEnd, uint32_t participant)
+    {
+      pPartials[participant] = func(rangeStart, rangeEnd, pPartials[participant]);
+    };
+    UD_ERROR_CHECK(udParallel_Run(pPool, startIndex, endIndex, grainSize, runFunc));
+  }
+
+  *pResult = pPartials[0];
+  for (uint32_t i = 1; i < participantCount; ++i)
+    *pResult = combine(*pResult, pPartials[i]);
+
+epilogue:
+  if (pPartials)
+  {
+    for (uint32_t i = 0; i < participantCount; ++i)
+      pPartials[i].~T();
+    udFree(pPartials);
+  }
+
+  return result;
+}
+
+#endif // UDPARALLEL_H
@@ -147,6 +147,7 @@ inline int32_t udInterlockedPreDecrement(volatile int32_t *p) { return (int32_t)
 inline int32_t udInterlockedPostDecrement(volatile int32_t *p) { return (int32_t)_InterlockedDecrement((long*)p) + 1; }
 inline int32_t udInterlockedExchange(volatile int32_t *dest, int32_t exchange) { return (int32_t)_InterlockedExchange((volatile long*)dest, exchange); }
 inline int32_t udInterlockedCompareExchange(volatile int32_t *dest, int32_t exchange, int32_t comparand) { return (int32_t)_InterlockedCompareExchange((volatile long*)dest, exchange, comparand); }
+inline int64_t udInterlockedAdd64(volatile int64_t *p, int64_t amount) { return InterlockedExchangeAdd64((volatile LONG64*)p, amount) + amount; }
 # if UD_32BIT
 template <typename T, typename U>
 inline T *udInterlockedExchangePointer(T * volatile* dest, U *exchange) { return (T*)_InterlockedExchange((volatile long*)dest, (long)exchange); }
@@ -160,6 +161,7 @@ inline T *udInterlockedCompareExchangePointer(T * volatile* dest, U *exchange, U
 # endif // UD_32BIT
 # define udSleep(x) Sleep(x)
 # define udYield() SwitchToThread()
+# define udSpinPause() YieldProcessor()
 # define UDTHREADLOCAL __declspec(thread)
 
 #elif UDPLATFORM_LINUX || UDPLATFORM_NACL || UDPLATFORM_OSX || UDPLATFORM_IOS_SIMULATOR || UDPLATFORM_IOS || UDPLATFORM_ANDROID || UDPLATFORM_EMSCRIPTEN
@@ -172,6 +174,7 @@ inline int32_t udInterlockedPreDecrement(volatile int32_t *p)  { return __sync_s
 inline int32_t udInterlockedPostDecrement(volatile int32_t *p) { return __sync_fetch_and_sub(p, 1); }
 inline int32_t udInterlockedExchange(volatile int32_t *dest, int32_t exchange) { return __sync_lock_test_and_set(dest, exchange); }
 inline int32_t udInterlockedCompareExchange(volatile int32_t *dest, int32_t exchange, int32_t comparand) { return __sync_val_compare_and_swap(dest, comparand, exchange); }
+inline int64_t udInterlockedAdd64(volatile int64_t *p, int64_t amount) { return __sync_add_and_fetch(p, amount); }
 #if UDPLATFORM_LINUX && !defined(__clang__) && __GNUC__ < 5
 // We're just trying to ignore pedantic warnings on CentOS7 GCC due to function pointers being used in this function below
 # pragma GCC diagnostic push
@@ -186,6 +189,13 @@ template <typename T, typename U>
 inline T *udInterlockedCompareExchangePointer(T * volatile* dest, U *exchange, U *comparand) { return (T*)__sync_val_compare_and_swap((void * volatile*)dest, (void*)comparand, (void*)exchange); }
 # define udSleep(x) usleep((x)*1000)
 # define udYield(x) sched_yield()
+# if defined(__i386__) || defined(__x86_64__)
+#   define udSpinPause() __builtin_ia32_pause()
+# elif defined(__aarch64__)
+#   define udSpinPause() __asm__ __volatile__("yield")
+# else
+#   define udSpinPause()
+# endif
 # if defined(__INTELLISENSE__)
 #   define UDTHREADLOCAL
 # else
@@ -206,7 +206,21 @@ udResult udBase64Encode(const char **ppDestStr, const void *pBinary, size_t bina
 // *********************************************************************
 // Threading and concurrency
 // *********************************************************************
-int udGetHardwareThreadCount();
+struct udHardwareTopology
+{
+  int logicalProcessorCount; // Hardware threads this process is allowed to run on
+  int physicalCoreCount; // Cores with at least one of those hardware threads
+  int numaNodeCount; // NUMA nodes with at least one of those hardware threads
+  int maxSMTSiblings; // Most hardware threads sharing a single core
+};
+
+// Returns the number of hardware threads, optionally filling in how they're spread across cores and NUMA nodes
+int udGetHardwareThreadCount(udHardwareTopology *pTopology = nullptr);
+
+// Fills pProcessors with the OS processor numbers this process can run on, optionally only those on NUMA node nodeIndex (-1 for all)
+// Processors are ordered with one per physical core first and their SMT siblings after, so using the first N spreads across cores
+// Returns the number of processors written, at most maxProcessors
+int udGetHardwareProcessors(int *pProcessors, int maxProcessors, int nodeIndex = -1);
 
 
 // *********************************************************************
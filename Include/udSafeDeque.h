@@ -11,6 +11,7 @@
 #include "udResult.h"
 #include "udChunkedArray.h"
 #include "udThread.h"
+#include "udPlatformUtil.h"
 
 /// Thread safe double ended queue
 template <typename T>
@@ -18,6 +19,9 @@ struct udSafeDeque
 {
   udChunkedArray<T> chunkedArray;
   udMutex *pMutex = nullptr;
+  udConditionVariable *pCondition = nullptr; // Signalled when elements are pushed or the deque is closed
+  int waiters; // Threads blocked in udSafeDeque_PopFrontWait, only accessed with pMutex held
+  bool isClosed;
 };
 
 // ****************************************************************************
@@ -39,6 +43,9 @@ udResult udSafeDeque_Create(udSafeDeque<T> **ppDeque, size_t elementCount)
   pDeque->pMutex = udCreateMutex();
   UD_ERROR_NULL(pDeque, udR_MemoryAllocationFailure);
 
+  pDeque->pCondition = udCreateConditionVariable();
+  UD_ERROR_NULL(pDeque->pCondition, udR_MemoryAllocationFailure);
+
   *ppDeque = pDeque;
   pDeque = nullptr;
 
@@ -56,6 +63,7 @@ void udSafeDeque_Destroy(udSafeDeque<T> **ppDeque)
   if (ppDeque == nullptr || *ppDeque == nullptr)
     return;
 
+  udDestroyConditionVariable(&(*ppDeque)->pCondition);
   udDestroyMutex(&(*ppDeque)->pMutex);
   (*ppDeque)->chunkedArray.Deinit();
 
@@ -75,8 +83,12 @@ inline udResult udSafeDeque_PushBack(udSafeDeque<T> *pDeque, const T &v)
   pMutex = udLockMutex(pDeque->pMutex);
 
   UD_ERROR_NULL(pMutex, udR_NotInitialized_);
+  UD_ERROR_IF(pDeque->isClosed, udR_NotAllowed);
   UD_ERROR_CHECK(pDeque->chunkedArray.PushBack(v));
 
+  if (pDeque->waiters > 0)
+    udSignalConditionVariable(pDeque->pCondition);
+
 epilogue:
   udReleaseMutex(pMutex);
 
@@ -96,8 +108,12 @@ inline udResult udSafeDeque_PushFront(udSafeDeque<T> *pDeque, const T &v)
   pMutex = udLockMutex(pDeque->pMutex);
 
   UD_ERROR_NULL(pMutex, udR_NotInitialized_);
+  UD_ERROR_IF(pDeque->isClosed, udR_NotAllowed);
   UD_ERROR_CHECK(pDeque->chunkedArray.PushFront(v));
 
+  if (pDeque->waiters > 0)
+    udSignalConditionVariable(pDeque->pCondition);
+
 epilogue:
   udReleaseMutex(pMutex);
 
@@ -146,4 +162,155 @@ epilogue:
   return result;
 }
 
+// ****************************************************************************
+// Pushes count elements from pData onto the back in one critical section, either all are pushed or none are
+template <typename T>
+inline udResult udSafeDeque_PushBackRange(udSafeDeque<T> *pDeque, const T *pData, size_t count)
+{
+  udResult result = udR_Success;
+  udMutex *pMutex = nullptr;
+  size_t index;
+
+  UD_ERROR_NULL(pDeque, udR_InvalidParameter_);
+  UD_ERROR_IF(pData == nullptr && count > 0, udR_InvalidParameter_);
+
+  pMutex = udLockMutex(pDeque->pMutex);
+
+  UD_ERROR_NULL(pMutex, udR_NotInitialized_);
+  UD_ERROR_IF(pDeque->isClosed, udR_NotAllowed);
+  UD_ERROR_CHECK(pDeque->chunkedArray.ReserveBack(pDeque->chunkedArray.length + count));
+
+  if (pDeque->waiters > 0 && count > 0)
+    udSignalConditionVariable(pDeque->pCondition, (int)udMin(count, (size_t)pDeque->waiters));
+
+  // Copy a chunk's worth of elements at a time
+  index = pDeque->chunkedArray.length;
+  pDeque->chunkedArray.length += count;
+  while (count > 0)
+  {
+    size_t runLength = udMin(pDeque->chunkedArray.GetElementRunLength(index), count);
+    memcpy(pDeque->chunkedArray.GetElement(index), pData, runLength * sizeof(T));
+
+    pData += runLength;
+    index += runLength;
+    count -= runLength;
+  }
+
+epilogue:
+  udReleaseMutex(pMutex);
+
+  return result;
+}
+
+// ****************************************************************************
+// Pops up to maxCount elements from the front into pData in one critical section, returns udR_ObjectNotFound if the deque was empty
+template <typename T>
+inline udResult udSafeDeque_PopFrontRange(udSafeDeque<T> *pDeque, T *pData, size_t maxCount, size_t *pPoppedCount)
+{
+  udResult result = udR_Success;
+  udMutex *pMutex = nullptr;
+  size_t popped = 0;
+
+  UD_ERROR_NULL(pDeque, udR_InvalidParameter_);
+  UD_ERROR_NULL(pData, udR_InvalidParameter_);
+  UD_ERROR_IF(maxCount == 0, udR_InvalidParameter_);
+
+  pMutex = udLockMutex(pDeque->pMutex);
+
+  UD_ERROR_NULL(pMutex, udR_NotInitialized_);
+  UD_ERROR_IF(pDeque->chunkedArray.length == 0, udR_ObjectNotFound);
+
+  // Copy out whole runs from the front chunk, popping each run as it's copied so chunks are recycled as they empty
+  while (popped < maxCount && pDeque->chunkedArray.length > 0)
+  {
+    size_t runLength = udMin(pDeque->chunkedArray.GetElementRunLength(0), maxCount - popped);
+    memcpy(pData + popped, pDeque->chunkedArray.GetElement(0), runLength * sizeof(T));
+
+    // The run is within the front chunk so only its last element can empty it, PopFront handles recycling that
+    pDeque->chunkedArray.inset += runLength - 1;
+    pDeque->chunkedArray.length -= runLength - 1;
+    pDeque->chunkedArray.PopFront();
+    popped += runLength;
+  }
+
+epilogue:
+  udReleaseMutex(pMutex);
+
+  if (pPoppedCount)
+    *pPoppedCount = popped;
+
+  return result;
+}
+
+// ****************************************************************************
+// Pops from the front, waiting up to waitMs (UDTHREAD_WAIT_INFINITE to wait forever) for an element to be pushed
+// Returns udR_Timeout if nothing arrived in time, or udR_Cancelled once the deque has been closed and emptied
+template <typename T>
+inline udResult udSafeDeque_PopFrontWait(udSafeDeque<T> *pDeque, T *pData, int waitMs)
+{
+  udResult result = udR_Success;
+  udMutex *pMutex = nullptr;
+  uint64_t startTime = udPerfCounterStart();
+
+  UD_ERROR_NULL(pDeque, udR_InvalidParameter_);
+
+  pMutex = udLockMutex(pDeque->pMutex);
+
+  UD_ERROR_NULL(pMutex, udR_NotInitialized_);
+
+  ++pDeque->waiters;
+  while (!pDeque->chunkedArray.PopFront(pData))
+  {
+    int remainingMs = waitMs;
+
+    if (pDeque->isClosed)
+    {
+      result = udR_Cancelled;
+      break;
+    }
+
+    if (waitMs != UDTHREAD_WAIT_INFINITE)
+    {
+      remainingMs = waitMs - (int)udPerfCounterMilliseconds(startTime);
+      if (remainingMs <= 0)
+      {
+        result = udR_Timeout;
+        break;
+      }
+    }
+
+    udWaitConditionVariable(pDeque->pCondition, pDeque->pMutex, remainingMs);
+  }
+  --pDeque->waiters;
+
+epilogue:
+  udReleaseMutex(pMutex);
+
+  return result;
+}
+
+// ****************************************************************************
+// Stops any further pushes and wakes every thread in udSafeDeque_PopFrontWait, elements already queued can still be popped
+template <typename T>
+inline udResult udSafeDeque_Close(udSafeDeque<T> *pDeque)
+{
+  udResult result = udR_Success;
+  udMutex *pMutex = nullptr;
+
+  UD_ERROR_NULL(pDeque, udR_InvalidParameter_);
+
+  pMutex = udLockMutex(pDeque->pMutex);
+
+  UD_ERROR_NULL(pMutex, udR_NotInitialized_);
+
+  pDeque->isClosed = true;
+  if (pDeque->waiters > 0)
+    udSignalConditionVariable(pDeque->pCondition, pDeque->waiters);
+
+epilogue:
+  udReleaseMutex(pMutex);
+
+  return result;
+}
+
 #endif // UDSAFEDEQUE_H
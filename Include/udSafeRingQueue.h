@@ -0,0 +1,187 @@
+#ifndef UDSAFERINGQUEUE_H
+#define UDSAFERINGQUEUE_H
+//
+// Copyright (c) Euclideon Pty Ltd
+//
+// Lock-free bounded multi-producer/multi-consumer FIFO, an alternative to udSafeDeque when many threads share a queue
+// Each slot carries a sequence number saying whether it's ready to be written or read for the current lap of the ring
+// (Dmitry Vyukov's bounded MPMC queue), so producers and consumers only contend on their own position counter
+//
+
+#include "udResult.h"
+#include "udPlatform.h"
+
+// Keeps the producer and consumer positions on separate cache lines
+#define UDSAFERINGQUEUE_PADDING 64
+
+template <typename T>
+struct udSafeRingQueueCell
+{
+  volatile uint32_t sequence;
+  T data;
+};
+
+/// Thread safe lock-free bounded queue, elements are pushed to the back and popped from the front only
+template <typename T>
+struct udSafeRingQueue
+{
+  udSafeRingQueueCell<T> *pCells;
+  uint32_t mask; // Capacity - 1, capacity is a power of two
+
+  uint8_t padding0[UDSAFERINGQUEUE_PADDING];
+  volatile uint32_t enqueuePos;
+  uint8_t padding1[UDSAFERINGQUEUE_PADDING - sizeof(uint32_t)];
+  volatile uint32_t dequeuePos;
+  uint8_t padding2[UDSAFERINGQUEUE_PADDING - sizeof(uint32_t)];
+};
+
+// ****************************************************************************
+// Capacity is rounded up to a power of two, unlike udSafeDeque the queue never grows
+template <typename T>
+udResult udSafeRingQueue_Create(udSafeRingQueue<T> **ppQueue, uint32_t capacity)
+{
+  udResult result = udR_Failure_;
+  udSafeRingQueue<T> *pQueue = nullptr;
+  uint32_t roundedCapacity = 2;
+
+  UD_ERROR_NULL(ppQueue, udR_InvalidParameter_);
+  UD_ERROR_IF(capacity == 0 || capacity > (1u << 30), udR_InvalidParameter_); // Positions wrap, only their differences are compared (as signed 32-bit)
+
+  while (roundedCapacity < capacity)
+    roundedCapacity <<= 1;
+
+  pQueue = udAllocType(udSafeRingQueue<T>, 1, udAF_Zero);
+  UD_ERROR_NULL(pQueue, udR_MemoryAllocationFailure);
+
+  pQueue->pCells = udAllocType(udSafeRingQueueCell<T>, roundedCapacity, udAF_Zero);
+  UD_ERROR_NULL(pQueue->pCells, udR_MemoryAllocationFailure);
+
+  pQueue->mask = roundedCapacity - 1;
+  for (uint32_t i = 0; i < roundedCapacity; ++i)
+    pQueue->pCells[i].sequence = i;
+
+  *ppQueue = pQueue;
+  pQueue = nullptr;
+  result = udR_Success;
+
+epilogue:
+  udSafeRingQueue_Destroy(&pQueue);
+
+  return result;
+}
+
+// ****************************************************************************
+// Must not be called while other threads are still using the queue
+template <typename T>
+void udSafeRingQueue_Destroy(udSafeRingQueue<T> **ppQueue)
+{
+  if (ppQueue == nullptr || *ppQueue == nullptr)
+    return;
+
+  udFree((*ppQueue)->pCells);
+  udFree(*ppQueue);
+}
+
+// ****************************************************************************
+// Internal: compare-and-swap on an unsigned position, the arithmetic stays unsigned so wrapping is well defined
+inline uint32_t udSafeRingQueue_CompareExchange(volatile uint32_t *pPos, uint32_t exchange, uint32_t comparand)
+{
+  return (uint32_t)udInterlockedCompareExchange((volatile int32_t*)pPos, (int32_t)exchange, (int32_t)comparand);
+}
+
+// ****************************************************************************
+// Returns udR_CountExceeded if the queue is full
+template <typename T>
+inline udResult udSafeRingQueue_PushBack(udSafeRingQueue<T> *pQueue, const T &v)
+{
+  if (pQueue == nullptr)
+    return udR_InvalidParameter_;
+
+  udSafeRingQueueCell<T> *pCell;
+  uint32_t pos = pQueue->enqueuePos;
+
+  for (;;)
+  {
+    pCell = &pQueue->pCells[pos & pQueue->mask];
+    int32_t diff = (int32_t)(pCell->sequence - pos);
+
+    if (diff == 0)
+    {
+      // Slot is free for this lap, claim it
+      uint32_t previous = udSafeRingQueue_CompareExchange(&pQueue->enqueuePos, pos + 1, pos);
+      if (previous == pos)
+        break;
+      pos = previous;
+    }
+    else if (diff < 0)
+    {
+      return udR_CountExceeded; // Slot still holds an element from the previous lap
+    }
+    else
+    {
+      pos = pQueue->enqueuePos; // Another producer claimed it first
+    }
+  }
+
+  pCell->data = v;
+  udMemoryBarrier(); // Data must be visible before the sequence says it's ready
+  pCell->sequence = pos + 1;
+
+  return udR_Success;
+}
+
+// ****************************************************************************
+// Returns udR_ObjectNotFound if the queue is empty
+template <typename T>
+inline udResult udSafeRingQueue_PopFront(udSafeRingQueue<T> *pQueue, T *pData)
+{
+  if (pQueue == nullptr)
+    return udR_InvalidParameter_;
+
+  udSafeRingQueueCell<T> *pCell;
+  uint32_t pos = pQueue->dequeuePos;
+
+  for (;;)
+  {
+    pCell = &pQueue->pCells[pos & pQueue->mask];
+    int32_t diff = (int32_t)(pCell->sequence - (pos + 1));
+
+    if (diff == 0)
+    {
+      // Slot has been filled for this lap, claim it (the interlocked operation also orders the data read after the sequence read)
+      uint32_t previous = udSafeRingQueue_CompareExchange(&pQueue->dequeuePos, pos + 1, pos);
+      if (previous == pos)
+        break;
+      pos = previous;
+    }
+    else if (diff < 0)
+    {
+      return udR_ObjectNotFound; // Producer hasn't filled this slot yet
+    }
+    else
+    {
+      pos = pQueue->dequeuePos; // Another consumer claimed it first
+    }
+  }
+
+  if (pData)
+    *pData = pCell->data;
+  udMemoryBarrier(); // Data must be read before the slot is handed back to producers
+  pCell->sequence = pos + pQueue->mask + 1;
+
+  return udR_Success;
+}
+
+// ****************************************************************************
+// Only a snapshot, other threads may push or pop at any time
+template <typename T>
+inline uint32_t udSafeRingQueue_Count(udSafeRingQueue<T> *pQueue)
+{
+  if (pQueue == nullptr)
+    return 0;
+
+  int32_t count = (int32_t)(pQueue->enqueuePos - pQueue->dequeuePos);
+  return (count > 0) ? (uint32_t)count : 0;
+}
+
+#endif // UDSAFERINGQUEUE_H
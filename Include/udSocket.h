@@ -31,6 +31,7 @@ void udSocket_DeinitSystem();
 udResult udSocket_Open(udSocket **ppSocket, const char *pAddress, uint32_t port, udSocketConnectionFlags flags = udSCF_None, const char *pPrivateKey = nullptr, const char *pPublicCertificate = nullptr);
 void udSocket_Close(udSocket **ppSocket);
 bool udSocket_IsValidSocket(udSocket *pSocket);
+udResult udSocket_GetLocalPort(udSocket *pSocket, uint32_t *pPort); // The port the socket is bound to, eg. after opening a server on port 0 to have the system choose one
 
 udResult udSocket_SendData(udSocket *pSocket, const uint8_t *pBytes, int64_t totalBytes, int64_t *pActualSent = nullptr);
 udResult udSocket_ReceiveData(udSocket *pSocket, uint8_t *pBytes, int64_t bufferSize, int64_t *pActualReceived = nullptr);
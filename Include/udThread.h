@@ -29,6 +29,10 @@ udResult udThread_Create(udThread **ppThread, udThreadStart threadStarter, void
 // Set the thread priority
 void udThread_SetPriority(udThread *pThread, udThreadPriority priority);
 
+// Restrict a thread to the given OS processor numbers (see udGetHardwareProcessors), a processorCount of 0 lets it run anywhere again
+// Returns udR_Unsupported on platforms without thread affinity
+udResult udThread_SetAffinity(udThread *pThread, const int *pProcessors, int processorCount);
+
 // Destroy a thread, this should be called after the thread has exited (udThread_Join can be used to assist)
 void udThread_Destroy(udThread **ppThreadHandle);
 
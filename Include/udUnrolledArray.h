@@ -0,0 +1,382 @@
+#ifndef UDUNROLLEDARRAY_H
+#define UDUNROLLEDARRAY_H
+//
+// Copyright (c) Euclideon Pty Ltd
+//
+// A chunked array where every chunk keeps its own fill count (an unrolled list), for large arrays that are edited in the middle
+// Insert and RemoveAt only shift elements within one chunk, a Fenwick tree over the chunk counts keeps indexing at O(log chunks)
+// Splitting or merging a chunk moves every later chunk along, so those are O(chunks after it) for both the chunk list and the tree
+// Unlike udChunkedArray, chunks are not always full so use GetElementRunLength to walk contiguous elements
+//
+
+#include "udPlatform.h"
+#include "udResult.h"
+#include "udChunkedArray.h"
+
+template <typename T>
+struct udUnrolledArray
+{
+  udResult Init(size_t chunkElementCount, udChunkAllocator *pChunkAllocator = nullptr); // Chunks come from pChunkAllocator if set, otherwise udAlloc
+  udResult Deinit();
+  udResult Clear();
+
+  T &operator[](size_t index);
+  const T &operator[](size_t index) const;
+  T *GetElement(size_t index);
+  const T *GetElement(size_t index) const;
+
+  udResult PushBack(const T &v);
+  udResult Insert(size_t index, const T *pData = nullptr); // Insert the element at index, only elements after it in the same chunk are moved
+  void RemoveAt(size_t index);                             // Remove the element at index, only elements after it in the same chunk are moved
+
+  // At element index, return the number of elements including index that follow in the same chunk (ie can be indexed directly)
+  size_t GetElementRunLength(size_t index) const;
+  size_t ChunkElementCount() const { return chunkElementCount; }
+
+  enum { ptrArrayInc = 32 };
+
+  struct Chunk
+  {
+    T *pElements;
+    size_t count;
+  };
+
+  Chunk *pChunks;
+  size_t *pCountTree; // Fenwick tree over the chunk counts, 1-based with the same capacity as pChunks
+  size_t ptrArraySize;
+  size_t chunkElementCount;
+  size_t chunkCount;
+
+  size_t length;
+  udChunkAllocator *pChunkAllocator;
+
+  void FindElement(size_t index, size_t *pChunkIndex, size_t *pChunkOffset) const;
+  size_t CountBefore(size_t chunkIndex) const;
+  void UpdateCount(size_t chunkIndex, size_t delta);
+  void RebuildCounts(size_t firstChunkIndex);
+  udResult InsertChunk(size_t chunkIndex);
+  void RemoveChunk(size_t chunkIndex);
+};
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udUnrolledArray<T>::Init(size_t a_chunkElementCount, udChunkAllocator *a_pChunkAllocator /*= nullptr*/)
+{
+  udResult result;
+
+  pChunks = nullptr;
+  pCountTree = nullptr;
+  ptrArraySize = 0;
+  chunkElementCount = 0;
+  chunkCount = 0;
+  length = 0;
+  pChunkAllocator = a_pChunkAllocator;
+
+  UD_ERROR_IF(a_chunkElementCount < 2, udR_InvalidParameter_); // Full chunks are split in half
+  chunkElementCount = a_chunkElementCount;
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udUnrolledArray<T>::Deinit()
+{
+  Clear();
+  udFree(pChunks);
+  udFree(pCountTree);
+  ptrArraySize = 0;
+
+  return udR_Success;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udUnrolledArray<T>::Clear()
+{
+  for (size_t c = 0; c < chunkCount; ++c)
+  {
+    if (pChunkAllocator)
+      pChunkAllocator->pFreeChunk(pChunkAllocator, pChunks[c].pElements, sizeof(T) * chunkElementCount);
+    else
+      udFree(pChunks[c].pElements);
+  }
+
+  chunkCount = 0;
+  length = 0;
+
+  return udR_Success;
+}
+
+// --------------------------------------------------------------------------
+// Finds the chunk holding element index by walking down the count tree
+template <typename T>
+inline void udUnrolledArray<T>::FindElement(size_t index, size_t *pChunkIndex, size_t *pChunkOffset) const
+{
+  UDASSERT(index < length, "Index out of bounds");
+
+  size_t step = 1;
+  while ((step << 1) <= chunkCount)
+    step <<= 1;
+
+  size_t position = 0;
+  for (; step > 0; step >>= 1)
+  {
+    if (position + step <= chunkCount && pCountTree[position + step] <= index)
+    {
+      position += step;
+      index -= pCountTree[position];
+    }
+  }
+
+  *pChunkIndex = position;
+  *pChunkOffset = index;
+}
+
+// --------------------------------------------------------------------------
+// Number of elements in the chunks before chunkIndex
+template <typename T>
+inline size_t udUnrolledArray<T>::CountBefore(size_t chunkIndex) const
+{
+  size_t count = 0;
+  for (size_t i = chunkIndex; i > 0; i -= (i & (0 - i)))
+    count += pCountTree[i];
+  return count;
+}
+
+// --------------------------------------------------------------------------
+// Add delta (which may be a wrapped negative) to a chunk's count
+template <typename T>
+inline void udUnrolledArray<T>::UpdateCount(size_t chunkIndex, size_t delta)
+{
+  pChunks[chunkIndex].count += delta;
+  length += delta;
+  for (size_t i = chunkIndex + 1; i <= chunkCount; i += (i & (0 - i)))
+    pCountTree[i] += delta;
+}
+
+// --------------------------------------------------------------------------
+// Rebuilds the tree nodes from firstChunkIndex on, earlier nodes only cover earlier chunks so are left as they are
+template <typename T>
+inline void udUnrolledArray<T>::RebuildCounts(size_t firstChunkIndex)
+{
+  size_t firstNode = firstChunkIndex + 1;
+  for (size_t i = firstNode; i <= chunkCount; ++i)
+    pCountTree[i] = pChunks[i - 1].count;
+
+  // The earlier nodes whose parents are being rebuilt are exactly those that sum the chunks before firstChunkIndex
+  for (size_t i = firstNode - 1; i > 0; i -= (i & (0 - i)))
+  {
+    size_t parent = i + (i & (0 - i));
+    if (parent <= chunkCount)
+      pCountTree[parent] += pCountTree[i];
+  }
+
+  for (size_t i = firstNode; i <= chunkCount; ++i)
+  {
+    size_t parent = i + (i & (0 - i));
+    if (parent <= chunkCount)
+      pCountTree[parent] += pCountTree[i];
+  }
+}
+
+// --------------------------------------------------------------------------
+// Adds an empty chunk at chunkIndex, the count tree is left for the caller to update
+template <typename T>
+inline udResult udUnrolledArray<T>::InsertChunk(size_t chunkIndex)
+{
+  if (chunkCount + 1 > ptrArraySize)
+  {
+    size_t newPtrArraySize = ptrArraySize + ptrArrayInc;
+    Chunk *pNewChunks = udAllocType(Chunk, newPtrArraySize, udAF_Zero);
+    size_t *pNewCountTree = udAllocType(size_t, newPtrArraySize + 1, udAF_Zero);
+    if (!pNewChunks || !pNewCountTree)
+    {
+      udFree(pNewChunks);
+      udFree(pNewCountTree);
+      return udR_MemoryAllocationFailure;
+    }
+
+    if (pChunks)
+    {
+      memcpy(pNewChunks, pChunks, chunkCount * sizeof(Chunk));
+      memcpy(pNewCountTree, pCountTree, (chunkCount + 1) * sizeof(size_t));
+    }
+    udFree(pChunks);
+    udFree(pCountTree);
+    pChunks = pNewChunks;
+    pCountTree = pNewCountTree;
+    ptrArraySize = newPtrArraySize;
+  }
+
+  T *pElements;
+  if (pChunkAllocator)
+    pElements = (T*)pChunkAllocator->pAllocChunk(pChunkAllocator, sizeof(T) * chunkElementCount);
+  else
+    pElements = udAllocType(T, chunkElementCount, udAF_None);
+  if (!pElements)
+    return udR_MemoryAllocationFailure;
+
+  memmove(pChunks + chunkIndex + 1, pChunks + chunkIndex, (chunkCount - chunkIndex) * sizeof(Chunk));
+  pChunks[chunkIndex].pElements = pElements;
+  pChunks[chunkIndex].count = 0;
+  ++chunkCount;
+
+  return udR_Success;
+}
+
+// --------------------------------------------------------------------------
+// Frees the chunk at chunkIndex, its elements must already have been moved or removed and the count tree is left for the caller to update
+template <typename T>
+inline void udUnrolledArray<T>::RemoveChunk(size_t chunkIndex)
+{
+  if (pChunkAllocator)
+    pChunkAllocator->pFreeChunk(pChunkAllocator, pChunks[chunkIndex].pElements, sizeof(T) * chunkElementCount);
+  else
+    udFree(pChunks[chunkIndex].pElements);
+
+  memmove(pChunks + chunkIndex, pChunks + chunkIndex + 1, (chunkCount - chunkIndex - 1) * sizeof(Chunk));
+  --chunkCount;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline T &udUnrolledArray<T>::operator[](size_t index)
+{
+  return *GetElement(index);
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline const T &udUnrolledArray<T>::operator[](size_t index) const
+{
+  return *GetElement(index);
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline T *udUnrolledArray<T>::GetElement(size_t index)
+{
+  size_t chunkIndex, chunkOffset;
+  FindElement(index, &chunkIndex, &chunkOffset);
+  return &pChunks[chunkIndex].pElements[chunkOffset];
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline const T *udUnrolledArray<T>::GetElement(size_t index) const
+{
+  size_t chunkIndex, chunkOffset;
+  FindElement(index, &chunkIndex, &chunkOffset);
+  return &pChunks[chunkIndex].pElements[chunkOffset];
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udUnrolledArray<T>::PushBack(const T &v)
+{
+  return Insert(length, &v);
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline udResult udUnrolledArray<T>::Insert(size_t index, const T *pData)
+{
+  UDASSERT(index <= length, "Index out of bounds");
+
+  udResult result;
+  size_t chunkIndex;
+  size_t chunkOffset;
+
+  if (index == length)
+  {
+    // Appending goes on the end of the last chunk, which keeps PushBack filling chunks completely
+    chunkIndex = chunkCount - 1;
+    if (chunkCount == 0 || pChunks[chunkIndex].count == chunkElementCount)
+    {
+      chunkIndex = chunkCount;
+      UD_ERROR_CHECK(InsertChunk(chunkIndex));
+
+      // The new last node of the tree covers a range of earlier chunks
+      size_t node = chunkCount;
+      pCountTree[node] = CountBefore(node - 1) - CountBefore(node - (node & (0 - node)));
+    }
+    chunkOffset = pChunks[chunkIndex].count;
+  }
+  else
+  {
+    FindElement(index, &chunkIndex, &chunkOffset);
+
+    if (pChunks[chunkIndex].count == chunkElementCount)
+    {
+      // Split the full chunk, moving its upper half into a new chunk after it
+      size_t keepCount = chunkElementCount / 2;
+      UD_ERROR_CHECK(InsertChunk(chunkIndex + 1));
+      memcpy(pChunks[chunkIndex + 1].pElements, pChunks[chunkIndex].pElements + keepCount, (chunkElementCount - keepCount) * sizeof(T));
+      pChunks[chunkIndex + 1].count = chunkElementCount - keepCount;
+      pChunks[chunkIndex].count = keepCount;
+      RebuildCounts(chunkIndex);
+
+      if (chunkOffset > keepCount)
+      {
+        ++chunkIndex;
+        chunkOffset -= keepCount;
+      }
+    }
+  }
+
+  {
+    T *pElements = pChunks[chunkIndex].pElements;
+    memmove(pElements + chunkOffset + 1, pElements + chunkOffset, (pChunks[chunkIndex].count - chunkOffset) * sizeof(T));
+    if (pData)
+      memcpy(pElements + chunkOffset, pData, sizeof(T));
+    UpdateCount(chunkIndex, 1);
+  }
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline void udUnrolledArray<T>::RemoveAt(size_t index)
+{
+  size_t chunkIndex;
+  size_t chunkOffset;
+  FindElement(index, &chunkIndex, &chunkOffset);
+
+  T *pElements = pChunks[chunkIndex].pElements;
+  memmove(pElements + chunkOffset, pElements + chunkOffset + 1, (pChunks[chunkIndex].count - chunkOffset - 1) * sizeof(T));
+  UpdateCount(chunkIndex, (size_t)-1);
+
+  if (pChunks[chunkIndex].count == 0)
+  {
+    RemoveChunk(chunkIndex);
+    RebuildCounts(chunkIndex);
+  }
+  else if (chunkIndex + 1 < chunkCount && pChunks[chunkIndex].count + pChunks[chunkIndex + 1].count <= chunkElementCount / 2)
+  {
+    // Merge sparse neighbours so the chunk count (and so lookup cost) stays proportional to length
+    memcpy(pElements + pChunks[chunkIndex].count, pChunks[chunkIndex + 1].pElements, pChunks[chunkIndex + 1].count * sizeof(T));
+    pChunks[chunkIndex].count += pChunks[chunkIndex + 1].count;
+    RemoveChunk(chunkIndex + 1);
+    RebuildCounts(chunkIndex);
+  }
+}
+
+// --------------------------------------------------------------------------
+template <typename T>
+inline size_t udUnrolledArray<T>::GetElementRunLength(size_t index) const
+{
+  if (index >= length)
+    return 0;
+
+  size_t chunkIndex, chunkOffset;
+  FindElement(index, &chunkIndex, &chunkOffset);
+  return pChunks[chunkIndex].count - chunkOffset;
+}
+
+#endif // UDUNROLLEDARRAY_H
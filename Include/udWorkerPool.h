@@ -10,23 +10,96 @@
 
 #include "udResult.h"
 #include "udCallback.h"
+#include "udThread.h"
 
 // Function definition for async and marshalled work
 using udWorkerPoolCallback = udCallback<void(void *)>;
 struct udWorkerPool;
+struct udWorkerPoolTaskHandle;
+struct udWorkerPoolTaskGroup;
 
-udResult udWorkerPool_Create(udWorkerPool **ppPool, uint8_t totalThreads, const char *pThreadNamePrefix = "udWorkerPool");
+// Each priority is a separate lane, higher lanes are served first but lower lanes are still periodically served so they don't starve
+enum udWorkerPoolPriority
+{
+  udWPP_High,
+  udWPP_Normal,
+  udWPP_Low,
+
+  udWPP_Count
+};
+
+// A single entry for udWorkerPool_AddTasks, members are as per the parameters of udWorkerPool_AddTask
+struct udWorkerPoolTaskDesc
+{
+  udWorkerPoolCallback function;
+  void *pUserData;
+  bool clearMemory;
+  udWorkerPoolCallback postFunction;
+};
+
+// Optional placement settings for udWorkerPool_Create, the defaults let threads run on any processor
+// Placement is best effort, it is skipped on platforms without thread affinity (see udThread_SetAffinity)
+struct udWorkerPoolOptions
+{
+  bool pinThreads = false; // Pin each thread to its own processor, using separate physical cores before SMT siblings
+  int numaNode = -1; // Only run threads on the processors of this NUMA node, -1 for any node
+};
+
+// Use udGetHardwareThreadCount to size the pool from the hardware topology
+udResult udWorkerPool_Create(udWorkerPool **ppPool, uint8_t totalThreads, const char *pThreadNamePrefix = "udWorkerPool", const udWorkerPoolOptions *pOptions = nullptr);
 void udWorkerPool_Destroy(udWorkerPool **ppPool);
 
 // Adds a function to run on a background thread, optionally with userdata. If clearMemory is true, it will call udFree on pUserData after running
-udResult udWorkerPool_AddTask(udWorkerPool *pPool, udWorkerPoolCallback func, void *pUserData = nullptr, bool clearMemory = true, udWorkerPoolCallback postFunction = nullptr);
+// Each thread has its own queue and idle threads steal from the others; tasks added from within a worker are queued on that worker
+// If ppTaskHandle is not null a handle is returned that can cancel the task, the caller must release it with udWorkerPool_ReleaseTaskHandle
+// If pGroup is not null the task is added to that group, see udWorkerPool_JoinTaskGroup
+udResult udWorkerPool_AddTask(udWorkerPool *pPool, udWorkerPoolCallback func, void *pUserData = nullptr, bool clearMemory = true, udWorkerPoolCallback postFunction = nullptr, udWorkerPoolPriority priority = udWPP_Normal, udWorkerPoolTaskHandle **ppTaskHandle = nullptr, udWorkerPoolTaskGroup *pGroup = nullptr);
+
+// Adds a batch of tasks, taking one queue lock per worker rather than one per task and waking only as many idle threads as there are tasks
+// If ppTaskHandles is not null it must have room for taskCount handles, entries for any tasks not added are set to null
+// A failed call may still have queued some of the tasks, which will run, with ppTaskHandles those are the entries that aren't null
+udResult udWorkerPool_AddTasks(udWorkerPool *pPool, const udWorkerPoolTaskDesc *pTasks, size_t taskCount, udWorkerPoolPriority priority = udWPP_Normal, udWorkerPoolTaskHandle **ppTaskHandles = nullptr, udWorkerPoolTaskGroup *pGroup = nullptr);
+
+// Adds a task that is only queued once every task in ppPredecessors has run, predecessor handles can be released straight after this returns
+// The task is queued on the worker that completes its last predecessor; if any predecessor is cancelled this task is cancelled as well
+// On failure nothing has been added and pUserData is still owned by the caller, it is only freed (with clearMemory) once the call has succeeded
+udResult udWorkerPool_AddDependentTask(udWorkerPool *pPool, udWorkerPoolTaskHandle *const *ppPredecessors, size_t predecessorCount, udWorkerPoolCallback func, void *pUserData = nullptr, bool clearMemory = true, udWorkerPoolCallback postFunction = nullptr, udWorkerPoolPriority priority = udWPP_Normal, udWorkerPoolTaskHandle **ppTaskHandle = nullptr, udWorkerPoolTaskGroup *pGroup = nullptr);
+
+// A group of tasks that can be waited on together, tasks can be added to a group across any number of calls and pools
+udResult udWorkerPool_CreateTaskGroup(udWorkerPoolTaskGroup **ppGroup);
+
+// The group must not have any tasks still to run, join it first
+void udWorkerPool_DestroyTaskGroup(udWorkerPoolTaskGroup **ppGroup);
+
+// Sleeps until every task added to the group so far has run (or been cancelled), returns udR_Timeout if waitMs elapses first
+// Post functions are not waited on. Joining from a worker can deadlock if the rest of the group is queued behind it
+udResult udWorkerPool_JoinTaskGroup(udWorkerPoolTaskGroup *pGroup, int waitMs = UDTHREAD_WAIT_INFINITE);
+
+// Revoke a task that hasn't started yet, neither the function nor the post function will be called and the userdata is freed if clearMemory was set
+// Returns udR_NothingToDo if the task has already started (or finished)
+udResult udWorkerPool_CancelTask(udWorkerPoolTaskHandle *pTaskHandle);
+
+// Release a handle returned by udWorkerPool_AddTask(s) or udWorkerPool_AddDependentTask, this does not cancel the task
+void udWorkerPool_ReleaseTaskHandle(udWorkerPoolTaskHandle **ppTaskHandle);
 
 // This must be run on the main thread, handles marshalling work back from worker threads if required
 // The parameter can be used to limit how much work is done each time this is called
 // Returns udR_NothingToDo if no work was done- otherwise udR_Success
 udResult udWorkerPool_DoPostWork(udWorkerPool *pPool, int processLimit = 0);
 
+// Sets how many times an idle thread polls for new tasks before it sleeps until woken, 0 sleeps straight away
+// Spinning costs CPU time while idle but saves waking a sleeping thread when tasks arrive in quick bursts
+void udWorkerPool_SetIdleSpinCount(udWorkerPool *pPool, uint32_t spinCount);
+
+// Returns the number of worker threads in the pool (0 if pPool is null)
+uint8_t udWorkerPool_GetThreadCount(udWorkerPool *pPool);
+
+// Sleeps until every task added to the pool has run (or been cancelled), including those waiting on predecessors
+// Returns udR_Timeout if waitMs elapses first, post functions are not waited on
+udResult udWorkerPool_WaitForIdle(udWorkerPool *pPool, int waitMs = UDTHREAD_WAIT_INFINITE);
+
 // Returns true if there are workers currently processing tasks or if workers should be processing tasks
+// Agrees with udWorkerPool_WaitForIdle, this is false exactly when it would return straight away
 bool udWorkerPool_HasActiveWorkers(udWorkerPool *pPool);
 
 #endif // udWorkerPool_h__
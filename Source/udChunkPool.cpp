@@ -0,0 +1,188 @@
+#include "udChunkPool.h"
+
+#include "udPlatform.h"
+#include "udThread.h"
+
+// Threads are spread over this many caches, so unrelated threads rarely contend on the same lock
+#define CHUNK_POOL_SHARD_COUNT 8
+
+// A cached chunk, the link is stored in the chunk's own memory
+struct udChunkPoolFreeChunk
+{
+  udChunkPoolFreeChunk *pNext;
+};
+
+struct udChunkPoolShard
+{
+  udMutex *pMutex;
+  udChunkPoolFreeChunk *pFreeChunks; // Most recently freed first
+  volatile int32_t cachedCount; // Read without the lock as a hint, only changed with it held
+  uint8_t padding[64 - sizeof(udMutex*) - sizeof(udChunkPoolFreeChunk*) - sizeof(int32_t)]; // Keep shards on separate cache lines
+};
+
+struct udChunkPool
+{
+  udChunkAllocator allocator; // Must be first, the allocator callbacks cast back to the pool
+  size_t chunkSize;
+  int32_t maxCachedPerShard;
+  udChunkPoolShard shards[CHUNK_POOL_SHARD_COUNT];
+};
+
+// Shard index + 1 for the current thread, 0 until the thread first uses a pool
+static UDTHREADLOCAL uint32_t s_chunkPoolShard;
+static volatile int32_t s_nextChunkPoolShard;
+
+// ----------------------------------------------------------------------------
+static udChunkPoolShard *udChunkPool_GetShard(udChunkPool *pPool)
+{
+  if (s_chunkPoolShard == 0)
+    s_chunkPoolShard = (uint32_t)(udInterlockedPostIncrement(&s_nextChunkPoolShard) % CHUNK_POOL_SHARD_COUNT) + 1;
+
+  return &pPool->shards[s_chunkPoolShard - 1];
+}
+
+// ----------------------------------------------------------------------------
+static void *udChunkPool_TakeFromShard(udChunkPoolShard *pShard)
+{
+  udChunkPoolFreeChunk *pChunk = nullptr;
+
+  if (pShard->cachedCount == 0)
+    return nullptr;
+
+  udLockMutex(pShard->pMutex);
+  pChunk = pShard->pFreeChunks;
+  if (pChunk)
+  {
+    pShard->pFreeChunks = pChunk->pNext;
+    --pShard->cachedCount;
+  }
+  udReleaseMutex(pShard->pMutex);
+
+  return pChunk;
+}
+
+// ----------------------------------------------------------------------------
+static void *udChunkPool_AllocChunk(udChunkAllocator *pAllocator, size_t chunkSize)
+{
+  udChunkPool *pPool = (udChunkPool*)pAllocator;
+  void *pChunk = nullptr;
+
+  if (chunkSize > pPool->chunkSize)
+    return udAlloc(chunkSize);
+
+  udChunkPoolShard *pShard = udChunkPool_GetShard(pPool);
+  pChunk = udChunkPool_TakeFromShard(pShard);
+
+  // Chunks freed by other threads end up in their shards, take one of those before going to the system
+  for (int i = 1; pChunk == nullptr && i < CHUNK_POOL_SHARD_COUNT; ++i)
+    pChunk = udChunkPool_TakeFromShard(&pPool->shards[(pShard - pPool->shards + i) % CHUNK_POOL_SHARD_COUNT]);
+
+  if (pChunk == nullptr)
+    pChunk = udAlloc(pPool->chunkSize);
+
+  return pChunk;
+}
+
+// ----------------------------------------------------------------------------
+static void udChunkPool_FreeChunk(udChunkAllocator *pAllocator, void *pChunk, size_t chunkSize)
+{
+  udChunkPool *pPool = (udChunkPool*)pAllocator;
+
+  if (chunkSize <= pPool->chunkSize)
+  {
+    udChunkPoolShard *pShard = udChunkPool_GetShard(pPool);
+
+    udLockMutex(pShard->pMutex);
+    if (pShard->cachedCount < pPool->maxCachedPerShard)
+    {
+      udChunkPoolFreeChunk *pFreeChunk = (udChunkPoolFreeChunk*)pChunk;
+      pFreeChunk->pNext = pShard->pFreeChunks;
+      pShard->pFreeChunks = pFreeChunk;
+      ++pShard->cachedCount;
+      pChunk = nullptr;
+    }
+    udReleaseMutex(pShard->pMutex);
+  }
+
+  udFree(pChunk); // Cache is full (or the chunk was never from the pool)
+}
+
+// ----------------------------------------------------------------------------
+udResult udChunkPool_Create(udChunkPool **ppPool, size_t chunkSize, uint32_t maxCachedChunks /*= 256*/)
+{
+  udResult result;
+  udChunkPool *pPool = nullptr;
+
+  UD_ERROR_NULL(ppPool, udR_InvalidParameter_);
+  UD_ERROR_IF(chunkSize == 0, udR_InvalidParameter_);
+
+  pPool = udAllocType(udChunkPool, 1, udAF_Zero);
+  UD_ERROR_NULL(pPool, udR_MemoryAllocationFailure);
+
+  pPool->allocator.pAllocChunk = udChunkPool_AllocChunk;
+  pPool->allocator.pFreeChunk = udChunkPool_FreeChunk;
+  pPool->chunkSize = udMax(chunkSize, sizeof(udChunkPoolFreeChunk));
+  pPool->maxCachedPerShard = (int32_t)((maxCachedChunks + CHUNK_POOL_SHARD_COUNT - 1) / CHUNK_POOL_SHARD_COUNT);
+
+  for (int i = 0; i < CHUNK_POOL_SHARD_COUNT; ++i)
+  {
+    pPool->shards[i].pMutex = udCreateMutex();
+    UD_ERROR_NULL(pPool->shards[i].pMutex, udR_MemoryAllocationFailure);
+  }
+
+  *ppPool = pPool;
+  pPool = nullptr;
+  result = udR_Success;
+
+epilogue:
+  udChunkPool_Destroy(&pPool);
+
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+void udChunkPool_Destroy(udChunkPool **ppPool)
+{
+  if (ppPool == nullptr || *ppPool == nullptr)
+    return;
+
+  udChunkPool *pPool = *ppPool;
+  *ppPool = nullptr;
+
+  for (int i = 0; i < CHUNK_POOL_SHARD_COUNT; ++i)
+  {
+    while (pPool->shards[i].pFreeChunks)
+    {
+      udChunkPoolFreeChunk *pChunk = pPool->shards[i].pFreeChunks;
+      pPool->shards[i].pFreeChunks = pChunk->pNext;
+      udFree(pChunk);
+    }
+
+    udDestroyMutex(&pPool->shards[i].pMutex);
+  }
+
+  udFree(pPool);
+}
+
+// ----------------------------------------------------------------------------
+udChunkAllocator *udChunkPool_GetAllocator(udChunkPool *pPool)
+{
+  if (pPool == nullptr)
+    return nullptr;
+
+  return &pPool->allocator;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t udChunkPool_GetCachedCount(udChunkPool *pPool)
+{
+  uint32_t cachedCount = 0;
+
+  if (pPool == nullptr)
+    return 0;
+
+  for (int i = 0; i < CHUNK_POOL_SHARD_COUNT; ++i)
+    cachedCount += (uint32_t)pPool->shards[i].cachedCount;
+
+  return cachedCount;
+}
@@ -291,6 +291,12 @@ udResult udCryptoCipher_Create(udCryptoCipherContext **ppCtx, udCryptoCiphers ci
   UD_ERROR_CHECK(udBase64Decode(pKey, 0, pCtx->key, sizeof(pCtx->key), &keyLen));
   UD_ERROR_IF((int)keyLen != pCtx->keyLengthInBits / 8, udR_InvalidConfiguration);
   pCtx->ctxInit = false;
+  if (chainMode == udCCM_CTR)
+  {
+    // CTR uses the encrypt key schedule both ways, setting it up now means the context is only read after this
+    mbedtls_aes_setkey_enc(&pCtx->ctx, pCtx->key, pCtx->keyLengthInBits);
+    pCtx->ctxInit = true;
+  }
 
   // Give ownership of the context to the caller
   *ppCtx = pCtx;
@@ -378,11 +384,13 @@ udResult udCryptoCipher_Encrypt(udCryptoCipherContext *pCtx, const udCryptoIV *p
 
           case udCCM_CTR:
             UD_ERROR_IF(pIV == nullptr || pOutIV != nullptr, udR_InvalidParameter_); // Don't allow output IV in CTR mode (yet)
-            memcpy(pCtx->iv, pIV, sizeof(pCtx->iv));
             {
+              // The counter is kept locally rather than in the context so threads can share a CTR context
               size_t ncoff = 0;
+              unsigned char counter[AES_BLOCK_SIZE];
               unsigned char stream_block[16];
-              UD_ERROR_IF(mbedtls_aes_crypt_ctr(&pCtx->ctx, paddedCliperTextLen, &ncoff, pCtx->iv, stream_block, (const unsigned char*)pPaddedPlainText, (unsigned char *)pCipherText) != 0, udR_InternalCryptoError);
+              memcpy(counter, pIV, sizeof(counter));
+              UD_ERROR_IF(mbedtls_aes_crypt_ctr(&pCtx->ctx, paddedCliperTextLen, &ncoff, counter, stream_block, (const unsigned char*)pPaddedPlainText, (unsigned char *)pCipherText) != 0, udR_InternalCryptoError);
             }
             break;
 
@@ -449,16 +457,14 @@ udResult udCryptoCipher_Decrypt(udCryptoCipherContext *pCtx, const udCryptoIV *p
 
         case udCCM_CTR:
           UD_ERROR_IF(pIV == nullptr || pOutIV != nullptr, udR_InvalidParameter_); // Don't allow output IV in CTR mode (yet)
-          if (!pCtx->ctxInit)
-          {
-            mbedtls_aes_setkey_enc(&pCtx->ctx, pCtx->key, pCtx->keyLengthInBits); // NOTE: Using ENCRYPT key schedule for CTR mode
-            pCtx->ctxInit = true;
-          }
-          memcpy(pCtx->iv, pIV, sizeof(pCtx->iv));
+          UDASSERT(pCtx->ctxInit, "CTR key schedule is set up on create"); // NOTE: Using ENCRYPT key schedule for CTR mode
           {
+            // The counter is kept locally rather than in the context so threads can share a CTR context
             size_t ncoff = 0;
+            unsigned char counter[AES_BLOCK_SIZE];
             unsigned char stream_block[16];
-            if (mbedtls_aes_crypt_ctr(&pCtx->ctx, cipherTextLen, &ncoff, pCtx->iv, stream_block, (const unsigned char*)pCipherText, (unsigned char *)pPaddedPlainText) != 0)
+            memcpy(counter, pIV, sizeof(counter));
+            if (mbedtls_aes_crypt_ctr(&pCtx->ctx, cipherTextLen, &ncoff, counter, stream_block, (const unsigned char*)pCipherText, (unsigned char *)pPaddedPlainText) != 0)
             {
               UD_ERROR_SET(udR_Failure_);
             }
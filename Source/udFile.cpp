@@ -8,6 +8,8 @@
 #include "udPlatformUtil.h"
 #include "udStringUtil.h"
 #include "udCrypto.h"
+#include "udWorkerPool.h"
+#include "udParallel.h"
 
 #if UDPLATFORM_WINDOWS
 # include <ShlObj.h>
@@ -17,11 +19,16 @@
 
 #define MAX_HANDLERS 16
 #define CONTENT_LOAD_CHUNK_SIZE 65536 // When loading an entire file of unknown size, read in chunks of this many bytes
+#define UDFILE_READV_BOUNCE_SIZE (256 * 1024) // Largest run of adjacent requests read through a bounce buffer when their buffers aren't adjacent
+#define UDFILE_PIPELINE_CIPHER_OFFSET 4 // udFilePipelinedRequest::reserved slots kept by udFile to decrypt a pipelined request once it arrives
+#define UDFILE_PIPELINE_CIPHER_BUFFER 5
+#define UDFILE_DECRYPT_SLICE_BLOCKS 16384 // Cipher blocks (256KB) in each slice of a large encrypted read that is decrypted on the worker pool
 
 udFile_OpenHandlerFunc udFileHandler_FILEOpen;     // Default crt FILE based handler
 udFile_OpenHandlerFunc udFileHandler_RawOpen;      // Default raw handler
 udFile_OpenHandlerFunc udFileHandler_MiniZOpen;    // Default zip handler
 udFile_OpenHandlerFunc udFileHandler_DataOpen;     // Default data handler
+static udFile_ReadVHandlerFunc udFile_GenericReadV; // Default batched read, used by handlers that don't have their own
 
 struct udFileHandler
 {
@@ -38,6 +45,436 @@ static udFileHandler s_handlers[MAX_HANDLERS] =
 };
 static int s_handlersCount = 4;
 
+#define UDFILE_CACHE_MAX_MISS_RUN 16 // Most missing blocks read from the handler in a single request, and the largest read-ahead window
+#define UDFILE_CACHE_READAHEAD_THREADS 2
+
+// A block of a file held in the cache, the data follows the structure
+struct udFileCacheBlock
+{
+  udFileCacheBlock *pHashNext;
+  udFileCacheBlock *pLRUPrev;   // Towards the most recently used
+  udFileCacheBlock *pLRUNext;
+  struct udFileCacheName *pName;
+  int64_t blockIndex;
+  size_t length;                // Less than the block size only for the block at the end of the file
+};
+
+// Handles to the same filename share blocks, the blocks are dropped when the last of them closes in case the file changes
+struct udFileCacheName
+{
+  udFileCacheName *pNext;
+  char *pFilename;
+  int refCount;
+};
+
+// The cache used by files opened with udFOF_Cache, created by udFile_ConfigureCache
+struct udFileCache
+{
+  udMutex *pMutex;
+  size_t blockSize;
+  size_t memoryBudget;
+  size_t memoryUsed;
+  udFileCacheBlock **ppBuckets;
+  size_t bucketMask;
+  udFileCacheBlock *pLRUHead;
+  udFileCacheBlock *pLRUTail;
+  udFileCacheName *pNames;
+  udConditionVariable *pCondition; // Signalled when a read-ahead completes
+  int waiters;
+  udWorkerPool *pReadAheadPool;
+};
+static udFileCache *s_pFileCache;
+static udWorkerPool *s_pFileWorkerPool; // Set by the application, used to decrypt large encrypted reads in parallel
+
+// ----------------------------------------------------------------------------
+static udFileCacheBlock **udFileCache_Bucket(udFileCache *pCache, udFileCacheName *pName, int64_t blockIndex)
+{
+  uint64_t hash = ((uint64_t)(size_t)pName >> 4) * 0x9E3779B97F4A7C15ULL + (uint64_t)blockIndex * 0xC2B2AE3D27D4EB4FULL;
+  return &pCache->ppBuckets[(size_t)(hash >> 32) & pCache->bucketMask];
+}
+
+// ----------------------------------------------------------------------------
+// Must be called with the cache mutex held
+static udFileCacheBlock *udFileCache_Find(udFileCache *pCache, udFileCacheName *pName, int64_t blockIndex)
+{
+  udFileCacheBlock *pBlock = *udFileCache_Bucket(pCache, pName, blockIndex);
+  while (pBlock && (pBlock->pName != pName || pBlock->blockIndex != blockIndex))
+    pBlock = pBlock->pHashNext;
+  return pBlock;
+}
+
+// ----------------------------------------------------------------------------
+// Must be called with the cache mutex held
+static void udFileCache_Unlink(udFileCache *pCache, udFileCacheBlock *pBlock)
+{
+  if (pBlock->pLRUPrev)
+    pBlock->pLRUPrev->pLRUNext = pBlock->pLRUNext;
+  else
+    pCache->pLRUHead = pBlock->pLRUNext;
+  if (pBlock->pLRUNext)
+    pBlock->pLRUNext->pLRUPrev = pBlock->pLRUPrev;
+  else
+    pCache->pLRUTail = pBlock->pLRUPrev;
+}
+
+// ----------------------------------------------------------------------------
+// Must be called with the cache mutex held
+static void udFileCache_MoveToFront(udFileCache *pCache, udFileCacheBlock *pBlock)
+{
+  if (pCache->pLRUHead == pBlock)
+    return;
+  udFileCache_Unlink(pCache, pBlock);
+  pBlock->pLRUPrev = nullptr;
+  pBlock->pLRUNext = pCache->pLRUHead;
+  if (pCache->pLRUHead)
+    pCache->pLRUHead->pLRUPrev = pBlock;
+  else
+    pCache->pLRUTail = pBlock;
+  pCache->pLRUHead = pBlock;
+}
+
+// ----------------------------------------------------------------------------
+// Must be called with the cache mutex held
+static void udFileCache_Remove(udFileCache *pCache, udFileCacheBlock *pBlock)
+{
+  udFileCacheBlock **ppBucket = udFileCache_Bucket(pCache, pBlock->pName, pBlock->blockIndex);
+  while (*ppBucket != pBlock)
+    ppBucket = &(*ppBucket)->pHashNext;
+  *ppBucket = pBlock->pHashNext;
+
+  udFileCache_Unlink(pCache, pBlock);
+  pCache->memoryUsed -= sizeof(udFileCacheBlock) + pBlock->length;
+  udFree(pBlock);
+}
+
+// ----------------------------------------------------------------------------
+// Must be called with the cache mutex held, evicts least recently used blocks to stay within the budget
+static void udFileCache_Insert(udFileCache *pCache, udFileCacheName *pName, int64_t blockIndex, const void *pData, size_t length)
+{
+  if (udFileCache_Find(pCache, pName, blockIndex))
+    return; // Another thread read it at the same time
+
+  udFileCacheBlock *pBlock = (udFileCacheBlock*)udAlloc(sizeof(udFileCacheBlock) + length);
+  if (pBlock == nullptr)
+    return; // Caching is optional, the caller already has the data
+
+  udFileCacheBlock **ppBucket = udFileCache_Bucket(pCache, pName, blockIndex);
+  pBlock->pHashNext = *ppBucket;
+  *ppBucket = pBlock;
+  pBlock->pLRUPrev = nullptr;
+  pBlock->pLRUNext = pCache->pLRUHead;
+  if (pCache->pLRUHead)
+    pCache->pLRUHead->pLRUPrev = pBlock;
+  else
+    pCache->pLRUTail = pBlock;
+  pCache->pLRUHead = pBlock;
+  pBlock->pName = pName;
+  pBlock->blockIndex = blockIndex;
+  pBlock->length = length;
+  memcpy(pBlock + 1, pData, length);
+  pCache->memoryUsed += sizeof(udFileCacheBlock) + length;
+
+  while (pCache->memoryUsed > pCache->memoryBudget && pCache->pLRUTail)
+    udFileCache_Remove(pCache, pCache->pLRUTail);
+}
+
+// ----------------------------------------------------------------------------
+// Must be called with the cache mutex held, waits for the file's read-ahead to complete
+static void udFileCache_WaitForReadAhead(udFileCache *pCache, udFile *pFile)
+{
+  while (pFile->readAheadEnd)
+  {
+    ++pCache->waiters;
+    udWaitConditionVariable(pCache->pCondition, pCache->pMutex);
+    --pCache->waiters;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Start using the cache for a file if it's configured
+static void udFileCache_Attach(udFile *pFile)
+{
+  udFileCache *pCache = s_pFileCache;
+  udFileCacheName *pName = nullptr;
+
+  if (pCache == nullptr || pFile->pFilenameCopy == nullptr)
+    return;
+
+  udLockMutex(pCache->pMutex);
+  for (pName = pCache->pNames; pName && !udStrEqual(pName->pFilename, pFile->pFilenameCopy); pName = pName->pNext)
+    ;
+  if (pName == nullptr)
+  {
+    pName = udAllocType(udFileCacheName, 1, udAF_Zero);
+    if (pName)
+    {
+      pName->pFilename = udStrdup(pFile->pFilenameCopy);
+      if (pName->pFilename)
+      {
+        pName->pNext = pCache->pNames;
+        pCache->pNames = pName;
+      }
+      else
+      {
+        udFree(pName);
+      }
+    }
+  }
+  if (pName)
+  {
+    ++pName->refCount;
+    pFile->pCacheName = pName;
+  }
+  udReleaseMutex(pCache->pMutex);
+}
+
+// ----------------------------------------------------------------------------
+// Stop using the cache for a file, dropping the blocks for its filename if it was the last handle
+static void udFileCache_Detach(udFile *pFile)
+{
+  udFileCache *pCache = s_pFileCache;
+  udFileCacheName *pName = pFile->pCacheName;
+
+  if (pName == nullptr)
+    return;
+
+  udLockMutex(pCache->pMutex);
+  udFileCache_WaitForReadAhead(pCache, pFile);
+  pFile->pCacheName = nullptr;
+  if (--pName->refCount == 0)
+  {
+    for (udFileCacheBlock *pBlock = pCache->pLRUHead, *pNext; pBlock; pBlock = pNext)
+    {
+      pNext = pBlock->pLRUNext;
+      if (pBlock->pName == pName)
+        udFileCache_Remove(pCache, pBlock);
+    }
+
+    udFileCacheName **ppName = &pCache->pNames;
+    while (*ppName != pName)
+      ppName = &(*ppName)->pNext;
+    *ppName = pName->pNext;
+    udFree(pName->pFilename);
+    udFree(pName);
+  }
+  udReleaseMutex(pCache->pMutex);
+}
+
+// ----------------------------------------------------------------------------
+// Runs on the read-ahead pool to add the blocks the file has set up in readAheadFirst/readAheadEnd
+static void udFileCache_ReadAhead(void *pUserData)
+{
+  UDTRACE();
+  udFile *pFile = (udFile*)pUserData;
+  udFileCache *pCache = s_pFileCache;
+  size_t blockSize = pCache->blockSize;
+  size_t runLength = (size_t)(pFile->readAheadEnd - pFile->readAheadFirst) * blockSize;
+  size_t runRead = 0;
+  uint8_t *pRunBuffer = udAllocType(uint8_t, runLength, udAF_None);
+
+  if (pRunBuffer && pFile->fpRead(pFile, pRunBuffer, runLength, pFile->readAheadFirst * (int64_t)blockSize, &runRead, nullptr) != udR_Success)
+    runRead = 0;
+
+  udLockMutex(pCache->pMutex);
+  for (size_t i = 0; i * blockSize < runRead; ++i)
+    udFileCache_Insert(pCache, pFile->pCacheName, pFile->readAheadFirst + (int64_t)i, pRunBuffer + i * blockSize, udMin(blockSize, runRead - i * blockSize));
+  pFile->readAheadFirst = 0;
+  pFile->readAheadEnd = 0;
+  if (pCache->waiters)
+    udSignalConditionVariable(pCache->pCondition, pCache->waiters);
+  udReleaseMutex(pCache->pMutex);
+
+  udFree(pRunBuffer);
+}
+
+// ----------------------------------------------------------------------------
+// Read through the cache, runs of missing blocks are read from the handler together and then added
+// Sequential reads grow a read-ahead window, the blocks after the read are fetched in the background for
+// udFOF_Multithread files, otherwise they're added to the run read from the handler
+static udResult udFileCache_Read(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t offset, size_t *pActualRead)
+{
+  UDTRACE();
+  udFileCache *pCache = s_pFileCache;
+  udResult result = udR_Success;
+  uint8_t *pRunBuffer = nullptr;
+  size_t actualRead = 0;
+  size_t blockSize = pCache->blockSize;
+  int64_t blockIndex = offset / (int64_t)blockSize;
+  size_t blockOffset = (size_t)(offset % (int64_t)blockSize);
+  bool endOfFile = false;
+  bool background = (pFile->flagsCopy & udFOF_Multithread) && pCache->pReadAheadPool;
+  size_t readAhead;
+
+  UD_ERROR_IF(offset < 0, udR_InvalidParameter_);
+
+  udLockMutex(pCache->pMutex);
+  if (offset == pFile->readAheadOffset && bufferLength)
+    pFile->readAheadBlocks = udMin(udMax(pFile->readAheadBlocks * 2, 1), UDFILE_CACHE_MAX_MISS_RUN);
+  else
+    pFile->readAheadBlocks = 0;
+  pFile->readAheadOffset = offset + (int64_t)bufferLength;
+  readAhead = (size_t)pFile->readAheadBlocks;
+  udReleaseMutex(pCache->pMutex);
+
+  while (actualRead < bufferLength && !endOfFile)
+  {
+    size_t missCount = 0;
+
+    udLockMutex(pCache->pMutex);
+    while (actualRead < bufferLength && !endOfFile)
+    {
+      udFileCacheBlock *pBlock = udFileCache_Find(pCache, pFile->pCacheName, blockIndex);
+      if (pBlock == nullptr)
+      {
+        if (blockIndex < pFile->readAheadFirst || blockIndex >= pFile->readAheadEnd)
+          break;
+        udFileCache_WaitForReadAhead(pCache, pFile); // Already on the way
+        continue;
+      }
+
+      udFileCache_MoveToFront(pCache, pBlock);
+      ++pFile->cacheHits;
+      size_t copyLength = (pBlock->length > blockOffset) ? udMin(bufferLength - actualRead, pBlock->length - blockOffset) : 0;
+      memcpy(udAddBytes(pBuffer, actualRead), udAddBytes(pBlock + 1, blockOffset), copyLength);
+      actualRead += copyLength;
+      endOfFile = (pBlock->length < blockSize);
+      ++blockIndex;
+      blockOffset = 0;
+    }
+
+    if (actualRead < bufferLength && !endOfFile)
+    {
+      size_t blocksWanted = (blockOffset + bufferLength - actualRead + blockSize - 1) / blockSize;
+      if (!background)
+        blocksWanted += readAhead;
+      for (missCount = 1; missCount < blocksWanted && missCount < UDFILE_CACHE_MAX_MISS_RUN && !udFileCache_Find(pCache, pFile->pCacheName, blockIndex + (int64_t)missCount); ++missCount)
+        ;
+      pFile->cacheMisses += missCount;
+    }
+    udReleaseMutex(pCache->pMutex);
+
+    if (missCount)
+    {
+      size_t runLength = missCount * blockSize;
+      size_t runRead = 0;
+
+      if (pRunBuffer == nullptr)
+        pRunBuffer = udAllocType(uint8_t, UDFILE_CACHE_MAX_MISS_RUN * blockSize, udAF_None);
+      UD_ERROR_NULL(pRunBuffer, udR_MemoryAllocationFailure);
+      UD_ERROR_CHECK(pFile->fpRead(pFile, pRunBuffer, runLength, blockIndex * (int64_t)blockSize, &runRead, nullptr));
+
+      size_t copyLength = (runRead > blockOffset) ? udMin(bufferLength - actualRead, runRead - blockOffset) : 0;
+      memcpy(udAddBytes(pBuffer, actualRead), pRunBuffer + blockOffset, copyLength);
+      actualRead += copyLength;
+      endOfFile = (runRead < runLength);
+
+      // A short block marks the end of the file, so nothing after it is added
+      udLockMutex(pCache->pMutex);
+      for (size_t i = 0; i < missCount && i * blockSize <= runRead; ++i)
+        udFileCache_Insert(pCache, pFile->pCacheName, blockIndex + (int64_t)i, pRunBuffer + i * blockSize, udMin(blockSize, runRead - i * blockSize));
+      udReleaseMutex(pCache->pMutex);
+
+      blockIndex += (int64_t)missCount;
+      blockOffset = 0;
+    }
+  }
+
+  if (background && readAhead && !endOfFile)
+  {
+    // Start from the first block after the read that isn't already cached, one read-ahead per file at a time
+    int64_t firstBlock = (offset + (int64_t)bufferLength + (int64_t)blockSize - 1) / (int64_t)blockSize;
+    int64_t endBlock = firstBlock + (int64_t)readAhead;
+
+    udLockMutex(pCache->pMutex);
+    while (firstBlock < endBlock && udFileCache_Find(pCache, pFile->pCacheName, firstBlock))
+      ++firstBlock;
+    if (firstBlock < endBlock && pFile->readAheadEnd == 0)
+    {
+      pFile->readAheadFirst = firstBlock;
+      pFile->readAheadEnd = endBlock;
+      if (udWorkerPool_AddTask(pCache->pReadAheadPool, udFileCache_ReadAhead, pFile, false) != udR_Success)
+        pFile->readAheadFirst = pFile->readAheadEnd = 0;
+    }
+    udReleaseMutex(pCache->pMutex);
+  }
+
+epilogue:
+  if (pActualRead)
+    *pActualRead = actualRead;
+  udFree(pRunBuffer);
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+// Call the handler's SeekRead, through the cache if the file is using it
+static udResult udFile_SeekRead(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t offset, size_t *pActualRead, udFilePipelinedRequest *pPipelinedRequest)
+{
+  if (pFile->pCacheName)
+    return udFileCache_Read(pFile, pBuffer, bufferLength, offset, pActualRead);
+
+  return pFile->fpRead(pFile, pBuffer, bufferLength, offset, pActualRead, pPipelinedRequest);
+}
+
+// ----------------------------------------------------------------------------
+// Pipelined requests only go to the handler when it supports them, and not through the cache
+static bool udFile_HandlerPipelines(udFile *pFile)
+{
+  return pFile->fpBlockPipedRequest != nullptr && pFile->pCacheName == nullptr;
+}
+
+// ****************************************************************************
+udResult udFile_ConfigureCache(size_t blockSize, size_t memoryBudget)
+{
+  udResult result;
+  udFileCache *pCache = nullptr;
+
+  UD_ERROR_IF(s_pFileCache && s_pFileCache->pNames, udR_NotAllowed);
+  UD_ERROR_IF(memoryBudget && !blockSize, udR_InvalidParameter_);
+
+  if (s_pFileCache)
+  {
+    udWorkerPool_Destroy(&s_pFileCache->pReadAheadPool);
+    udDestroyConditionVariable(&s_pFileCache->pCondition);
+    udDestroyMutex(&s_pFileCache->pMutex);
+    udFree(s_pFileCache->ppBuckets);
+    udFree(s_pFileCache);
+  }
+
+  if (memoryBudget)
+  {
+    size_t bucketCount = 64;
+    while (bucketCount < memoryBudget / blockSize)
+      bucketCount <<= 1;
+
+    pCache = udAllocType(udFileCache, 1, udAF_Zero);
+    UD_ERROR_NULL(pCache, udR_MemoryAllocationFailure);
+    pCache->ppBuckets = udAllocType(udFileCacheBlock*, bucketCount, udAF_Zero);
+    UD_ERROR_NULL(pCache->ppBuckets, udR_MemoryAllocationFailure);
+    pCache->pMutex = udCreateMutex();
+    UD_ERROR_NULL(pCache->pMutex, udR_MemoryAllocationFailure);
+    pCache->pCondition = udCreateConditionVariable();
+    UD_ERROR_NULL(pCache->pCondition, udR_MemoryAllocationFailure);
+    UD_ERROR_CHECK(udWorkerPool_Create(&pCache->pReadAheadPool, UDFILE_CACHE_READAHEAD_THREADS, "udFileReadAhead"));
+    pCache->bucketMask = bucketCount - 1;
+    pCache->blockSize = blockSize;
+    pCache->memoryBudget = memoryBudget;
+    s_pFileCache = pCache;
+    pCache = nullptr;
+  }
+  result = udR_Success;
+
+epilogue:
+  if (pCache)
+  {
+    if (pCache->pCondition)
+      udDestroyConditionVariable(&pCache->pCondition);
+    udDestroyMutex(&pCache->pMutex);
+    udFree(pCache->ppBuckets);
+    udFree(pCache);
+  }
+  return result;
+}
+
 // ----------------------------------------------------------------------------
 // Author: Dave Pevreal, October 2014
 udResult udFile_GenericLoad(udFile *pFile, void **ppMemory, int64_t *pFileLengthInBytes)
@@ -160,8 +597,12 @@ udResult udFile_Open(udFile **ppFile, const char *pFilename, udFileOpenFlags fla
 
       if (!(*ppFile)->fpLoad)
         (*ppFile)->fpLoad = udFile_GenericLoad;
+      if (!(*ppFile)->fpReadV)
+        (*ppFile)->fpReadV = udFile_GenericReadV;
 
       (*ppFile)->flagsCopy = flags;
+      if ((flags & udFOF_Cache) && !(flags & (udFOF_Write | udFOF_Create)))
+        udFileCache_Attach(*ppFile);
       if (pFileLengthInBytes)
         *pFileLengthInBytes = (*ppFile)->fileLength;
 
@@ -197,6 +638,7 @@ udResult udFile_SetSubFilename(udFile *pFile, const char *pSubFilename, int64_t
   UD_ERROR_NULL(pFile, udR_InvalidParameter_);
   UD_ERROR_NULL(pFile->fpSetSubFilename, udR_InvalidConfiguration);
 
+  udFileCache_Detach(pFile); // The cache is by filename, so a sub file can't use it
   result = pFile->fpSetSubFilename(pFile, pSubFilename);
   if (pFileLengthInBytes)
     *pFileLengthInBytes = pFile->fileLength;
@@ -247,23 +689,109 @@ udResult udFile_GetPerformance(udFile *pFile, udFilePerformance *pPerformance)
   if (!pFile || !pPerformance)
     return udR_InvalidParameter_;
 
-  pPerformance->throughput = pFile->totalBytes;
+  pPerformance->throughput = (uint64_t)pFile->totalBytes;
   pPerformance->mbPerSec = pFile->mbPerSec;
   pPerformance->requestsInFlight = pFile->requestsInFlight;
+  pPerformance->cacheHits = pFile->cacheHits;
+  pPerformance->cacheMisses = pFile->cacheMisses;
 
   return udR_Success;
 }
 
 
+// ****************************************************************************
+void udFile_SetWorkerPool(udWorkerPool *pPool)
+{
+  s_pFileWorkerPool = pPool;
+}
+
+
+// ----------------------------------------------------------------------------
+// Decrypt one partial block of length bytes starting inset bytes into its block, through a bounce block so the caller's buffer needn't cover the whole block
+static udResult udFile_DecryptPartialBlock(udFile *pFile, uint8_t *pData, size_t inset, size_t length, int64_t counter)
+{
+  udResult result;
+  udCryptoIV iv;
+  uint8_t bounce[16] = {};
+
+  memcpy(bounce + inset, pData, length);
+  UD_ERROR_CHECK(udCrypto_CreateIVForCTRMode(pFile->pCipherCtx, &iv, pFile->nonce, counter));
+  UD_ERROR_CHECK(udCryptoCipher_Decrypt(pFile->pCipherCtx, &iv, bounce, sizeof(bounce), bounce, sizeof(bounce)));
+  memcpy(pData, bounce + inset, length);
+
+epilogue:
+  return result;
+}
+
+
+// ----------------------------------------------------------------------------
+// Decrypt length bytes of ciphertext read from offset in place, the whole blocks in the middle are split into slices that are decrypted in parallel
+static udResult udFile_DecryptInPlace(udFile *pFile, uint8_t *pData, size_t length, int64_t offset)
+{
+  UDTRACE();
+  udResult result = udR_Success;
+  size_t inset = (size_t)(offset & 15);
+  int64_t counter = ((offset - pFile->seekBase) / 16) + pFile->counterOffset;
+  size_t blockCount;
+
+  if (inset && length)
+  {
+    size_t headLength = udMin(16 - inset, length);
+    UD_ERROR_CHECK(udFile_DecryptPartialBlock(pFile, pData, inset, headLength, counter));
+    pData += headLength;
+    length -= headLength;
+    ++counter;
+  }
+
+  blockCount = length / 16;
+  if (blockCount)
+  {
+    volatile int32_t failures = 0;
+    udWorkerPool *pPool = (blockCount >= UDFILE_DECRYPT_SLICE_BLOCKS * 2) ? s_pFileWorkerPool : nullptr;
+    udCallback<void(size_t, size_t)> decryptSlice = [pFile, pData, counter, &failures](size_t startBlock, size_t endBlock) {
+      udCryptoIV iv;
+      uint8_t *pSlice = pData + startBlock * 16;
+      size_t sliceLength = (endBlock - startBlock) * 16;
+      if (udCrypto_CreateIVForCTRMode(pFile->pCipherCtx, &iv, pFile->nonce, counter + (int64_t)startBlock) != udR_Success ||
+          udCryptoCipher_Decrypt(pFile->pCipherCtx, &iv, pSlice, sliceLength, pSlice, sliceLength) != udR_Success)
+        udInterlockedPreIncrement(&failures);
+    };
+    UD_ERROR_CHECK(udParallelFor(pPool, 0, blockCount, UDFILE_DECRYPT_SLICE_BLOCKS, decryptSlice));
+    UD_ERROR_IF(failures != 0, udR_InternalCryptoError);
+    pData += blockCount * 16;
+    length -= blockCount * 16;
+    counter += (int64_t)blockCount;
+  }
+
+  if (length)
+    UD_ERROR_CHECK(udFile_DecryptPartialBlock(pFile, pData, 0, length, counter));
+
+epilogue:
+  return result;
+}
+
+
+// ----------------------------------------------------------------------------
+// Time is only accumulated while requests are in flight, and overlapping requests from several threads are only counted once
+static void udBeginFilePerformance(udFile *pFile)
+{
+  if (udInterlockedPreIncrement(&pFile->requestsInFlight) == 1)
+    udInterlockedAdd(&pFile->msAccumulator, -(int32_t)udGetTimeMs());
+}
+
+
 // ----------------------------------------------------------------------------
 // Author: Dave Pevreal, March 2014
 static void udUpdateFilePerformance(udFile *pFile, size_t actualRead)
 {
   UDTRACE();
-  pFile->msAccumulator += udGetTimeMs();
-  pFile->totalBytes += actualRead;
-  if (--pFile->requestsInFlight == 0)
-    pFile->mbPerSec = float((pFile->totalBytes/1048576.0) / (pFile->msAccumulator / 1000.0));
+  int64_t totalBytes = udInterlockedAdd64(&pFile->totalBytes, (int64_t)actualRead);
+  if (udInterlockedPreDecrement(&pFile->requestsInFlight) == 0)
+  {
+    int32_t msAccumulator = udInterlockedAdd(&pFile->msAccumulator, (int32_t)udGetTimeMs());
+    if (msAccumulator >= 0) // Negative only if another request began before the add above, in which case it will update the rate instead
+      pFile->mbPerSec = float((totalBytes/1048576.0) / (msAccumulator / 1000.0));
+  }
 }
 
 
@@ -275,7 +803,6 @@ udResult udFile_Read(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t
   udResult result;
   size_t actualRead = 0;
   int64_t offset;
-  void *pCipherText = nullptr;
 
   UD_ERROR_NULL(pFile, udR_InvalidParameter_);
   UD_ERROR_NULL(pFile->fpRead, udR_InvalidConfiguration);
@@ -289,45 +816,30 @@ udResult udFile_Read(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t
       UD_ERROR_SET(udR_InvalidParameter_);
   }
 
-  ++pFile->requestsInFlight;
-  pFile->msAccumulator -= udGetTimeMs();
-  if (pFile->pCipherCtx)
+  udBeginFilePerformance(pFile);
+  result = udFile_SeekRead(pFile, pBuffer, bufferLength, offset, &actualRead, udFile_HandlerPipelines(pFile) ? pPipelinedRequest : nullptr);
+  if (pPipelinedRequest && udFile_HandlerPipelines(pFile))
   {
-    // Handle reading encrypted data
-    int inset = (int)offset & 15;
-    int padding = (16 - ((offset + bufferLength) & 15)) & 15;
-    size_t alignedActual;
-    if (inset || padding)
-      pCipherText = udAlloc(inset + bufferLength + padding);
-    else
-      pCipherText = pBuffer;
-    UD_ERROR_NULL(pCipherText, udR_MemoryAllocationFailure);
-    udCryptoIV iv;
-    result = udCrypto_CreateIVForCTRMode(pFile->pCipherCtx, &iv, pFile->nonce, ((offset - pFile->seekBase) / 16) + pFile->counterOffset);
-    UD_ERROR_HANDLE();
-    result = pFile->fpRead(pFile, pCipherText, inset + bufferLength + padding, offset - inset, &alignedActual, nullptr); // Don't handle pipelined requests with encryption
-    UD_ERROR_HANDLE();
-    result = udCryptoCipher_Decrypt(pFile->pCipherCtx, &iv, pCipherText, alignedActual, pCipherText, alignedActual);
-    UD_ERROR_HANDLE();
-    actualRead = udMin(bufferLength, udMax((size_t)0, alignedActual - (size_t)inset));
-    if (pCipherText != pBuffer)
-      memcpy(pBuffer, udAddBytes(pCipherText, inset), actualRead);
+    // Encrypted data is only in the buffer once the request is blocked on, so the decryption waits until then
+    pPipelinedRequest->reserved[UDFILE_PIPELINE_CIPHER_OFFSET] = (uint64_t)offset;
+    pPipelinedRequest->reserved[UDFILE_PIPELINE_CIPHER_BUFFER] = pFile->pCipherCtx ? (uint64_t)(size_t)pBuffer : 0;
   }
-  else
+  else if (pFile->pCipherCtx && result == udR_Success)
   {
-    result = pFile->fpRead(pFile, pBuffer, bufferLength, offset, &actualRead, pFile->fpBlockPipedRequest ? pPipelinedRequest : nullptr);
+    // CTR mode lets the ciphertext be read straight into the caller's buffer and decrypted in place
+    result = udFile_DecryptInPlace(pFile, (uint8_t*)pBuffer, actualRead, offset);
   }
   pFile->filePos = offset + actualRead;
 
   // Save off the actualRead in the request for the case where the handler doesn't support piped requests
-  if (pPipelinedRequest && (!pFile->fpBlockPipedRequest))
+  if (pPipelinedRequest && !udFile_HandlerPipelines(pFile))
   {
     pPipelinedRequest->reserved[0] = (uint64_t)actualRead;
     pPipelinedRequest = nullptr;
   }
 
   // Update the performance stats unless it's a supported pipelined request (in which case the stats are updated in the block function)
-  if (!pPipelinedRequest || !pFile->fpBlockPipedRequest)
+  if (!pPipelinedRequest || !udFile_HandlerPipelines(pFile))
     udUpdateFilePerformance(pFile, actualRead);
 
   if (pActualRead)
@@ -340,8 +852,140 @@ udResult udFile_Read(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t
     result = udR_ReadFailure;
 
 epilogue:
-  if (pCipherText != nullptr && pCipherText != pBuffer)
-    udFree(pCipherText);
+  return result;
+}
+
+
+// ----------------------------------------------------------------------------
+// Generic implementation of ReadV, adjacent requests become a single SeekRead either straight into their buffers
+// when those follow on from each other as well, or through a bounce buffer when they don't
+static udResult udFile_GenericReadV(udFile *pFile, const udFileReadRequest *pRequests, size_t count, size_t *pActualReads)
+{
+  UDTRACE();
+  udResult result = udR_Success;
+  uint8_t *pBounce = nullptr;
+
+  for (size_t first = 0, last; first < count; first = last + 1)
+  {
+    size_t runLength = pRequests[first].bufferLength;
+    bool contiguous = true;
+
+    for (last = first; last + 1 < count; ++last)
+    {
+      const udFileReadRequest &prev = pRequests[last];
+      const udFileReadRequest &next = pRequests[last + 1];
+      if (next.seekOffset != prev.seekOffset + (int64_t)prev.bufferLength)
+        break;
+      if (next.pBuffer != udAddBytes(prev.pBuffer, prev.bufferLength))
+      {
+        if (runLength + next.bufferLength > UDFILE_READV_BOUNCE_SIZE)
+          break;
+        contiguous = false;
+      }
+      runLength += next.bufferLength;
+    }
+
+    void *pTarget = pRequests[first].pBuffer;
+    if (!contiguous)
+    {
+      if (pBounce == nullptr)
+        pBounce = udAllocType(uint8_t, UDFILE_READV_BOUNCE_SIZE, udAF_None);
+      UD_ERROR_NULL(pBounce, udR_MemoryAllocationFailure);
+      pTarget = pBounce;
+    }
+
+    size_t actualRead = 0;
+    result = udFile_SeekRead(pFile, pTarget, runLength, pRequests[first].seekOffset, &actualRead, nullptr);
+
+    for (size_t i = first, runOffset = 0; i <= last; runOffset += pRequests[i].bufferLength, ++i)
+    {
+      pActualReads[i] = (actualRead > runOffset) ? udMin(pRequests[i].bufferLength, actualRead - runOffset) : 0;
+      if (!contiguous && pActualReads[i])
+        memcpy(pRequests[i].pBuffer, pBounce + runOffset, pActualReads[i]);
+    }
+    UD_ERROR_HANDLE();
+  }
+
+epilogue:
+  udFree(pBounce);
+  return result;
+}
+
+
+// ****************************************************************************
+udResult udFile_ReadV(udFile *pFile, const udFileReadRequest *pRequests, size_t count)
+{
+  UDTRACE();
+  udResult result;
+  udFileReadRequest *pAbsolute = nullptr;
+  size_t *pActualReads = nullptr;
+  size_t totalRead = 0;
+
+  UD_ERROR_IF(pFile == nullptr || (pRequests == nullptr && count > 0), udR_InvalidParameter_);
+  UD_ERROR_NULL(pFile->fpRead, udR_InvalidConfiguration);
+  UD_ERROR_IF(count == 0, udR_Success);
+
+  if (pFile->pCipherCtx)
+  {
+    // Decryption is done per request by udFile_Read
+    for (size_t i = 0; i < count; ++i)
+      UD_ERROR_CHECK(udFile_Read(pFile, pRequests[i].pBuffer, pRequests[i].bufferLength, pRequests[i].seekOffset, udFSW_SeekSet, pRequests[i].pActualRead));
+    UD_ERROR_SET(udR_Success);
+  }
+
+  // Handlers are given offsets that include the seek base, and an array for the amounts read
+  pAbsolute = (udFileReadRequest*)udAlloc(count * (sizeof(udFileReadRequest) + sizeof(size_t)));
+  UD_ERROR_NULL(pAbsolute, udR_MemoryAllocationFailure);
+  pActualReads = (size_t*)(pAbsolute + count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    pAbsolute[i] = pRequests[i];
+    pAbsolute[i].seekOffset += pFile->seekBase;
+    pAbsolute[i].pActualRead = nullptr;
+    pActualReads[i] = 0;
+  }
+
+  udBeginFilePerformance(pFile);
+  if (pFile->fpReadV && !pFile->pCacheName)
+    result = pFile->fpReadV(pFile, pAbsolute, count, pActualReads);
+  else
+    result = udFile_GenericReadV(pFile, pAbsolute, count, pActualReads); // Cached reads are only done through SeekRead
+  for (size_t i = 0; i < count; ++i)
+  {
+    totalRead += pActualReads[i];
+    if (pRequests[i].pActualRead)
+      *pRequests[i].pActualRead = pActualReads[i];
+    else if (result == udR_Success && pActualReads[i] != pRequests[i].bufferLength)
+      result = udR_ReadFailure;
+  }
+  pFile->filePos = pAbsolute[count - 1].seekOffset + pActualReads[count - 1];
+  udUpdateFilePerformance(pFile, totalRead);
+
+epilogue:
+  udFree(pAbsolute);
+  return result;
+}
+
+
+// ****************************************************************************
+udResult udFile_Borrow(udFile *pFile, const void **ppData, size_t length, int64_t seekOffset, size_t *pActualLength)
+{
+  UDTRACE();
+  udResult result;
+  size_t actualLength = 0;
+
+  UD_ERROR_IF(pFile == nullptr || ppData == nullptr, udR_InvalidParameter_);
+  UD_ERROR_IF(pFile->fpBorrow == nullptr || pFile->pCipherCtx != nullptr, udR_Unsupported);
+
+  result = pFile->fpBorrow(pFile, ppData, length, seekOffset + pFile->seekBase, &actualLength);
+  if (pActualLength)
+    *pActualLength = actualLength;
+
+  // As with udFile_Read, not getting the full amount is an error if the caller isn't checking
+  if (result == udR_Success && pActualLength == nullptr && actualLength != length)
+    result = udR_ReadFailure;
+
+epilogue:
   return result;
 }
 
@@ -367,8 +1011,7 @@ udResult udFile_Write(udFile *pFile, const void *pBuffer, size_t bufferLength, i
     UD_ERROR_SET(udR_InvalidParameter_);
   }
 
-  ++pFile->requestsInFlight;
-  pFile->msAccumulator -= udGetTimeMs();
+  udBeginFilePerformance(pFile);
   result = pFile->fpWrite(pFile, pBuffer, bufferLength, offset, &actualWritten);
   pFile->filePos = offset + actualWritten;
 
@@ -396,10 +1039,13 @@ udResult udFile_BlockForPipelinedRequest(udFile *pFile, udFilePipelinedRequest *
   UDTRACE();
   udResult result;
 
-  if (pFile->fpBlockPipedRequest)
+  if (udFile_HandlerPipelines(pFile))
   {
-    size_t actualRead;
+    size_t actualRead = 0;
+    uint8_t *pCipherBuffer = (uint8_t*)(size_t)pPipelinedRequest->reserved[UDFILE_PIPELINE_CIPHER_BUFFER];
     result = pFile->fpBlockPipedRequest(pFile, pPipelinedRequest, &actualRead);
+    if (result == udR_Success && pCipherBuffer && pFile->pCipherCtx)
+      result = udFile_DecryptInPlace(pFile, pCipherBuffer, actualRead, (int64_t)pPipelinedRequest->reserved[UDFILE_PIPELINE_CIPHER_OFFSET]);
     udUpdateFilePerformance(pFile, actualRead);
     if (pActualRead)
       *pActualRead = actualRead;
@@ -437,6 +1083,7 @@ udResult udFile_Close(udFile **ppFile)
   udFile *pFile = *ppFile;
   if (pFile)
   {
+    udFileCache_Detach(pFile);
     if (pFile->filenameCopyRequiresFree)
       udFree(pFile->pFilenameCopy);
     if (pFile->pCipherCtx)
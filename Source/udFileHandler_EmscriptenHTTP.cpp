@@ -116,4 +116,13 @@ udResult udFile_RegisterHTTP()
   return result;
 }
 
+// ----------------------------------------------------------------------------
+udResult udFile_ConfigureHTTPConnections(int maxConnectionsPerHost, int idleTimeoutMs)
+{
+  // The browser manages its own connections
+  if (maxConnectionsPerHost < 0 || idleTimeoutMs < 0)
+    return udR_InvalidParameter_;
+  return udR_Success;
+}
+
 #endif // UDPLATFORM_EMSCRIPTEN
@@ -0,0 +1,452 @@
+//
+// Copyright (c) Euclideon Pty Ltd
+//
+// POSIX file descriptor handler for local files opened with udFOF_Multithread. Reads and writes use pread/pwrite
+// which take their own offset, so there's no shared file position to protect and no stdio buffering in between
+// Pipelined reads are issued to a shared pool of i/o threads so many reads can be outstanding at once, the number of
+// threads is the queue depth (see udFile_ConfigureAsyncReads). io_uring isn't used, there's no liburing dependency
+//
+
+#define _FILE_OFFSET_BITS 64
+
+#include "udFile.h"
+#include "udFileHandler.h"
+#include "udPlatformUtil.h"
+#include "udStringUtil.h"
+#include "udWorkerPool.h"
+
+#if UDPLATFORM_LINUX || UDPLATFORM_OSX || UDPLATFORM_IOS || UDPLATFORM_IOS_SIMULATOR || UDPLATFORM_ANDROID
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define UDFILE_FD_SUPPORTED 1
+#endif
+#if UDPLATFORM_LINUX
+# include <sys/uio.h>
+# define UDFILE_FD_PREADV 1
+#endif
+
+#if UDFILE_FD_SUPPORTED
+
+static udFile_SeekReadHandlerFunc   udFileHandler_FDSeekRead;
+static udFile_SeekWriteHandlerFunc  udFileHandler_FDSeekWrite;
+#if UDFILE_FD_PREADV
+static udFile_ReadVHandlerFunc      udFileHandler_FDReadV;
+#endif
+static udFile_BlockForPipelinedRequestHandlerFunc udFileHandler_FDBlockForPipelinedRequest;
+static udFile_CloseHandlerFunc      udFileHandler_FDClose;
+
+#define UDFILE_FD_ASYNC_THREADS 8 // Default queue depth for pipelined reads, the threads mostly wait on the device
+#define UDFILE_FD_MAX_IOVECS 64   // Most adjacent requests combined into a single preadv
+
+// The pool is shared by all files that have issued a pipelined read, and destroyed when the last of them closes
+static udWorkerPool *s_pAsyncPool;
+static int32_t s_asyncPoolRefCount;
+static volatile int32_t s_asyncPoolLock;
+static int s_asyncThreads = UDFILE_FD_ASYNC_THREADS;
+
+// The udFile derivative for file descriptor i/o, the descriptor doesn't change after open so no locking is required
+struct udFile_FD : public udFile
+{
+  int fd;
+  volatile int32_t asyncState; // 0 not using the async pool, 1 getting a reference to it, 2 holding a reference
+  udMutex *pAsyncMutex;        // Guards the members below and completion of the pipelined reads
+  udConditionVariable *pAsyncCondition;
+  int asyncRunning;            // Pipelined reads that haven't completed
+  int asyncWaiters;
+};
+
+// State of a pipelined read, pointed to by the udFilePipelinedRequest until BlockForPipelinedRequest frees it
+struct udFile_FDAsyncRead
+{
+  udFile_FD *pFile;
+  void *pBuffer;
+  size_t bufferLength;
+  int64_t seekOffset;
+  size_t actualRead;
+  udResult result;
+  bool complete;
+};
+
+#endif // UDFILE_FD_SUPPORTED
+
+// ----------------------------------------------------------------------------
+// Implementation of OpenHandler using a file descriptor, returns udR_Unsupported so FILE is used on other platforms
+udResult udFileHandler_FDOpen(udFile **ppFile, const char *pFilename, udFileOpenFlags flags)
+{
+  UDTRACE();
+#if UDFILE_FD_SUPPORTED
+  udResult result;
+  udFile_FD *pFile = nullptr;
+  int openFlags;
+  struct stat st;
+
+  if ((flags & udFOF_Read) && (flags & udFOF_Write))
+    openFlags = O_RDWR;
+  else if (flags & udFOF_Read)
+    openFlags = O_RDONLY;
+  else if (flags & (udFOF_Write | udFOF_Create))
+    openFlags = O_WRONLY | O_CREAT | O_TRUNC; // Create flag treated as Write in this case, as with FILE
+  else
+    UD_ERROR_SET_NO_BREAK(udR_OpenFailure);
+
+  if ((flags & udFOF_Create) && (flags & (udFOF_Read | udFOF_Write)))
+    openFlags |= O_CREAT | O_TRUNC;
+
+  pFile = udAllocType(udFile_FD, 1, udAF_Zero);
+  UD_ERROR_NULL(pFile, udR_MemoryAllocationFailure);
+  pFile->fd = -1;
+
+  if (udFile_TranslatePath(&pFile->pFilenameCopy, pFilename) != udR_Success)
+  {
+    pFile->pFilenameCopy = udStrdup(pFilename);
+    UD_ERROR_NULL(pFile->pFilenameCopy, udR_MemoryAllocationFailure);
+  }
+  pFile->filenameCopyRequiresFree = true; // Let the system free the duplicate filename
+
+  if (udFOF_Create & flags)
+  {
+    udFilename temp(pFile->pFilenameCopy);
+    temp.SetFilenameWithExt("");
+    udCreateDir(temp.GetPath()); // Don't error check, it will fail on file create if there are problems
+  }
+
+  pFile->fd = open(pFile->pFilenameCopy, openFlags | O_CLOEXEC, 0666);
+  // File open failures shouldn't trigger breakpoints with BREAK_ON_ERROR defined.
+  if (pFile->fd == -1)
+    UD_ERROR_SET_NO_BREAK(udR_OpenFailure);
+
+  if (fstat(pFile->fd, &st) == 0)
+    pFile->fileLength = (int64_t)st.st_size;
+
+  pFile->pAsyncMutex = udCreateMutex();
+  UD_ERROR_NULL(pFile->pAsyncMutex, udR_InternalError);
+  pFile->pAsyncCondition = udCreateConditionVariable();
+  UD_ERROR_NULL(pFile->pAsyncCondition, udR_InternalError);
+
+  pFile->fpRead = udFileHandler_FDSeekRead;
+#if UDFILE_FD_PREADV
+  pFile->fpReadV = udFileHandler_FDReadV;
+#endif
+  pFile->fpWrite = udFileHandler_FDSeekWrite;
+  pFile->fpBlockPipedRequest = udFileHandler_FDBlockForPipelinedRequest;
+  pFile->fpClose = udFileHandler_FDClose;
+
+  *ppFile = pFile;
+  pFile = nullptr;
+  result = udR_Success;
+
+epilogue:
+  if (pFile)
+  {
+    udFree(pFile->pFilenameCopy);
+    udFileHandler_FDClose((udFile**)&pFile);
+  }
+  return result;
+#else
+  udUnused(ppFile);
+  udUnused(pFilename);
+  udUnused(flags);
+  return udR_Unsupported;
+#endif
+}
+
+#if UDFILE_FD_SUPPORTED
+
+// ----------------------------------------------------------------------------
+static void udFileHandler_FDLockAsyncPool()
+{
+  while (udInterlockedCompareExchange(&s_asyncPoolLock, 1, 0) != 0)
+    udYield();
+}
+
+// ----------------------------------------------------------------------------
+static void udFileHandler_FDUnlockAsyncPool()
+{
+  udInterlockedExchange(&s_asyncPoolLock, 0);
+}
+
+// ----------------------------------------------------------------------------
+// Take a reference to the async pool for this file, the first thread to get here does it and any others wait for the outcome
+static bool udFileHandler_FDAcquireAsyncPool(udFile_FD *pFD)
+{
+  int32_t state = udInterlockedCompareExchange(&pFD->asyncState, 1, 0);
+  if (state == 0)
+  {
+    udResult result = udR_Success;
+    udFileHandler_FDLockAsyncPool();
+    if (s_pAsyncPool == nullptr)
+      result = udWorkerPool_Create(&s_pAsyncPool, (uint8_t)s_asyncThreads, "udFileAsync");
+    if (result == udR_Success)
+      ++s_asyncPoolRefCount;
+    udFileHandler_FDUnlockAsyncPool();
+
+    state = (result == udR_Success) ? 2 : 0;
+    udInterlockedExchange(&pFD->asyncState, state);
+  }
+
+  while (state == 1)
+  {
+    udYield();
+    state = pFD->asyncState;
+  }
+
+  return (state == 2);
+}
+
+// ----------------------------------------------------------------------------
+// Runs on the async pool to do the read for a pipelined request
+static void udFileHandler_FDAsyncRead(void *pUserData)
+{
+  udFile_FDAsyncRead *pRead = (udFile_FDAsyncRead*)pUserData;
+  udFile_FD *pFD = pRead->pFile;
+  size_t actualRead = 0;
+  udResult result = udFileHandler_FDSeekRead(pFD, pRead->pBuffer, pRead->bufferLength, pRead->seekOffset, &actualRead, nullptr);
+
+  udLockMutex(pFD->pAsyncMutex);
+  pRead->actualRead = actualRead;
+  pRead->result = result;
+  pRead->complete = true;
+  --pFD->asyncRunning;
+  if (pFD->asyncWaiters)
+    udSignalConditionVariable(pFD->pAsyncCondition, pFD->asyncWaiters);
+  udReleaseMutex(pFD->pAsyncMutex);
+}
+
+// ----------------------------------------------------------------------------
+// Implementation of SeekReadHandler, any number of threads can read at once
+// Pipelined requests return immediately and the read completes on the async pool
+static udResult udFileHandler_FDSeekRead(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t seekOffset, size_t *pActualRead, udFilePipelinedRequest *pPipelinedRequest)
+{
+  UDTRACE();
+  udFile_FD *pFD = static_cast<udFile_FD*>(pFile);
+  udResult result;
+  size_t actualRead = 0;
+
+  UD_ERROR_NULL(pFile, udR_InvalidParameter_);
+
+  if (pPipelinedRequest)
+  {
+    udFile_FDAsyncRead *pRead = udAllocType(udFile_FDAsyncRead, 1, udAF_Zero);
+    UD_ERROR_NULL(pRead, udR_MemoryAllocationFailure);
+    pRead->pFile = pFD;
+    pRead->pBuffer = pBuffer;
+    pRead->bufferLength = bufferLength;
+    pRead->seekOffset = seekOffset;
+    pPipelinedRequest->reserved[0] = (uint64_t)(size_t)pRead;
+
+    udLockMutex(pFD->pAsyncMutex);
+    ++pFD->asyncRunning;
+    udReleaseMutex(pFD->pAsyncMutex);
+
+    // Without the pool the read is done now, the result is still collected by BlockForPipelinedRequest
+    if (!udFileHandler_FDAcquireAsyncPool(pFD) || udWorkerPool_AddTask(s_pAsyncPool, udFileHandler_FDAsyncRead, pRead, false) != udR_Success)
+      udFileHandler_FDAsyncRead(pRead);
+
+    actualRead = bufferLength; // Being optimistic
+    UD_ERROR_SET(udR_Success);
+  }
+
+  // pread can return less than requested before the end of file, so continue until it returns zero
+  while (actualRead < bufferLength)
+  {
+    ssize_t amount = pread(pFD->fd, udAddBytes(pBuffer, actualRead), bufferLength - actualRead, (off_t)(seekOffset + (int64_t)actualRead));
+    if (amount == 0)
+      break;
+    if (amount < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      UD_ERROR_SET(udR_ReadFailure);
+    }
+    actualRead += (size_t)amount;
+  }
+
+  result = udR_Success;
+
+epilogue:
+  if (pActualRead)
+    *pActualRead = actualRead;
+
+  return result;
+}
+
+
+#if UDFILE_FD_PREADV
+// ----------------------------------------------------------------------------
+// Implementation of ReadVHandler, each run of adjacent requests is a single preadv straight into the requests' buffers
+static udResult udFileHandler_FDReadV(udFile *pFile, const udFileReadRequest *pRequests, size_t count, size_t *pActualReads)
+{
+  UDTRACE();
+  udFile_FD *pFD = static_cast<udFile_FD*>(pFile);
+  udResult result = udR_Success;
+  struct iovec iov[UDFILE_FD_MAX_IOVECS];
+
+  for (size_t first = 0, last; first < count; first = last + 1)
+  {
+    iov[0].iov_base = pRequests[first].pBuffer;
+    iov[0].iov_len = pRequests[first].bufferLength;
+    for (last = first; last + 1 < count && last + 1 - first < UDFILE_FD_MAX_IOVECS; ++last)
+    {
+      if (pRequests[last + 1].seekOffset != pRequests[last].seekOffset + (int64_t)pRequests[last].bufferLength)
+        break;
+      iov[last + 1 - first].iov_base = pRequests[last + 1].pBuffer;
+      iov[last + 1 - first].iov_len = pRequests[last + 1].bufferLength;
+    }
+
+    ssize_t amount;
+    do
+    {
+      amount = preadv(pFD->fd, iov, (int)(last + 1 - first), (off_t)pRequests[first].seekOffset);
+    } while (amount < 0 && errno == EINTR);
+    UD_ERROR_IF(amount < 0, udR_ReadFailure);
+
+    // preadv can return less than requested before the end of file, anything incomplete is finished with pread
+    bool endOfFile = (amount == 0);
+    for (size_t i = first, runOffset = 0; i <= last; runOffset += pRequests[i].bufferLength, ++i)
+    {
+      pActualReads[i] = ((size_t)amount > runOffset) ? udMin(pRequests[i].bufferLength, (size_t)amount - runOffset) : 0;
+      if (!endOfFile && pActualReads[i] < pRequests[i].bufferLength)
+      {
+        size_t actualRead = 0;
+        UD_ERROR_CHECK(udFileHandler_FDSeekRead(pFile, udAddBytes(pRequests[i].pBuffer, pActualReads[i]), pRequests[i].bufferLength - pActualReads[i], pRequests[i].seekOffset + (int64_t)pActualReads[i], &actualRead, nullptr));
+        pActualReads[i] += actualRead;
+        endOfFile = (pActualReads[i] < pRequests[i].bufferLength);
+      }
+    }
+  }
+
+epilogue:
+  return result;
+}
+#endif // UDFILE_FD_PREADV
+
+
+// ----------------------------------------------------------------------------
+// Implementation of SeekWriteHandler, writes to different parts of the file can be done from many threads
+static udResult udFileHandler_FDSeekWrite(udFile *pFile, const void *pBuffer, size_t bufferLength, int64_t seekOffset, size_t *pActualWritten)
+{
+  UDTRACE();
+  udFile_FD *pFD = static_cast<udFile_FD*>(pFile);
+  udResult result;
+  size_t actualWritten = 0;
+
+  UD_ERROR_NULL(pFile, udR_InvalidParameter_);
+
+  while (actualWritten < bufferLength)
+  {
+    ssize_t amount = pwrite(pFD->fd, udAddBytes(pBuffer, actualWritten), bufferLength - actualWritten, (off_t)(seekOffset + (int64_t)actualWritten));
+    if (amount < 0 && errno == EINTR)
+      continue;
+    UD_ERROR_IF(amount <= 0, udR_WriteFailure);
+    actualWritten += (size_t)amount;
+  }
+
+  result = udR_Success;
+
+epilogue:
+  if (pActualWritten)
+    *pActualWritten = actualWritten;
+
+  return result;
+}
+
+
+// ----------------------------------------------------------------------------
+// Implementation of BlockForPipelinedRequest, requests can be received in any order
+static udResult udFileHandler_FDBlockForPipelinedRequest(udFile *pFile, udFilePipelinedRequest *pPipelinedRequest, size_t *pActualRead)
+{
+  UDTRACE();
+  udFile_FD *pFD = static_cast<udFile_FD*>(pFile);
+  udFile_FDAsyncRead *pRead = (udFile_FDAsyncRead*)(size_t)pPipelinedRequest->reserved[0];
+  udResult result;
+
+  UD_ERROR_NULL(pRead, udR_InvalidParameter_);
+
+  udLockMutex(pFD->pAsyncMutex);
+  while (!pRead->complete)
+  {
+    ++pFD->asyncWaiters;
+    udWaitConditionVariable(pFD->pAsyncCondition, pFD->pAsyncMutex);
+    --pFD->asyncWaiters;
+  }
+  udReleaseMutex(pFD->pAsyncMutex);
+
+  if (pActualRead)
+    *pActualRead = pRead->actualRead;
+  result = pRead->result;
+
+  pPipelinedRequest->reserved[0] = 0;
+  udFree(pRead);
+
+epilogue:
+  return result;
+}
+
+
+// ----------------------------------------------------------------------------
+// Implementation of CloseHandler to close the descriptor
+static udResult udFileHandler_FDClose(udFile **ppFile)
+{
+  UDTRACE();
+  udResult result = udR_Success;
+  udFile_FD *pFD = static_cast<udFile_FD*>(*ppFile);
+  *ppFile = nullptr;
+
+  if (pFD)
+  {
+    if (pFD->pAsyncMutex)
+    {
+      // Pipelined reads may still be writing to their buffers or signalling
+      udLockMutex(pFD->pAsyncMutex);
+      while (pFD->asyncRunning)
+      {
+        ++pFD->asyncWaiters;
+        udWaitConditionVariable(pFD->pAsyncCondition, pFD->pAsyncMutex);
+        --pFD->asyncWaiters;
+      }
+      udReleaseMutex(pFD->pAsyncMutex);
+    }
+
+    if (pFD->asyncState == 2)
+    {
+      udFileHandler_FDLockAsyncPool();
+      if (--s_asyncPoolRefCount == 0)
+        udWorkerPool_Destroy(&s_pAsyncPool);
+      udFileHandler_FDUnlockAsyncPool();
+    }
+
+    if (pFD->fd != -1 && close(pFD->fd) != 0)
+      result = udR_CloseFailure;
+    if (pFD->pAsyncCondition)
+      udDestroyConditionVariable(&pFD->pAsyncCondition);
+    udDestroyMutex(&pFD->pAsyncMutex);
+    udFree(pFD);
+  }
+
+  return result;
+}
+
+#endif // UDFILE_FD_SUPPORTED
+
+// ----------------------------------------------------------------------------
+udResult udFile_ConfigureAsyncReads(int queueDepth)
+{
+  if (queueDepth < 1 || queueDepth > 255)
+    return udR_InvalidParameter_;
+
+#if UDFILE_FD_SUPPORTED
+  udResult result = udR_NotAllowed;
+  udFileHandler_FDLockAsyncPool();
+  if (s_pAsyncPool == nullptr)
+  {
+    s_asyncThreads = queueDepth;
+    result = udR_Success;
+  }
+  udFileHandler_FDUnlockAsyncPool();
+  return result;
+#else
+  return udR_Success; // Pipelined reads are synchronous here
+#endif
+}
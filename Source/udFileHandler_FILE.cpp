@@ -43,6 +43,8 @@ static udFile_SeekWriteHandlerFunc  udFileHandler_FILESeekWrite;
 static udFile_ReleaseHandlerFunc    udFileHandler_FILERelease;
 static udFile_CloseHandlerFunc      udFileHandler_FILEClose;
 volatile int32_t g_udFileHandler_FILEHandleCount;
+udFile_OpenHandlerFunc udFileHandler_MMapOpen;
+udFile_OpenHandlerFunc udFileHandler_FDOpen;
 #if FILE_DEBUG
 #pragma optimize("", off)
 #endif
@@ -100,6 +102,22 @@ udResult udFileHandler_FILEOpen(udFile **ppFile, const char *pFilename, udFileOp
   udResult result;
   bool existsFailed = false;
 
+  if (flags & udFOF_MemoryMap)
+  {
+    // Mapping is only supported for read-only local files on some platforms, otherwise carry on with FILE
+    result = udFileHandler_MMapOpen(ppFile, pFilename, flags);
+    if (result != udR_Unsupported)
+      return result;
+  }
+
+  if ((flags & udFOF_Multithread) && !(flags & udFOF_FastOpen))
+  {
+    // Multithreaded access without a shared file position, so reads don't queue up on a mutex (FastOpen keeps FILE for its deferred open)
+    result = udFileHandler_FDOpen(ppFile, pFilename, flags);
+    if (result != udR_Unsupported)
+      return result;
+  }
+
   pFile = udAllocType(udFile_FILE, 1, udAF_Zero);
   UD_ERROR_NULL(pFile, udR_MemoryAllocationFailure);
 
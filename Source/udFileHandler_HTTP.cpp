@@ -12,6 +12,7 @@
 #include "udPlatformUtil.h"
 #include "udStringUtil.h"
 #include "udFileHandler.h"
+#include "udThread.h"
 
 #if !UDPLATFORM_EMSCRIPTEN
 static udFile_OpenHandlerFunc                     udFileHandler_HTTPOpen;
@@ -32,6 +33,41 @@ udResult udFile_RegisterHTTP()
 static char s_HTTPHeaderString[] = "HEAD %s HTTP/1.1\r\nHost: %s\r\nConnection: Keep-Alive\r\nUser-Agent: Euclideon udSDK/2.0\r\n\r\n";
 static char s_HTTPGetString[] = "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: Euclideon udSDK/2.0\r\nConnection: Keep-Alive\r\nRange: bytes=%lld-%lld\r\n\r\n";
 
+#define UDFILE_HTTP_DEFAULT_MAX_CONNECTIONS 6     // Per host, as browsers do
+#define UDFILE_HTTP_DEFAULT_IDLE_TIMEOUT_MS 4000  // Shorter than common server keep-alive timeouts, so pooled connections are rarely closed under us
+
+// A connection to a server, either owned by a file or leased from the pool
+struct udFile_HTTPConnection
+{
+  udFile_HTTPConnection *pNext; // Next idle connection to the same host, while in the pool
+  udSocket *pSocket;
+  uint32_t idleSinceMs;
+  char recvBuffer[1024];
+};
+
+// Connections to one scheme, domain and port
+struct udFile_HTTPHost
+{
+  udFile_HTTPHost *pNext;
+  const char *pKey;
+  udFile_HTTPConnection *pIdle; // Most recently used first
+  int connectionCount;          // Idle and leased
+};
+
+// Shared by every multithreaded HTTP file while any are open
+struct udFile_HTTPPool
+{
+  udMutex *pMutex;
+  udConditionVariable *pCondition; // Signalled when a connection is returned or closed
+  udFile_HTTPHost *pHosts;
+  int waiters;
+  int refCount; // Only accessed with s_httpPoolLock held
+};
+
+static udFile_HTTPPool s_httpPool;
+static volatile int32_t s_httpPoolLock;
+static volatile int32_t s_httpMaxConnections = UDFILE_HTTP_DEFAULT_MAX_CONNECTIONS;
+static volatile int32_t s_httpIdleTimeoutMs = UDFILE_HTTP_DEFAULT_IDLE_TIMEOUT_MS;
 
 // The udFile derivative for supporting HTTP/S
 struct udFile_HTTP : public udFile
@@ -39,8 +75,8 @@ struct udFile_HTTP : public udFile
   udMutex *pMutex;                        // Used only when the udFOF_Multithread flag is used to ensure safe access from multiple threads
   udURL url;
   bool wsInitialised;
-  char recvBuffer[1024];
-  udSocket *pSocket;
+  udFile_HTTPConnection connection; // Used to get the file length and for pipelined requests, and for all requests when there's no pool
+  udFile_HTTPHost *pHost;           // Set for multithreaded files, reads that aren't pipelined lease their own connection to this host
   int sockID; // Each time a socket it created we increment this number, this way pipelined requests from a dead socket can be identified as dead
 };
 
@@ -48,15 +84,15 @@ struct udFile_HTTP : public udFile
 // ----------------------------------------------------------------------------
 // Open the socket
 // Author: Dave Pevreal, March 2014
-static udResult udFileHandler_HTTPOpenSocket(udFile_HTTP *pFile)
+static udResult udFileHandler_HTTPOpenSocket(udFile_HTTP *pFile, udFile_HTTPConnection *pConnection)
 {
   udResult result;
 
-  if (!pFile->pSocket || !udSocket_IsValidSocket(pFile->pSocket))
+  if (!pConnection->pSocket || !udSocket_IsValidSocket(pConnection->pSocket))
   {
-    if (pFile->pSocket)
-      udSocket_Close(&pFile->pSocket);
-    result = udSocket_Open(&pFile->pSocket, pFile->url.GetDomain(), pFile->url.GetPort(), udStrEqual(pFile->url.GetScheme(), "https") ? udSCF_UseTLS : udSCF_None);
+    if (pConnection->pSocket)
+      udSocket_Close(&pConnection->pSocket);
+    result = udSocket_Open(&pConnection->pSocket, pFile->url.GetDomain(), pFile->url.GetPort(), udStrEqual(pFile->url.GetScheme(), "https") ? udSCF_UseTLS : udSCF_None);
   }
   else
   {
@@ -73,42 +109,43 @@ static udResult udFileHandler_HTTPOpenSocket(udFile_HTTP *pFile)
 // ----------------------------------------------------------------------------
 // Close the socket
 // Author: Dave Pevreal, March 2014
-static void udFileHandler_HTTPCloseSocket(udFile_HTTP *pFile)
+static void udFileHandler_HTTPCloseSocket(udFile_HTTP *pFile, udFile_HTTPConnection *pConnection)
 {
-  udSocket_Close(&pFile->pSocket);
-  ++pFile->sockID;
+  udSocket_Close(&pConnection->pSocket);
+  if (pConnection == &pFile->connection)
+    ++pFile->sockID;
 }
 
 
 // ----------------------------------------------------------------------------
 // Send a request
 // Author: Dave Pevreal, March 2014
-static udResult udFileHandler_HTTPSendRequest(udFile_HTTP *pFile, int len)
+static udResult udFileHandler_HTTPSendRequest(udFile_HTTP *pFile, udFile_HTTPConnection *pConnection, int len)
 {
   udResult result;
 
-  UD_ERROR_CHECK(udFileHandler_HTTPOpenSocket(pFile));
-  result = udSocket_SendData(pFile->pSocket, (const uint8_t*)pFile->recvBuffer, (int64_t)len);
+  UD_ERROR_CHECK(udFileHandler_HTTPOpenSocket(pFile, pConnection));
+  result = udSocket_SendData(pConnection->pSocket, (const uint8_t*)pConnection->recvBuffer, (int64_t)len);
   if (result == udR_SocketError)
   {
     // On error, first try closing and re-opening the socket before giving up
-    udFileHandler_HTTPCloseSocket(pFile);
-    udFileHandler_HTTPOpenSocket(pFile);
-    result = udSocket_SendData(pFile->pSocket, (const uint8_t*)pFile->recvBuffer, (int64_t)len);
+    udFileHandler_HTTPCloseSocket(pFile, pConnection);
+    udFileHandler_HTTPOpenSocket(pFile, pConnection);
+    result = udSocket_SendData(pConnection->pSocket, (const uint8_t*)pConnection->recvBuffer, (int64_t)len);
   }
 
 epilogue:
   if (result != udR_Success)
-    udDebugPrintf("Error %s sending request:\n%s\n--end--\n", udResultAsString(result), pFile->recvBuffer);
+    udDebugPrintf("Error %s sending request:\n%s\n--end--\n", udResultAsString(result), pConnection->recvBuffer);
   return result;
 }
 
 
 // ----------------------------------------------------------------------------
 // Receive a response for a GET packet, parsing the string header before
-// delivering the payload
+// delivering the payload. *pConnectionLost is set if no response arrived at all, which is what a server closing an idle connection looks like
 // Author: Dave Pevreal, March 2014
-static udResult udFileHandler_HTTPRecvGET(udFile_HTTP *pFile, void *pBuffer, size_t bufferLength, size_t *pActualRead)
+static udResult udFileHandler_HTTPRecvGET(udFile_HTTP *pFile, udFile_HTTPConnection *pConnection, void *pBuffer, size_t bufferLength, size_t *pActualRead, bool *pConnectionLost = nullptr)
 {
   udResult result;
   size_t bytesReceived = 0;      // Number of bytes received from this packet
@@ -117,32 +154,40 @@ static udResult udFileHandler_HTTPRecvGET(udFile_HTTP *pFile, void *pBuffer, siz
   const char *s;
   bool closeConnection = false;
   int64_t contentLength;
-  int64_t actualReceived;
+  int64_t actualReceived = 0;
+
+  if (pConnectionLost)
+    *pConnectionLost = false;
 
-  result = udFileHandler_HTTPOpenSocket(pFile);
+  result = udFileHandler_HTTPOpenSocket(pFile, pConnection);
   if (result != udR_Success)
     udDebugPrintf("Unable to open socket\n");
   UD_ERROR_HANDLE();
 
-  result = udSocket_ReceiveData(pFile->pSocket, (uint8_t*)pFile->recvBuffer, (int64_t)sizeof(pFile->recvBuffer), &actualReceived);
-  if (result == udR_SocketError)
+  result = udSocket_ReceiveData(pConnection->pSocket, (uint8_t*)pConnection->recvBuffer, (int64_t)sizeof(pConnection->recvBuffer), &actualReceived);
+  if (result == udR_SocketError && pConnection == &pFile->connection)
   {
     // Close and re-open the socket on error
-    udFileHandler_HTTPCloseSocket(pFile);
-    UD_ERROR_CHECK(udFileHandler_HTTPOpenSocket(pFile));
-    UD_ERROR_CHECK(udSocket_ReceiveData(pFile->pSocket, (uint8_t*)pFile->recvBuffer, (int64_t)sizeof(pFile->recvBuffer), &actualReceived));
+    udFileHandler_HTTPCloseSocket(pFile, pConnection);
+    UD_ERROR_CHECK(udFileHandler_HTTPOpenSocket(pFile, pConnection));
+    UD_ERROR_CHECK(udSocket_ReceiveData(pConnection->pSocket, (uint8_t*)pConnection->recvBuffer, (int64_t)sizeof(pConnection->recvBuffer), &actualReceived));
   }
+  if (pConnectionLost)
+    *pConnectionLost = (result == udR_SocketError || (result == udR_Success && actualReceived == 0));
+  UD_ERROR_HANDLE(); // A leased connection fails straight away, the request is sent again on a new connection by the caller
+  UD_ERROR_IF(actualReceived == 0, udR_SocketError); // The server closed the connection
   bytesReceived += (size_t)actualReceived;
 
-  while (udStrstr(pFile->recvBuffer, bytesReceived, "\r\n\r\n", &headerLength) == nullptr && (size_t)bytesReceived < sizeof(pFile->recvBuffer))
+  while (udStrstr(pConnection->recvBuffer, bytesReceived, "\r\n\r\n", &headerLength) == nullptr && (size_t)bytesReceived < sizeof(pConnection->recvBuffer))
   {
-    UD_ERROR_CHECK(udSocket_ReceiveData(pFile->pSocket, (uint8_t*)pFile->recvBuffer + bytesReceived, (int64_t)sizeof(pFile->recvBuffer) - bytesReceived, &actualReceived));
+    UD_ERROR_CHECK(udSocket_ReceiveData(pConnection->pSocket, (uint8_t*)pConnection->recvBuffer + bytesReceived, (int64_t)sizeof(pConnection->recvBuffer) - bytesReceived, &actualReceived));
+    UD_ERROR_IF(actualReceived == 0, udR_SocketError); // The server closed the connection
     bytesReceived += (size_t)actualReceived;
   }
 
   // First, check the top line for HTTP version and error code
   code = 0;
-  sscanf(pFile->recvBuffer, "HTTP/1.1 %d", &code);
+  sscanf(pConnection->recvBuffer, "HTTP/1.1 %d", &code);
   if ((code != 200 && code != 206) || (headerLength == (size_t)bytesReceived)) // if headerLength is bytesReceived, never found the \r\n\r\n
   {
     udDebugPrintf("Fail on packet: code = %d headerLength = %d (bytesReceived = %d)\n", code, (int)headerLength, (int)bytesReceived);
@@ -150,15 +195,15 @@ static udResult udFileHandler_HTTPRecvGET(udFile_HTTP *pFile, void *pBuffer, siz
   }
 
   headerLength += 4;
-  pFile->recvBuffer[headerLength-1] = 0; // null terminate the header part
-  //udDebugPrintf("Received:\n%s--end--\n", pFile->recvBuffer);
+  pConnection->recvBuffer[headerLength-1] = 0; // null terminate the header part
+  //udDebugPrintf("Received:\n%s--end--\n", pConnection->recvBuffer);
 
   // Check for a request from the server to close the connection after dealing with this
-  closeConnection = udStrstr(pFile->recvBuffer, headerLength, "Connection: close") != nullptr;
+  closeConnection = udStrstr(pConnection->recvBuffer, headerLength, "Connection: close") != nullptr;
   if (closeConnection)
     udDebugPrintf("Server requesting connection close\n");
 
-  s = udStrstr(pFile->recvBuffer, headerLength, "Content-Length:");
+  s = udStrstr(pConnection->recvBuffer, headerLength, "Content-Length:");
   if (!s)
   {
     udDebugPrintf("http: No content-length field found\n");
@@ -182,11 +227,12 @@ static udResult udFileHandler_HTTPRecvGET(udFile_HTTP *pFile, void *pBuffer, siz
 
     // Some servers send more data after the content, we should throw it out
     bytesReceived = udMin((int64_t)bytesReceived - (int64_t)headerLength, contentLength);
-    memcpy(pBuffer, pFile->recvBuffer + headerLength, bytesReceived);
+    memcpy(pBuffer, pConnection->recvBuffer + headerLength, bytesReceived);
 
     while (bytesReceived < (size_t)contentLength)
     {
-      UD_ERROR_CHECK(udSocket_ReceiveData(pFile->pSocket, (uint8_t*)pBuffer + bytesReceived, (int64_t)bufferLength - bytesReceived, &actualReceived));
+      UD_ERROR_CHECK(udSocket_ReceiveData(pConnection->pSocket, (uint8_t*)pBuffer + bytesReceived, (int64_t)bufferLength - bytesReceived, &actualReceived));
+      UD_ERROR_IF(actualReceived == 0, udR_SocketError); // The server closed the connection
       bytesReceived += (size_t)actualReceived;
     }
     if (pActualRead)
@@ -197,14 +243,256 @@ static udResult udFileHandler_HTTPRecvGET(udFile_HTTP *pFile, void *pBuffer, siz
 
 epilogue:
   if (result != udR_Success || closeConnection)
-    udFileHandler_HTTPCloseSocket(pFile);
+    udFileHandler_HTTPCloseSocket(pFile, pConnection);
   if (result != udR_Success)
-    udDebugPrintf("Error receiving request:\n%s\n--end--\n", pFile->recvBuffer);
+    udDebugPrintf("Error receiving request:\n%s\n--end--\n", pConnection->recvBuffer);
+
+  return result;
+}
+
+
+// ----------------------------------------------------------------------------
+// Close and free a chain of connections, called without the pool mutex held
+static void udFileHandler_HTTPFreeConnections(udFile_HTTPConnection *pConnections)
+{
+  while (pConnections)
+  {
+    udFile_HTTPConnection *pNext = pConnections->pNext;
+    udSocket_Close(&pConnections->pSocket);
+    udFree(pConnections);
+    pConnections = pNext;
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// Remove the host's connections that have been idle longer than the timeout, returning them to be freed once the pool mutex is released
+static udFile_HTTPConnection *udFileHandler_HTTPRemoveExpired(udFile_HTTPHost *pHost)
+{
+  uint32_t now = udGetTimeMs();
+  udFile_HTTPConnection **ppLink = &pHost->pIdle;
+
+  // The idle list is most recently used first, so everything from the first expired connection on has expired
+  while (*ppLink && (now - (*ppLink)->idleSinceMs) <= (uint32_t)s_httpIdleTimeoutMs)
+    ppLink = &(*ppLink)->pNext;
+
+  udFile_HTTPConnection *pExpired = *ppLink;
+  *ppLink = nullptr;
+  for (udFile_HTTPConnection *pConnection = pExpired; pConnection; pConnection = pConnection->pNext)
+    --pHost->connectionCount;
+
+  return pExpired;
+}
+
 
+// ----------------------------------------------------------------------------
+// Drop a reference to the shared pool, the last one frees the pool and any idle connections
+static void udFileHandler_HTTPDereferencePool()
+{
+  while (udInterlockedCompareExchange(&s_httpPoolLock, 1, 0) != 0)
+    udYield();
+  if (--s_httpPool.refCount == 0)
+  {
+    while (s_httpPool.pHosts)
+    {
+      udFile_HTTPHost *pHost = s_httpPool.pHosts;
+      s_httpPool.pHosts = pHost->pNext;
+      udFileHandler_HTTPFreeConnections(pHost->pIdle);
+      udFree(pHost->pKey);
+      udFree(pHost);
+    }
+    udDestroyMutex(&s_httpPool.pMutex);
+    udDestroyConditionVariable(&s_httpPool.pCondition);
+  }
+  udInterlockedExchange(&s_httpPoolLock, 0);
+}
+
+
+// ----------------------------------------------------------------------------
+// Take a reference to the shared pool and find (or add) the file's host, files without a host use their own connection
+static udResult udFileHandler_HTTPAcquirePool(udFile_HTTP *pFile)
+{
+  udResult result;
+  udFile_HTTPHost *pHost = nullptr;
+  const char *pKey = nullptr;
+  bool referenced = false;
+
+  while (udInterlockedCompareExchange(&s_httpPoolLock, 1, 0) != 0)
+    udYield();
+  if (s_httpPool.refCount == 0)
+  {
+    s_httpPool.pMutex = udCreateMutex();
+    s_httpPool.pCondition = udCreateConditionVariable();
+  }
+  if (s_httpPool.pMutex && s_httpPool.pCondition)
+  {
+    ++s_httpPool.refCount;
+    referenced = true;
+  }
+  else if (s_httpPool.refCount == 0)
+  {
+    udDestroyMutex(&s_httpPool.pMutex);
+    if (s_httpPool.pCondition)
+      udDestroyConditionVariable(&s_httpPool.pCondition);
+  }
+  udInterlockedExchange(&s_httpPoolLock, 0);
+  UD_ERROR_IF(!referenced, udR_MemoryAllocationFailure);
+
+  UD_ERROR_CHECK(udSprintf(&pKey, "%s://%s:%d", pFile->url.GetScheme(), pFile->url.GetDomain(), pFile->url.GetPort()));
+
+  udLockMutex(s_httpPool.pMutex);
+  for (pHost = s_httpPool.pHosts; pHost && !udStrEqual(pHost->pKey, pKey); pHost = pHost->pNext)
+    ;
+  if (!pHost)
+  {
+    pHost = udAllocType(udFile_HTTPHost, 1, udAF_Zero);
+    if (pHost)
+    {
+      pHost->pKey = pKey;
+      pKey = nullptr;
+      pHost->pNext = s_httpPool.pHosts;
+      s_httpPool.pHosts = pHost;
+    }
+  }
+  udReleaseMutex(s_httpPool.pMutex);
+  UD_ERROR_NULL(pHost, udR_MemoryAllocationFailure);
+
+  pFile->pHost = pHost;
+  result = udR_Success;
+
+epilogue:
+  udFree(pKey);
+  if (result != udR_Success && referenced)
+    udFileHandler_HTTPDereferencePool();
   return result;
 }
 
 
+// ----------------------------------------------------------------------------
+// Drop the file's reference to the shared pool
+static void udFileHandler_HTTPReleasePool(udFile_HTTP *pFile)
+{
+  if (pFile->pHost)
+  {
+    pFile->pHost = nullptr;
+    udFileHandler_HTTPDereferencePool();
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// Lease a connection to the file's host, waiting for one to be returned if the host is at the maximum
+// With forceNew the host's idle connections are closed and a new one is always opened
+static udResult udFileHandler_HTTPLeaseConnection(udFile_HTTP *pFile, udFile_HTTPConnection **ppConnection, bool *pReused, bool forceNew = false)
+{
+  udResult result = udR_Success;
+  udFile_HTTPHost *pHost = pFile->pHost;
+  udFile_HTTPConnection *pConnection = nullptr;
+  udFile_HTTPConnection *pExpired;
+
+  udLockMutex(s_httpPool.pMutex);
+  pExpired = udFileHandler_HTTPRemoveExpired(pHost);
+  for (;;)
+  {
+    // Connections returned while waiting are dropped too, if the server closed one it has likely closed the others
+    while (forceNew && pHost->pIdle)
+    {
+      udFile_HTTPConnection *pStale = pHost->pIdle;
+      pHost->pIdle = pStale->pNext;
+      pStale->pNext = pExpired;
+      pExpired = pStale;
+      --pHost->connectionCount;
+    }
+    if (pHost->pIdle || pHost->connectionCount < udMax((int32_t)1, s_httpMaxConnections))
+      break;
+    ++s_httpPool.waiters;
+    udWaitConditionVariable(s_httpPool.pCondition, s_httpPool.pMutex);
+    --s_httpPool.waiters;
+  }
+  if (pHost->pIdle)
+  {
+    pConnection = pHost->pIdle;
+    pHost->pIdle = pConnection->pNext;
+    pConnection->pNext = nullptr;
+    *pReused = true;
+  }
+  else
+  {
+    ++pHost->connectionCount; // Counted now so other threads don't go over the maximum while this one connects
+    *pReused = false;
+  }
+  udReleaseMutex(s_httpPool.pMutex);
+
+  udFileHandler_HTTPFreeConnections(pExpired);
+
+  if (!pConnection)
+  {
+    // The socket is opened when the request is sent
+    pConnection = udAllocType(udFile_HTTPConnection, 1, udAF_Zero);
+    if (!pConnection)
+    {
+      udLockMutex(s_httpPool.pMutex);
+      --pHost->connectionCount;
+      if (s_httpPool.waiters)
+        udSignalConditionVariable(s_httpPool.pCondition, s_httpPool.waiters);
+      udReleaseMutex(s_httpPool.pMutex);
+      UD_ERROR_SET(udR_MemoryAllocationFailure);
+    }
+  }
+
+  *ppConnection = pConnection;
+
+epilogue:
+  return result;
+}
+
+
+// ----------------------------------------------------------------------------
+// Return a leased connection to the pool, connections that have been closed (or are over a lowered maximum) are freed instead
+static void udFileHandler_HTTPReturnConnection(udFile_HTTP *pFile, udFile_HTTPConnection **ppConnection)
+{
+  udFile_HTTPHost *pHost = pFile->pHost;
+  udFile_HTTPConnection *pConnection = *ppConnection;
+  udFile_HTTPConnection *pExpired;
+  *ppConnection = nullptr;
+
+  udLockMutex(s_httpPool.pMutex);
+  if (pConnection->pSocket && s_httpIdleTimeoutMs > 0 && pHost->connectionCount <= s_httpMaxConnections)
+  {
+    pConnection->idleSinceMs = udGetTimeMs();
+    pConnection->pNext = pHost->pIdle;
+    pHost->pIdle = pConnection;
+    pConnection = nullptr;
+  }
+  else
+  {
+    --pHost->connectionCount;
+  }
+  pExpired = udFileHandler_HTTPRemoveExpired(pHost);
+  if (s_httpPool.waiters)
+    udSignalConditionVariable(s_httpPool.pCondition, s_httpPool.waiters); // Waiters may be for other hosts, so wake them all
+  udReleaseMutex(s_httpPool.pMutex);
+
+  if (pConnection)
+    pConnection->pNext = pExpired;
+  else
+    pConnection = pExpired;
+  udFileHandler_HTTPFreeConnections(pConnection);
+}
+
+
+// ****************************************************************************
+udResult udFile_ConfigureHTTPConnections(int maxConnectionsPerHost, int idleTimeoutMs)
+{
+  if (maxConnectionsPerHost < 0 || idleTimeoutMs < 0)
+    return udR_InvalidParameter_;
+
+  udInterlockedExchange(&s_httpMaxConnections, maxConnectionsPerHost);
+  udInterlockedExchange(&s_httpIdleTimeoutMs, idleTimeoutMs);
+  return udR_Success;
+}
+
+
 // ----------------------------------------------------------------------------
 // Implementation of OpenHandler via HTTP
 // Author: Dave Pevreal, March 2014
@@ -235,12 +523,17 @@ udResult udFileHandler_HTTPOpen(udFile **ppFile, const char *pFilename, udFileOp
   UD_ERROR_CHECK(udSocket_InitSystem());
   pFile->wsInitialised = true;
 
-  actualHeaderLen = snprintf(pFile->recvBuffer, sizeof(pFile->recvBuffer)-1, s_HTTPHeaderString, pFile->url.GetPathWithQuery(), pFile->url.GetDomain());
+  actualHeaderLen = snprintf(pFile->connection.recvBuffer, sizeof(pFile->connection.recvBuffer)-1, s_HTTPHeaderString, pFile->url.GetPathWithQuery(), pFile->url.GetDomain());
   UD_ERROR_IF(actualHeaderLen < 0, udR_Failure_);
 
-  //udDebugPrintf("Sending:\n%s", pFile->recvBuffer);
-  UD_ERROR_CHECK(udFileHandler_HTTPSendRequest(pFile, (int)actualHeaderLen));
-  UD_ERROR_CHECK(udFileHandler_HTTPRecvGET(pFile, nullptr, 0, nullptr));
+  //udDebugPrintf("Sending:\n%s", pFile->connection.recvBuffer);
+  UD_ERROR_CHECK(udFileHandler_HTTPSendRequest(pFile, &pFile->connection, (int)actualHeaderLen));
+  UD_ERROR_CHECK(udFileHandler_HTTPRecvGET(pFile, &pFile->connection, nullptr, 0, nullptr));
+
+  // Without the pool, reads from every thread share the file's connection
+  // Failing to join the pool isn't an error, pHost stays null and the file falls back to its own connection
+  if ((flags & udFOF_Multithread) && s_httpMaxConnections > 0)
+    udFileHandler_HTTPAcquirePool(pFile);
 
   pFile->fpRead = udFileHandler_HTTPSeekRead;
   pFile->fpBlockPipedRequest = udFileHandler_HTTPBlockForPipelinedRequest;
@@ -258,6 +551,43 @@ epilogue:
 }
 
 
+// ----------------------------------------------------------------------------
+// Read on a connection leased from the pool, without holding the file's mutex so reads from other threads proceed at the same time
+static udResult udFileHandler_HTTPPooledSeekRead(udFile_HTTP *pFile, void *pBuffer, size_t bufferLength, int64_t seekOffset, size_t *pActualRead)
+{
+  udResult result;
+  udFile_HTTPConnection *pConnection = nullptr;
+  bool reused = false;
+  bool forceNew = false;
+  bool connectionLost = false;
+
+  for (int attempt = 0; ; ++attempt)
+  {
+    UD_ERROR_CHECK(udFileHandler_HTTPLeaseConnection(pFile, &pConnection, &reused, forceNew));
+
+    size_t actualHeaderLen = snprintf(pConnection->recvBuffer, sizeof(pConnection->recvBuffer)-1, s_HTTPGetString, pFile->url.GetPathWithQuery(), pFile->url.GetDomain(), seekOffset, seekOffset + bufferLength-1);
+    result = udFileHandler_HTTPSendRequest(pFile, pConnection, (int)actualHeaderLen);
+    connectionLost = (result == udR_SocketError);
+    if (result == udR_Success)
+      result = udFileHandler_HTTPRecvGET(pFile, pConnection, pBuffer, bufferLength, pActualRead, &connectionLost);
+
+    // A server can close an idle connection at any time, which only shows up once it's used, so the request is tried once more on a new one
+    // Error responses and anything else that went wrong after the server answered are returned as they are
+    if (result == udR_Success || !connectionLost || !reused || attempt > 0)
+      break;
+    udFileHandler_HTTPCloseSocket(pFile, pConnection);
+    udFileHandler_HTTPReturnConnection(pFile, &pConnection);
+    forceNew = true;
+  }
+
+epilogue:
+  if (pConnection)
+    udFileHandler_HTTPReturnConnection(pFile, &pConnection);
+
+  return result;
+}
+
+
 // ----------------------------------------------------------------------------
 // Implementation of SeekReadHandler via HTTP
 // Author: Dave Pevreal, March 2014
@@ -266,13 +596,18 @@ static udResult udFileHandler_HTTPSeekRead(udFile *pBaseFile, void *pBuffer, siz
   udResult result;
   udFile_HTTP *pFile = static_cast<udFile_HTTP *>(pBaseFile);
 
+  // Pipelined requests are received in order on the file's own connection, other reads each get a connection from the pool when there is one
+  if (!pPipelinedRequest && pFile->pHost && s_httpMaxConnections > 0)
+    return udFileHandler_HTTPPooledSeekRead(pFile, pBuffer, bufferLength, seekOffset, pActualRead);
+
   if (pFile->pMutex)
     udLockMutex(pFile->pMutex);
 
   //udDebugPrintf("\nSeekRead: %lld bytes at offset %lld\n", bufferLength, offset);
-  size_t actualHeaderLen = snprintf(pFile->recvBuffer, sizeof(pFile->recvBuffer)-1, s_HTTPGetString, pFile->url.GetPathWithQuery(), pFile->url.GetDomain(), seekOffset, seekOffset + bufferLength-1);
+  bool reused = (pFile->connection.pSocket != nullptr);
+  size_t actualHeaderLen = snprintf(pFile->connection.recvBuffer, sizeof(pFile->connection.recvBuffer)-1, s_HTTPGetString, pFile->url.GetPathWithQuery(), pFile->url.GetDomain(), seekOffset, seekOffset + bufferLength-1);
 
-  UD_ERROR_CHECK(udFileHandler_HTTPSendRequest(pFile, (int)actualHeaderLen));
+  UD_ERROR_CHECK(udFileHandler_HTTPSendRequest(pFile, &pFile->connection, (int)actualHeaderLen));
 
   if (pPipelinedRequest)
   {
@@ -285,7 +620,16 @@ static udResult udFileHandler_HTTPSeekRead(udFile *pBaseFile, void *pBuffer, siz
   }
   else
   {
-    UD_ERROR_CHECK(udFileHandler_HTTPRecvGET(pFile, pBuffer, bufferLength, pActualRead));
+    bool connectionLost = false;
+    result = udFileHandler_HTTPRecvGET(pFile, &pFile->connection, pBuffer, bufferLength, pActualRead, &connectionLost);
+    if (result != udR_Success && connectionLost && reused)
+    {
+      // The server may have closed the connection while it was idle, RecvGET has closed it so the request goes again on a new one
+      actualHeaderLen = snprintf(pFile->connection.recvBuffer, sizeof(pFile->connection.recvBuffer)-1, s_HTTPGetString, pFile->url.GetPathWithQuery(), pFile->url.GetDomain(), seekOffset, seekOffset + bufferLength-1);
+      UD_ERROR_CHECK(udFileHandler_HTTPSendRequest(pFile, &pFile->connection, (int)actualHeaderLen));
+      result = udFileHandler_HTTPRecvGET(pFile, &pFile->connection, pBuffer, bufferLength, pActualRead);
+    }
+    UD_ERROR_HANDLE();
   }
 
 epilogue:
@@ -318,7 +662,7 @@ static udResult udFileHandler_HTTPBlockForPipelinedRequest(udFile *pBaseFile, ud
   }
   else
   {
-    UD_ERROR_CHECK(udFileHandler_HTTPRecvGET(pFile, pBuffer, bufferLength, pActualRead));
+    UD_ERROR_CHECK(udFileHandler_HTTPRecvGET(pFile, &pFile->connection, pBuffer, bufferLength, pActualRead));
   }
   result = udR_Success;
 
@@ -343,7 +687,8 @@ static udResult udFileHandler_HTTPClose(udFile **ppFile)
     *ppFile = nullptr;
     if (pFile)
     {
-      udFileHandler_HTTPCloseSocket(pFile);
+      udFileHandler_HTTPCloseSocket(pFile, &pFile->connection);
+      udFileHandler_HTTPReleasePool(pFile); // Before the socket system is deinitialised, as this may close the pool's connections
       if (pFile->wsInitialised)
       {
         udSocket_DeinitSystem();
@@ -0,0 +1,177 @@
+//
+// Copyright (c) Euclideon Pty Ltd
+//
+// Memory mapped handler for local files opened with udFOF_MemoryMap, reads are a copy out of the mapping with no locking
+//
+
+#include "udFile.h"
+#include "udFileHandler.h"
+#include "udPlatformUtil.h"
+#include "udStringUtil.h"
+
+#if UDPLATFORM_WINDOWS
+// Included by udPlatform.h
+#elif UDPLATFORM_LINUX || UDPLATFORM_OSX || UDPLATFORM_IOS || UDPLATFORM_IOS_SIMULATOR || UDPLATFORM_ANDROID
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define UDFILE_MMAP_POSIX 1
+#endif
+
+static udFile_SeekReadHandlerFunc udFileHandler_MMapSeekRead;
+static udFile_BorrowHandlerFunc   udFileHandler_MMapBorrow;
+static udFile_CloseHandlerFunc    udFileHandler_MMapClose;
+
+// The udFile derivative for memory mapped files, nothing changes after open so any number of threads can read at once
+struct udFile_MMap : public udFile
+{
+  const uint8_t *pMapping; // Null for empty files
+  size_t mappedLength;
+#if UDPLATFORM_WINDOWS
+  HANDLE hFile;
+  HANDLE hMapping;
+#endif
+};
+
+// ----------------------------------------------------------------------------
+// Implementation of OpenHandler to map the file, returns udR_Unsupported so FILE is used when mapping isn't possible
+udResult udFileHandler_MMapOpen(udFile **ppFile, const char *pFilename, udFileOpenFlags flags)
+{
+  UDTRACE();
+  udResult result;
+  udFile_MMap *pFile = nullptr;
+  int64_t fileLength = 0;
+
+  UD_ERROR_IF(flags & (udFOF_Write | udFOF_Create), udR_Unsupported);
+
+  pFile = udAllocType(udFile_MMap, 1, udAF_Zero);
+  UD_ERROR_NULL(pFile, udR_MemoryAllocationFailure);
+
+  if (udFile_TranslatePath(&pFile->pFilenameCopy, pFilename) != udR_Success)
+  {
+    pFile->pFilenameCopy = udStrdup(pFilename);
+    UD_ERROR_NULL(pFile->pFilenameCopy, udR_MemoryAllocationFailure);
+  }
+  pFile->filenameCopyRequiresFree = true; // Let the system free the duplicate filename
+
+  // File open failures shouldn't trigger breakpoints with BREAK_ON_ERROR defined.
+  if (udFileExists(pFile->pFilenameCopy, &fileLength) != udR_Success)
+    UD_ERROR_SET_NO_BREAK(udR_OpenFailure);
+  UD_ERROR_IF((uint64_t)fileLength > (uint64_t)SIZE_MAX, udR_Unsupported); // Can't be mapped whole in this address space
+
+  pFile->fileLength = fileLength;
+  pFile->mappedLength = (size_t)fileLength;
+
+#if UDPLATFORM_WINDOWS
+  pFile->hFile = CreateFileW(udOSString(pFile->pFilenameCopy), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+  if (pFile->hFile == INVALID_HANDLE_VALUE)
+  {
+    pFile->hFile = nullptr;
+    UD_ERROR_SET_NO_BREAK(udR_OpenFailure);
+  }
+
+  if (pFile->mappedLength > 0)
+  {
+    pFile->hMapping = CreateFileMappingW(pFile->hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    UD_ERROR_NULL(pFile->hMapping, udR_OpenFailure);
+    pFile->pMapping = (const uint8_t*)MapViewOfFile(pFile->hMapping, FILE_MAP_READ, 0, 0, 0);
+    UD_ERROR_NULL(pFile->pMapping, udR_OpenFailure);
+  }
+#elif UDFILE_MMAP_POSIX
+  if (pFile->mappedLength > 0)
+  {
+    int fd = open(pFile->pFilenameCopy, O_RDONLY);
+    if (fd == -1)
+      UD_ERROR_SET_NO_BREAK(udR_OpenFailure);
+
+    void *pMapping = mmap(nullptr, pFile->mappedLength, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    UD_ERROR_IF(pMapping == MAP_FAILED, udR_OpenFailure);
+    pFile->pMapping = (const uint8_t*)pMapping;
+  }
+#else
+  UD_ERROR_SET(udR_Unsupported);
+#endif
+
+  pFile->fpRead = udFileHandler_MMapSeekRead;
+  pFile->fpBorrow = udFileHandler_MMapBorrow;
+  pFile->fpClose = udFileHandler_MMapClose;
+
+  *ppFile = pFile;
+  pFile = nullptr;
+  result = udR_Success;
+
+epilogue:
+  if (pFile)
+  {
+    udFree(pFile->pFilenameCopy);
+    udFileHandler_MMapClose((udFile**)&pFile);
+  }
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+// Implementation of BorrowHandler, returns a pointer straight into the mapping
+static udResult udFileHandler_MMapBorrow(udFile *pFile, const void **ppData, size_t length, int64_t seekOffset, size_t *pActualLength)
+{
+  udFile_MMap *pMMap = static_cast<udFile_MMap*>(pFile);
+  size_t available = 0;
+
+  if (seekOffset < 0)
+    return udR_InvalidParameter_;
+
+  if ((uint64_t)seekOffset < (uint64_t)pMMap->mappedLength)
+    available = udMin(length, pMMap->mappedLength - (size_t)seekOffset);
+
+  *ppData = available ? pMMap->pMapping + seekOffset : nullptr;
+  if (pActualLength)
+    *pActualLength = available;
+
+  return udR_Success;
+}
+
+// ----------------------------------------------------------------------------
+// Implementation of SeekReadHandler, copies from the mapping so reads from any number of threads run in parallel
+static udResult udFileHandler_MMapSeekRead(udFile *pFile, void *pBuffer, size_t bufferLength, int64_t seekOffset, size_t *pActualRead, udFilePipelinedRequest * /*pPipelinedRequest*/)
+{
+  UDTRACE();
+  const void *pData = nullptr;
+  size_t actualRead = 0;
+  udResult result = udFileHandler_MMapBorrow(pFile, &pData, bufferLength, seekOffset, &actualRead);
+
+  if (result == udR_Success && actualRead)
+    memcpy(pBuffer, pData, actualRead);
+  if (pActualRead)
+    *pActualRead = actualRead;
+
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+// Implementation of CloseHandler, unmaps the file
+static udResult udFileHandler_MMapClose(udFile **ppFile)
+{
+  UDTRACE();
+  udResult result = udR_Success;
+  udFile_MMap *pMMap = static_cast<udFile_MMap*>(*ppFile);
+  *ppFile = nullptr;
+
+  if (pMMap)
+  {
+#if UDPLATFORM_WINDOWS
+    if (pMMap->pMapping && !UnmapViewOfFile(pMMap->pMapping))
+      result = udR_CloseFailure;
+    if (pMMap->hMapping)
+      CloseHandle(pMMap->hMapping);
+    if (pMMap->hFile)
+      CloseHandle(pMMap->hFile);
+#elif UDFILE_MMAP_POSIX
+    if (pMMap->pMapping && munmap((void*)pMMap->pMapping, pMMap->mappedLength) != 0)
+      result = udR_CloseFailure;
+#endif
+    udFree(pMMap);
+  }
+
+  return result;
+}
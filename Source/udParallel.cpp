@@ -0,0 +1,180 @@
+#include "udParallel.h"
+
+#include "udPlatformUtil.h"
+#include "udThread.h"
+
+// With no grain size given, aim for about this many grains per participant so the tail can still be balanced
+#define AUTO_GRAINS_PER_PARTICIPANT 16
+
+struct udParallelJob
+{
+  const udParallelRangeCallback *pFunc; // Owned by the caller, only used while there are grains left to claim
+  udSemaphore *pDoneSemaphore;
+
+  size_t startIndex;
+  size_t endIndex;
+  size_t grainSize;
+  size_t firstGrain; // Grain containing startIndex, grain boundaries are at multiples of grainSize
+
+  int32_t totalGrains;
+  uint32_t participantCount;
+  volatile int32_t nextGrain;
+  volatile int32_t completedGrains;
+  volatile int32_t nextParticipant;
+  volatile int32_t refCount; // One for the caller and one for each helper task
+};
+
+// ----------------------------------------------------------------------------
+static void udParallel_ReleaseJob(udParallelJob *pJob)
+{
+  if (udInterlockedPreDecrement(&pJob->refCount) != 0)
+    return;
+
+  udDestroySemaphore(&pJob->pDoneSemaphore);
+  udFree(pJob);
+}
+
+// ----------------------------------------------------------------------------
+// Claim the next run of grains, runs shrink as the range is used up so the last claims are small enough to balance
+static bool udParallel_ClaimGrains(udParallelJob *pJob, int32_t *pFirstGrain, int32_t *pGrainCount)
+{
+  int32_t claimed = pJob->nextGrain;
+
+  while (claimed < pJob->totalGrains)
+  {
+    int32_t grainCount = udMax(1, (pJob->totalGrains - claimed) / (int32_t)(2 * pJob->participantCount));
+    int32_t previous = udInterlockedCompareExchange(&pJob->nextGrain, claimed + grainCount, claimed);
+    if (previous == claimed)
+    {
+      *pFirstGrain = claimed;
+      *pGrainCount = grainCount;
+      return true;
+    }
+    claimed = previous;
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Run grains until there are none left to claim
+static void udParallel_Participate(udParallelJob *pJob)
+{
+  uint32_t participant = (uint32_t)udInterlockedPostIncrement(&pJob->nextParticipant);
+  int32_t firstGrain;
+  int32_t grainCount;
+
+  while (udParallel_ClaimGrains(pJob, &firstGrain, &grainCount))
+  {
+    size_t rangeStart = udMax(pJob->startIndex, (pJob->firstGrain + firstGrain) * pJob->grainSize);
+    size_t rangeEnd = (pJob->firstGrain + firstGrain + grainCount) * pJob->grainSize;
+    if (firstGrain + grainCount == pJob->totalGrains)
+      rangeEnd = pJob->endIndex;
+
+    (*pJob->pFunc)(rangeStart, rangeEnd, participant);
+
+    if (udInterlockedAdd(&pJob->completedGrains, grainCount) == pJob->totalGrains)
+      udIncrementSemaphore(pJob->pDoneSemaphore);
+  }
+}
+
+// ----------------------------------------------------------------------------
+uint32_t udParallel_GetParticipantCount(udWorkerPool *pPool)
+{
+  return (uint32_t)udWorkerPool_GetThreadCount(pPool) + 1;
+}
+
+// ----------------------------------------------------------------------------
+udResult udParallel_Run(udWorkerPool *pPool, size_t startIndex, size_t endIndex, size_t grainSize, const udParallelRangeCallback &func)
+{
+  udResult result;
+  udParallelJob *pJob = nullptr;
+  uint32_t participantCount = udParallel_GetParticipantCount(pPool);
+  uint32_t helperCount;
+  size_t totalGrains;
+  udWorkerPoolTaskHandle *pHelpers[UINT8_MAX] = {}; // Pools have at most UINT8_MAX threads
+
+  UD_ERROR_IF(startIndex > endIndex, udR_InvalidParameter_);
+  UD_ERROR_IF(!func, udR_InvalidParameter_);
+
+  if (startIndex == endIndex)
+    UD_ERROR_SET(udR_Success);
+
+  if (grainSize == 0)
+    grainSize = udMax((size_t)1, (endIndex - startIndex) / (participantCount * AUTO_GRAINS_PER_PARTICIPANT));
+
+  // Grains are counted with 32-bit interlocked operations
+  while ((endIndex - 1) / grainSize - startIndex / grainSize >= INT32_MAX)
+    grainSize *= 2;
+
+  totalGrains = (endIndex - 1) / grainSize - startIndex / grainSize + 1;
+  helperCount = (uint32_t)udMin((size_t)participantCount - 1, totalGrains - 1);
+
+  if (helperCount == 0)
+  {
+    func(startIndex, endIndex, 0);
+    UD_ERROR_SET(udR_Success);
+  }
+
+  pJob = udAllocType(udParallelJob, 1, udAF_Zero);
+  UD_ERROR_NULL(pJob, udR_MemoryAllocationFailure);
+
+  pJob->pDoneSemaphore = udCreateSemaphore();
+  if (pJob->pDoneSemaphore == nullptr)
+  {
+    udFree(pJob);
+    UD_ERROR_SET(udR_MemoryAllocationFailure);
+  }
+
+  pJob->pFunc = &func;
+  pJob->startIndex = startIndex;
+  pJob->endIndex = endIndex;
+  pJob->grainSize = grainSize;
+  pJob->firstGrain = startIndex / grainSize;
+  pJob->totalGrains = (int32_t)totalGrains;
+  pJob->participantCount = participantCount;
+  pJob->refCount = (int32_t)helperCount + 1;
+
+  {
+    // Helpers that only start once the range is done find nothing to claim and just drop their reference
+    udWorkerPoolCallback helperFunc = [pJob](void *)
+    {
+      udParallel_Participate(pJob);
+      udParallel_ReleaseJob(pJob);
+    };
+
+    for (uint32_t i = 0; i < helperCount; ++i)
+    {
+      if (udWorkerPool_AddTask(pPool, helperFunc, nullptr, false, nullptr, udWPP_Normal, &pHelpers[i]) != udR_Success)
+        udParallel_ReleaseJob(pJob); // The calling thread will pick up the slack
+    }
+  }
+
+  udParallel_Participate(pJob);
+  if (pJob->completedGrains != pJob->totalGrains)
+    udWaitSemaphore(pJob->pDoneSemaphore);
+
+  // Helpers still queued would have nothing to do, revoke them rather than leaving them for the pool
+  for (uint32_t i = 0; i < helperCount; ++i)
+  {
+    if (pHelpers[i] != nullptr && udWorkerPool_CancelTask(pHelpers[i]) == udR_Success)
+      udParallel_ReleaseJob(pJob);
+    udWorkerPool_ReleaseTaskHandle(&pHelpers[i]);
+  }
+
+  udParallel_ReleaseJob(pJob);
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+udResult udParallelFor(udWorkerPool *pPool, size_t startIndex, size_t endIndex, size_t grainSize, udCallback<void(size_t startIndex, size_t endIndex)> func)
+{
+  if (!func)
+    return udR_InvalidParameter_;
+
+  udParallelRangeCallback runFunc = [&func](size_t rangeStart, size_t rangeEnd, uint32_t /*participant*/) { func(rangeStart, rangeEnd); };
+  return udParallel_Run(pPool, startIndex, endIndex, grainSize, runFunc);
+}
@@ -414,8 +414,196 @@ epilogue:
 }
 
 // *********************************************************************
-int udGetHardwareThreadCount()
+// Where a processor sits in the hardware, core and node are indices that only have meaning relative to other processors
+struct udHardwareProcessor
 {
+  int processor; // OS processor number as used for affinity
+  int core;
+  int node;
+  int sibling; // Index of this processor among those sharing its core
+};
+
+#if UDPLATFORM_LINUX || UDPLATFORM_ANDROID
+// *********************************************************************
+static bool udHardwareProcessor_ReadSysInt(int *pValue, const char *pFormat, int processor)
+{
+  // sysfs files report a size they don't have, so these are read directly rather than with udFile_Load
+  FILE *pFile = fopen(udTempStr(pFormat, processor), "r");
+  if (pFile == nullptr)
+    return false;
+
+  bool success = (fscanf(pFile, "%d", pValue) == 1);
+  fclose(pFile);
+
+  return success;
+}
+
+// *********************************************************************
+static int udHardwareProcessor_GetNode(int processor)
+{
+  // The processor's sysfs folder contains a nodeN link for the node it's on
+  udFindDir *pFindDir = nullptr;
+  int node = 0;
+
+  if (udOpenDir(&pFindDir, udTempStr("/sys/devices/system/cpu/cpu%d", processor)) != udR_Success)
+    return 0;
+
+  do
+  {
+    int charCount = 0;
+    if (udStrBeginsWith(pFindDir->pFilename, "node"))
+    {
+      int value = udStrAtoi(pFindDir->pFilename + 4, &charCount);
+      if (charCount > 0)
+      {
+        node = value;
+        break;
+      }
+    }
+  } while (udReadDir(pFindDir) == udR_Success);
+
+  udCloseDir(&pFindDir);
+  return node;
+}
+#endif
+
+// *********************************************************************
+// Get every processor available to this process, the caller must udFree the list
+static int udHardwareProcessor_GetList(udHardwareProcessor **ppProcessors)
+{
+  udHardwareProcessor *pProcessors = nullptr;
+  int count = 0;
+
+#if UDPLATFORM_WINDOWS
+  DWORD_PTR processMask;
+  DWORD_PTR systemMask;
+  SYSTEM_LOGICAL_PROCESSOR_INFORMATION *pInfo = nullptr;
+  DWORD infoLength = 0;
+
+  if (!::GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    processMask = 1;
+
+  pProcessors = udAllocType(udHardwareProcessor, sizeof(DWORD_PTR) * 8, udAF_Zero);
+  if (pProcessors == nullptr)
+    return 0;
+
+  for (int i = 0; i < (int)sizeof(DWORD_PTR) * 8; ++i)
+  {
+    if (processMask & ((DWORD_PTR)1 << i))
+    {
+      pProcessors[count].processor = i;
+      pProcessors[count].core = i;
+      ++count;
+    }
+  }
+
+  // Core and node masks only cover the first processor group, which matches what the affinity mask can express
+  ::GetLogicalProcessorInformation(nullptr, &infoLength);
+  pInfo = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION*)udAlloc(infoLength);
+  if (pInfo && ::GetLogicalProcessorInformation(pInfo, &infoLength))
+  {
+    for (DWORD infoIndex = 0; infoIndex < infoLength / sizeof(*pInfo); ++infoIndex)
+    {
+      for (int i = 0; i < count; ++i)
+      {
+        if (!(pInfo[infoIndex].ProcessorMask & ((ULONG_PTR)1 << pProcessors[i].processor)))
+          continue;
+
+        if (pInfo[infoIndex].Relationship == RelationProcessorCore)
+          pProcessors[i].core = (int)infoIndex;
+        else if (pInfo[infoIndex].Relationship == RelationNumaNode)
+          pProcessors[i].node = (int)pInfo[infoIndex].NumaNode.NodeNumber;
+      }
+    }
+  }
+  udFree(pInfo);
+#elif UDPLATFORM_LINUX || UDPLATFORM_ANDROID
+  cpu_set_t processSet;
+  CPU_ZERO(&processSet);
+  if (sched_getaffinity(0, sizeof(processSet), &processSet) != 0)
+  {
+    // No affinity information so assume every online processor, stopping once that many are set
+    int onlineCount = udMax(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    for (int i = 0; i < CPU_SETSIZE && CPU_COUNT(&processSet) < onlineCount; ++i)
+      CPU_SET(i, &processSet);
+  }
+
+  pProcessors = udAllocType(udHardwareProcessor, CPU_COUNT(&processSet), udAF_Zero);
+  if (pProcessors == nullptr)
+    return 0;
+
+  for (int i = 0; i < CPU_SETSIZE; ++i)
+  {
+    if (!CPU_ISSET(i, &processSet))
+      continue;
+
+    int coreId = i;
+    int packageId = 0;
+    if (udHardwareProcessor_ReadSysInt(&coreId, "/sys/devices/system/cpu/cpu%d/topology/core_id", i))
+      udHardwareProcessor_ReadSysInt(&packageId, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i);
+    else
+      coreId = i; // No topology information (eg. some containers) so treat every processor as its own core
+
+    pProcessors[count].processor = i;
+    pProcessors[count].core = (packageId << 16) + coreId; // Core ids are only unique within a package
+    pProcessors[count].node = udHardwareProcessor_GetNode(i);
+    ++count;
+  }
+#else
+  count = udMax(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+  pProcessors = udAllocType(udHardwareProcessor, count, udAF_Zero);
+  if (pProcessors == nullptr)
+    return 0;
+
+  for (int i = 0; i < count; ++i)
+  {
+    pProcessors[i].processor = i;
+    pProcessors[i].core = i;
+  }
+#endif
+
+  // Number each processor among those sharing its core
+  for (int i = 0; i < count; ++i)
+  {
+    for (int j = 0; j < i; ++j)
+    {
+      if (pProcessors[j].core == pProcessors[i].core)
+        ++pProcessors[i].sibling;
+    }
+  }
+
+  *ppProcessors = pProcessors;
+  return count;
+}
+
+// *********************************************************************
+int udGetHardwareThreadCount(udHardwareTopology *pTopology /*= nullptr*/)
+{
+  if (pTopology)
+  {
+    udHardwareProcessor *pProcessors = nullptr;
+    int count = udHardwareProcessor_GetList(&pProcessors);
+
+    memset(pTopology, 0, sizeof(*pTopology));
+    pTopology->logicalProcessorCount = count;
+    for (int i = 0; i < count; ++i)
+    {
+      bool firstOfCore = true;
+      bool firstOfNode = true;
+      for (int j = 0; j < i && (firstOfCore || firstOfNode); ++j)
+      {
+        firstOfCore &= (pProcessors[j].core != pProcessors[i].core);
+        firstOfNode &= (pProcessors[j].node != pProcessors[i].node);
+      }
+
+      pTopology->physicalCoreCount += firstOfCore;
+      pTopology->numaNodeCount += firstOfNode;
+      pTopology->maxSMTSiblings = udMax(pTopology->maxSMTSiblings, pProcessors[i].sibling + 1);
+    }
+
+    udFree(pProcessors);
+  }
+
 #if UDPLATFORM_WINDOWS
   DWORD_PTR processMask;
   DWORD_PTR systemMask;
@@ -432,11 +620,49 @@ int udGetHardwareThreadCount()
   }
 
   return 1;
+#elif UDPLATFORM_LINUX || UDPLATFORM_ANDROID
+  // Matches the processors udHardwareProcessor_GetList reports, so a restricted affinity (eg. taskset or a container) isn't oversubscribed
+  cpu_set_t processSet;
+  CPU_ZERO(&processSet);
+  if (sched_getaffinity(0, sizeof(processSet), &processSet) == 0)
+    return udMax(1, CPU_COUNT(&processSet));
+
+  return udMax(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
 #else
   return sysconf(_SC_NPROCESSORS_ONLN);
 #endif
 }
 
+// *********************************************************************
+int udGetHardwareProcessors(int *pProcessors, int maxProcessors, int nodeIndex /*= -1*/)
+{
+  udHardwareProcessor *pHardware = nullptr;
+  int hardwareCount;
+  int written = 0;
+
+  if (pProcessors == nullptr || maxProcessors <= 0)
+    return 0;
+
+  hardwareCount = udHardwareProcessor_GetList(&pHardware);
+
+  // First thread of every core, then second threads and so on
+  for (int sibling = 0, remaining = hardwareCount; remaining > 0 && written < maxProcessors; ++sibling)
+  {
+    for (int i = 0; i < hardwareCount && written < maxProcessors; ++i)
+    {
+      if (pHardware[i].sibling != sibling)
+        continue;
+
+      --remaining;
+      if (nodeIndex < 0 || pHardware[i].node == nodeIndex)
+        pProcessors[written++] = pHardware[i].processor;
+    }
+  }
+
+  udFree(pHardware);
+  return written;
+}
+
 // *********************************************************************
 bool udFilename::SetFromFullPath(const char *pFormat, ...)
 {
@@ -262,6 +262,31 @@ static void udSocketmbedDebug(void * /*pUserData*/, int /*level*/, const char *f
   udDebugPrintf("%s:%04d: %s\n", file, line, str);
 }
 
+// --------------------------------------------------------------------------
+udResult udSocket_GetLocalPort(udSocket *pSocket, uint32_t *pPort)
+{
+  udResult result;
+  sockaddr_storage address;
+  socklen_t addressLength = sizeof(address);
+
+  UD_ERROR_IF(!udSocket_IsValidSocket(pSocket), udR_InvalidParameter_);
+  UD_ERROR_NULL(pPort, udR_InvalidParameter_);
+
+  if (getsockname(pSocket->isSecure ? (SOCKET)pSocket->tlsClient.socketContext.fd : pSocket->basicSocket, (sockaddr*)&address, &addressLength) == SOCKET_ERROR)
+    UD_ERROR_SET(udR_SocketError);
+
+  if (address.ss_family == AF_INET)
+    *pPort = ntohs(((sockaddr_in*)&address)->sin_port);
+  else if (address.ss_family == AF_INET6)
+    *pPort = ntohs(((sockaddr_in6*)&address)->sin6_port);
+  else
+    UD_ERROR_SET(udR_Unsupported);
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
 // --------------------------------------------------------------------------
 // Author: Paul Fox, October 2018
 udResult udSocket_Open(udSocket **ppSocket, const char *pAddress, uint32_t port, udSocketConnectionFlags flags, const char *pPrivateKey /*= nullptr*/, const char *pPublicCertificate /*= nullptr*/)
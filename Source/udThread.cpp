@@ -69,6 +69,7 @@ struct udThread
   void *pThreadData;
   udSemaphore *pCacheSemaphore; // Semaphore is non-null only while on the cached thread list
   volatile int32_t refCount;
+  bool hasAffinity; // Cleared before the thread is cached so whoever reclaims it doesn't inherit the restriction
 };
 
 // ----------------------------------------------------------------------------
@@ -84,6 +85,8 @@ static uint32_t udThread_Bootstrap(udThread *pThread)
       udDebugPrintf("Successfully reclaimed thread %p\n", pThread);
 #endif
     threadReturnValue = pThread->threadStarter ? pThread->threadStarter(pThread->pThreadData) : 0;
+    if (pThread->hasAffinity)
+      udThread_SetAffinity(pThread, nullptr, 0);
 
     pThread->threadStarter = nullptr;
     udInterlockedExchangePointer(&pThread->pThreadData, nullptr);
@@ -218,6 +221,60 @@ void udThread_SetPriority(udThread *pThread, udThreadPriority priority)
   }
 }
 
+// ****************************************************************************
+udResult udThread_SetAffinity(udThread *pThread, const int *pProcessors, int processorCount)
+{
+  udResult result;
+
+  UD_ERROR_NULL(pThread, udR_InvalidParameter_);
+  UD_ERROR_IF(processorCount < 0 || (pProcessors == nullptr && processorCount > 0), udR_InvalidParameter_);
+
+#if UDPLATFORM_WINDOWS
+  {
+    DWORD_PTR mask = 0;
+    DWORD_PTR systemMask;
+
+    for (int i = 0; i < processorCount; ++i)
+    {
+      if (pProcessors[i] >= 0 && pProcessors[i] < (int)sizeof(DWORD_PTR) * 8)
+        mask |= (DWORD_PTR)1 << pProcessors[i];
+    }
+    if (processorCount == 0)
+      ::GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask);
+
+    UD_ERROR_IF(mask == 0, udR_InvalidParameter_);
+    UD_ERROR_IF(SetThreadAffinityMask(pThread->handle, mask) == 0, udR_Failure_);
+  }
+#elif UDPLATFORM_LINUX
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (int i = 0; i < processorCount; ++i)
+    {
+      if (pProcessors[i] >= 0 && pProcessors[i] < CPU_SETSIZE)
+        CPU_SET(pProcessors[i], &set);
+    }
+    if (processorCount == 0)
+    {
+      for (int i = 0; i < CPU_SETSIZE; ++i)
+        CPU_SET(i, &set); // The kernel limits this to what the process is allowed
+    }
+
+    UD_ERROR_IF(CPU_COUNT(&set) == 0, udR_InvalidParameter_);
+    UD_ERROR_IF(pthread_setaffinity_np(pThread->t, sizeof(set), &set) != 0, udR_Failure_);
+  }
+#else
+  UD_ERROR_SET(udR_Unsupported);
+#endif
+
+  pThread->hasAffinity = (processorCount > 0);
+  result = udR_Success;
+
+epilogue:
+  return result;
+}
+
 // ****************************************************************************
 void udThread_Destroy(udThread **ppThread)
 {
@@ -432,13 +489,13 @@ void udIncrementSemaphore(udSemaphore *pSemaphore, int count)
     sem_post(&pSemaphore->handle);
 # endif
 #else
-  while (count-- > 0)
-  {
-    udLockMutex(pSemaphore->pMutex);
-    ++(pSemaphore->count);
-    udSignalConditionVariable(pSemaphore->pCondition);
-    udReleaseMutex(pSemaphore->pMutex);
-  }
+  if (count <= 0)
+    return;
+
+  udLockMutex(pSemaphore->pMutex);
+  pSemaphore->count += count;
+  udSignalConditionVariable(pSemaphore->pCondition, count);
+  udReleaseMutex(pSemaphore->pMutex);
 #endif
 }
 
@@ -8,10 +8,20 @@
 #include "udMath.h"
 #include "udStringUtil.h"
 
-struct udWorkerPoolThread
+// Every this many tasks a worker starts its scan at a lower lane so they still get served while higher lanes are busy
+#define LOWER_LANE_INTERVAL 8
+
+// Post tasks taken off the queue per lock in udWorkerPool_DoPostWork
+#define POST_WORK_BATCH_SIZE 16
+
+// Polls an idle thread makes for new tasks before it sleeps, see udWorkerPool_SetIdleSpinCount
+#define DEFAULT_IDLE_SPIN_COUNT 1000
+
+enum udWorkerPoolTaskState
 {
-  udWorkerPool *pPool;
-  udThread *pThread;
+  udWPTS_Queued, // Also covers tasks still waiting on predecessors
+  udWPTS_Started,
+  udWPTS_Cancelled,
 };
 
 struct udWorkerPoolTask
@@ -19,16 +29,59 @@ struct udWorkerPoolTask
   udWorkerPoolCallback function;
   udWorkerPoolCallback postFunction; // runs on main thread
   void *pDataBlock;
+  udWorkerPoolTaskHandle *pHandle; // Optional, only allocated when the caller asks for a handle or the task has predecessors
+  udWorkerPoolTaskGroup *pGroup; // Optional
   bool freeDataBlock;
 };
 
+struct udWorkerPoolTaskGroup
+{
+  udMutex *pMutex;
+  udConditionVariable *pCondition;
+  volatile int32_t pendingTasks; // Added but not yet run (or discarded), including tasks waiting on predecessors
+  volatile int32_t finishingTasks; // Threads between taking pendingTasks to zero and signalling, the group can't be destroyed until they're done
+  int32_t waiters; // Protected by pMutex
+};
+
+// An edge in the task graph, an entry in a predecessor's list of tasks to release when it completes
+struct udWorkerPoolDependent
+{
+  udWorkerPoolTaskHandle *pTaskHandle;
+  udWorkerPoolDependent *pNext;
+};
+
+struct udWorkerPoolTaskHandle
+{
+  volatile int32_t state; // udWorkerPoolTaskState
+  volatile int32_t refCount; // One for the caller (if they asked for the handle), one for the task
+  volatile int32_t pendingPredecessors; // The task is queued when this reaches zero
+  udWorkerPoolDependent *volatile pDependents; // Set to s_dependentsClosed once the task has completed
+  udWorkerPool *pPool; // Only set while the task is waiting on predecessors
+  udWorkerPoolTask *pWaitingTask; // Only set while the task is waiting on predecessors
+  udWorkerPoolPriority priority;
+};
+
+// Sentinel marking a dependents list as closed, tasks added after this don't wait on that predecessor
+static udWorkerPoolDependent s_dependentsClosed;
+
+struct udWorkerPoolThread
+{
+  udWorkerPool *pPool;
+  udThread *pThread;
+  udSafeDeque<udWorkerPoolTask> *pQueuedTasks[udWPP_Count]; // One per priority lane, owner pops from the front, idle threads steal from the back
+  uint32_t servedCount; // Tasks this thread has popped, used for starvation protection
+};
+
 struct udWorkerPool
 {
-  udSafeDeque<udWorkerPoolTask> *pQueuedTasks;
   udSafeDeque<udWorkerPoolTask> *pQueuedPostTasks;
 
   udSemaphore *pSemaphore;
-  volatile int32_t activeThreads;
+  volatile int32_t idleThreads; // Threads that found no work and are (or are about to be) waiting on the semaphore
+  volatile int32_t queuedTasks[udWPP_Count]; // Total tasks in each lane across all the per-thread queues
+  volatile int32_t nextQueue; // Round-robin index for tasks added from outside the pool
+  volatile uint32_t idleSpinCount;
+  udWorkerPoolTaskGroup idleGroup; // Every task is also in this group, used by udWorkerPool_WaitForIdle and udWorkerPool_HasActiveWorkers
 
   uint8_t totalThreads;
   udWorkerPoolThread *pThreadData;
@@ -36,6 +89,284 @@ struct udWorkerPool
   udInterlockedBool isRunning;
 };
 
+// The worker the current thread is running as (if any), so tasks added from a worker go to its own queue
+static UDTHREADLOCAL udWorkerPoolThread *s_pCurrentWorker = nullptr;
+
+static udResult udWorkerPool_QueueTask(udWorkerPool *pPool, udWorkerPoolPriority priority, const udWorkerPoolTask &task);
+static void udWorkerPool_CompleteTask(udWorkerPoolTaskHandle *pTaskHandle, bool wasCancelled);
+
+// ----------------------------------------------------------------------------
+static udResult udWorkerPool_InitTaskGroup(udWorkerPoolTaskGroup *pGroup)
+{
+  pGroup->pMutex = udCreateMutex();
+  pGroup->pCondition = udCreateConditionVariable();
+  if (pGroup->pMutex == nullptr || pGroup->pCondition == nullptr)
+    return udR_MemoryAllocationFailure;
+
+  return udR_Success;
+}
+
+// ----------------------------------------------------------------------------
+static void udWorkerPool_DeinitTaskGroup(udWorkerPoolTaskGroup *pGroup)
+{
+  // A thread that finished the last task may still be signalling
+  while (pGroup->finishingTasks > 0)
+    udYield();
+
+  udDestroyConditionVariable(&pGroup->pCondition);
+  udDestroyMutex(&pGroup->pMutex);
+}
+
+// ----------------------------------------------------------------------------
+// Tasks have been added to the group
+static void udWorkerPool_TaskGroupAdd(udWorkerPoolTaskGroup *pGroup, size_t taskCount)
+{
+  if (pGroup != nullptr)
+    udInterlockedAdd(&pGroup->pendingTasks, (int32_t)taskCount);
+}
+
+// ----------------------------------------------------------------------------
+// Tasks in the group have run (or been discarded), wakes any joiners if they were the last
+static void udWorkerPool_TaskGroupFinish(udWorkerPoolTaskGroup *pGroup, size_t taskCount)
+{
+  if (pGroup == nullptr)
+    return;
+
+  udInterlockedPreIncrement(&pGroup->finishingTasks);
+  if (udInterlockedAdd(&pGroup->pendingTasks, -(int32_t)taskCount) == 0)
+  {
+    udLockMutex(pGroup->pMutex);
+    if (pGroup->waiters > 0)
+      udSignalConditionVariable(pGroup->pCondition, pGroup->waiters);
+    udReleaseMutex(pGroup->pMutex);
+  }
+  udInterlockedPreDecrement(&pGroup->finishingTasks);
+}
+
+// ----------------------------------------------------------------------------
+// Sleep until every task in the group has run
+static udResult udWorkerPool_TaskGroupWait(udWorkerPoolTaskGroup *pGroup, int waitMs)
+{
+  udResult result = udR_Success;
+  uint64_t startTime;
+
+  if (pGroup->pendingTasks == 0)
+    return udR_Success;
+
+  startTime = udPerfCounterStart();
+  udLockMutex(pGroup->pMutex);
+  ++pGroup->waiters;
+
+  while (pGroup->pendingTasks > 0)
+  {
+    int remainingMs = waitMs;
+    if (waitMs != UDTHREAD_WAIT_INFINITE)
+    {
+      remainingMs = waitMs - (int)udPerfCounterMilliseconds(startTime);
+      if (remainingMs <= 0)
+      {
+        result = udR_Timeout;
+        break;
+      }
+    }
+
+    udWaitConditionVariable(pGroup->pCondition, pGroup->pMutex, remainingMs);
+  }
+
+  --pGroup->waiters;
+  udReleaseMutex(pGroup->pMutex);
+
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+// The task has run (or been discarded), it no longer counts towards its group or the pool being idle
+static void udWorkerPool_FinishTask(udWorkerPool *pPool, udWorkerPoolTask *pTask)
+{
+  udWorkerPool_TaskGroupFinish(pTask->pGroup, 1);
+  udWorkerPool_TaskGroupFinish(&pPool->idleGroup, 1);
+}
+
+// ----------------------------------------------------------------------------
+// Free the data block of a task that will never be run, cancelling anything waiting on it. The caller must still finish the task
+static void udWorkerPool_DiscardTask(udWorkerPoolTask *pTask)
+{
+  if (pTask->freeDataBlock)
+    udFree(pTask->pDataBlock);
+
+  if (pTask->pHandle)
+  {
+    udInterlockedCompareExchange(&pTask->pHandle->state, udWPTS_Cancelled, udWPTS_Queued);
+    udWorkerPool_CompleteTask(pTask->pHandle, true);
+    udWorkerPool_ReleaseTaskHandle(&pTask->pHandle);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// One predecessor of a waiting task has completed, queue the task if it was the last
+static void udWorkerPool_ReleasePredecessor(udWorkerPoolTaskHandle *pTaskHandle)
+{
+  if (udInterlockedPreDecrement(&pTaskHandle->pendingPredecessors) != 0)
+    return;
+
+  udWorkerPool *pPool = pTaskHandle->pPool;
+  udWorkerPoolTask *pTask = pTaskHandle->pWaitingTask;
+  pTaskHandle->pWaitingTask = nullptr;
+
+  // Fails if the pool is being destroyed, in which case the task (and anything waiting on it) is discarded
+  if (udWorkerPool_QueueTask(pPool, pTaskHandle->priority, *pTask) != udR_Success)
+  {
+    udWorkerPool_DiscardTask(pTask);
+    udWorkerPool_FinishTask(pPool, pTask);
+  }
+
+  pTask->~udWorkerPoolTask();
+  udFree(pTask);
+}
+
+// ----------------------------------------------------------------------------
+// Close the dependents list of a task that has run (or been discarded) and release everything waiting on it
+static void udWorkerPool_CompleteTask(udWorkerPoolTaskHandle *pTaskHandle, bool wasCancelled)
+{
+  udWorkerPoolDependent *pDependent = udInterlockedExchangePointer(&pTaskHandle->pDependents, &s_dependentsClosed);
+
+  while (pDependent != nullptr && pDependent != &s_dependentsClosed)
+  {
+    udWorkerPoolDependent *pNext = pDependent->pNext;
+
+    if (wasCancelled)
+      udInterlockedCompareExchange(&pDependent->pTaskHandle->state, udWPTS_Cancelled, udWPTS_Queued);
+    udWorkerPool_ReleasePredecessor(pDependent->pTaskHandle);
+
+    udFree(pDependent);
+    pDependent = pNext;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Wake up to taskCount threads that are sleeping, busy threads pick up new tasks when they finish their current one
+static void udWorkerPool_WakeIdleThreads(udWorkerPool *pPool, size_t taskCount)
+{
+  int32_t idleThreads = pPool->idleThreads;
+  if (idleThreads > 0)
+    udIncrementSemaphore(pPool->pSemaphore, (int)udMin((size_t)idleThreads, taskCount));
+}
+
+// ----------------------------------------------------------------------------
+static bool udWorkerPool_HasQueuedTasks(udWorkerPool *pPool)
+{
+  for (int lane = 0; lane < udWPP_Count; ++lane)
+  {
+    if (pPool->queuedTasks[lane] > 0)
+      return true;
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Pop from the thread's own queue for a lane, or failing that steal from the back of another thread's queue
+static bool udWorkerPool_PopLane(udWorkerPoolThread *pThreadData, int lane, udWorkerPoolTask *pTask)
+{
+  udWorkerPool *pPool = pThreadData->pPool;
+
+  if (udSafeDeque_PopFront(pThreadData->pQueuedTasks[lane], pTask) == udR_Success)
+    return true;
+
+  int selfIndex = (int)(pThreadData - pPool->pThreadData);
+  for (int i = 1; i < pPool->totalThreads; ++i)
+  {
+    udWorkerPoolThread *pVictim = &pPool->pThreadData[(selfIndex + i) % pPool->totalThreads];
+    if (udSafeDeque_PopBack(pVictim->pQueuedTasks[lane], pTask) == udR_Success)
+      return true;
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Pop the highest priority task available to this thread
+static bool udWorkerPool_PopTask(udWorkerPoolThread *pThreadData, udWorkerPoolTask *pTask)
+{
+  udWorkerPool *pPool = pThreadData->pPool;
+  bool haveTask = false;
+  int firstLane = udWPP_High;
+  int lane = firstLane;
+
+  if (((pThreadData->servedCount + 1) % LOWER_LANE_INTERVAL) == 0)
+    firstLane = 1 + (int)((pThreadData->servedCount / LOWER_LANE_INTERVAL) % (udWPP_Count - 1));
+
+  for (int i = 0; i < udWPP_Count && !haveTask; ++i)
+  {
+    lane = (firstLane + i) % udWPP_Count;
+    if (pPool->queuedTasks[lane] > 0)
+      haveTask = udWorkerPool_PopLane(pThreadData, lane, pTask);
+  }
+
+  if (haveTask)
+  {
+    udInterlockedPreDecrement(&pPool->queuedTasks[lane]);
+    ++pThreadData->servedCount;
+  }
+
+  return haveTask;
+}
+
+// ----------------------------------------------------------------------------
+// Push a run of tasks onto one thread's queue in a single critical section, adding the number actually queued to *pPublished even on failure
+static udResult udWorkerPool_PublishTasks(udWorkerPool *pPool, udWorkerPoolThread *pQueueOwner, udWorkerPoolPriority priority, const udWorkerPoolTaskDesc *pTasks, size_t taskCount, udWorkerPoolTaskHandle **ppTaskHandles, udWorkerPoolTaskGroup *pGroup, size_t *pPublished)
+{
+  udResult result = udR_Success;
+  udWorkerPoolTask tempTask;
+  size_t published = 0;
+  udMutex *pMutex = nullptr;
+
+  tempTask.pHandle = nullptr;
+  tempTask.pGroup = pGroup;
+  udInterlockedAdd(&pPool->queuedTasks[priority], (int32_t)taskCount); // Counted before the push so a thief can never take one uncounted
+  udWorkerPool_TaskGroupAdd(pGroup, taskCount);
+  udWorkerPool_TaskGroupAdd(&pPool->idleGroup, taskCount);
+
+  pMutex = udLockMutex(pQueueOwner->pQueuedTasks[priority]->pMutex);
+  UD_ERROR_NULL(pMutex, udR_NotInitialized_);
+
+  for (; published < taskCount; ++published)
+  {
+    if (ppTaskHandles)
+    {
+      tempTask.pHandle = udAllocType(udWorkerPoolTaskHandle, 1, udAF_Zero);
+      UD_ERROR_NULL(tempTask.pHandle, udR_MemoryAllocationFailure);
+      tempTask.pHandle->state = udWPTS_Queued;
+      tempTask.pHandle->refCount = 2;
+    }
+
+    tempTask.function = pTasks[published].function;
+    tempTask.postFunction = pTasks[published].postFunction;
+    tempTask.pDataBlock = pTasks[published].pUserData;
+    tempTask.freeDataBlock = pTasks[published].clearMemory;
+
+    result = pQueueOwner->pQueuedTasks[priority]->chunkedArray.PushBack(tempTask);
+    if (result != udR_Success)
+      udFree(tempTask.pHandle);
+    UD_ERROR_HANDLE();
+
+    if (ppTaskHandles)
+      ppTaskHandles[published] = tempTask.pHandle;
+  }
+
+epilogue:
+  udReleaseMutex(pMutex);
+  if (published != taskCount)
+  {
+    udInterlockedAdd(&pPool->queuedTasks[priority], -(int32_t)(taskCount - published));
+    udWorkerPool_TaskGroupFinish(pGroup, taskCount - published);
+    udWorkerPool_TaskGroupFinish(&pPool->idleGroup, taskCount - published);
+  }
+  *pPublished += published;
+
+  return result;
+}
+
 // ----------------------------------------------------------------------------
 // Author: Paul Fox, May 2015
 uint32_t udWorkerPool_DoWork(void *pPoolPtr)
@@ -46,65 +377,119 @@ uint32_t udWorkerPool_DoWork(void *pPoolPtr)
   udWorkerPool *pPool = pThreadData->pPool;
 
   udWorkerPoolTask currentTask;
-  int waitValue;
+
+  s_pCurrentWorker = pThreadData;
 
   while (pPool->isRunning)
   {
-    waitValue = udWaitSemaphore(pPool->pSemaphore, 100);
-
-    if (waitValue != 0)
-      continue;
-
-    udInterlockedPreIncrement(&pPool->activeThreads);
+    if (!udWorkerPool_PopTask(pThreadData, &currentTask))
+    {
+      bool haveTask = false;
+
+      // Spin for a little first so a burst of tasks doesn't have to wake sleeping threads one at a time
+      for (uint32_t spin = pPool->idleSpinCount; spin > 0 && !haveTask && pPool->isRunning; --spin)
+      {
+        udSpinPause();
+        if (udWorkerPool_HasQueuedTasks(pPool))
+          haveTask = udWorkerPool_PopTask(pThreadData, &currentTask);
+      }
+
+      if (!haveTask)
+      {
+        // Advertise as idle before checking one last time, so a task added concurrently is either found here or wakes this thread
+        udInterlockedPreIncrement(&pPool->idleThreads);
+        haveTask = udWorkerPool_PopTask(pThreadData, &currentTask);
+        if (!haveTask && pPool->isRunning)
+          udWaitSemaphore(pPool->pSemaphore); // udWorkerPool_Destroy wakes every thread after clearing isRunning
+        udInterlockedPreDecrement(&pPool->idleThreads);
+      }
+
+      if (!haveTask)
+        continue;
+    }
 
-    if (udSafeDeque_PopFront(pPool->pQueuedTasks, &currentTask) != udR_Success)
+    // Cancelled tasks are left in the queue to keep cancelling cheap, they are thrown away here instead
+    if (currentTask.pHandle && udInterlockedCompareExchange(&currentTask.pHandle->state, udWPTS_Started, udWPTS_Queued) != udWPTS_Queued)
     {
-      udInterlockedPreIncrement(&pPool->activeThreads);
+      udWorkerPool_DiscardTask(&currentTask);
+      udWorkerPool_FinishTask(pPool, &currentTask);
       continue;
     }
 
     if (currentTask.function)
       currentTask.function(currentTask.pDataBlock);
 
+    // Release anything waiting on this task, successors already count towards the idle group
+    if (currentTask.pHandle)
+      udWorkerPool_CompleteTask(currentTask.pHandle, false);
+    udWorkerPool_ReleaseTaskHandle(&currentTask.pHandle);
+
     if (currentTask.postFunction)
       udSafeDeque_PushBack(pPool->pQueuedPostTasks, currentTask);
     else if (currentTask.freeDataBlock)
       udFree(currentTask.pDataBlock);
 
-    udInterlockedPreDecrement(&pPool->activeThreads);
+    udWorkerPool_FinishTask(pPool, &currentTask);
   }
 
+  s_pCurrentWorker = nullptr;
+
   return 0;
 }
 
 // ----------------------------------------------------------------------------
 // Author: Paul Fox, May 2015
-udResult udWorkerPool_Create(udWorkerPool **ppPool, uint8_t totalThreads, const char *pThreadNamePrefix /*= "udWorkerPool"*/)
+udResult udWorkerPool_Create(udWorkerPool **ppPool, uint8_t totalThreads, const char *pThreadNamePrefix /*= "udWorkerPool"*/, const udWorkerPoolOptions *pOptions /*= nullptr*/)
 {
   udResult result = udR_Failure_;
   udWorkerPool *pPool = nullptr;
+  int *pProcessors = nullptr;
+  int processorCount = 0;
 
   UD_ERROR_NULL(ppPool, udR_InvalidParameter_);
   UD_ERROR_IF(totalThreads == 0, udR_InvalidParameter_);
 
+  if (pOptions != nullptr && (pOptions->pinThreads || pOptions->numaNode >= 0))
+  {
+    processorCount = udGetHardwareThreadCount();
+    pProcessors = udAllocType(int, processorCount, udAF_None);
+    UD_ERROR_NULL(pProcessors, udR_MemoryAllocationFailure);
+    processorCount = udGetHardwareProcessors(pProcessors, processorCount, pOptions->numaNode);
+    UD_ERROR_IF(processorCount == 0, udR_InvalidConfiguration); // No processors on that node
+  }
+
   pPool = udAllocType(udWorkerPool, 1, udAF_Zero);
   UD_ERROR_NULL(pPool, udR_MemoryAllocationFailure);
 
   pPool->pSemaphore = udCreateSemaphore();
   UD_ERROR_NULL(pPool, udR_MemoryAllocationFailure);
 
-  UD_ERROR_CHECK(udSafeDeque_Create(&pPool->pQueuedTasks, 32));
   UD_ERROR_CHECK(udSafeDeque_Create(&pPool->pQueuedPostTasks, 32));
+  UD_ERROR_CHECK(udWorkerPool_InitTaskGroup(&pPool->idleGroup));
 
   pPool->isRunning = true;
+  pPool->idleSpinCount = DEFAULT_IDLE_SPIN_COUNT;
   pPool->totalThreads = totalThreads;
   pPool->pThreadData = udAllocType(udWorkerPoolThread, pPool->totalThreads, udAF_Zero);
   UD_ERROR_NULL(pPool->pThreadData, udR_MemoryAllocationFailure);
 
+  // All queues must exist before any thread starts as idle threads steal from each other
   for (int i = 0; i < pPool->totalThreads; ++i)
   {
     pPool->pThreadData[i].pPool = pPool;
+    for (int lane = 0; lane < udWPP_Count; ++lane)
+      UD_ERROR_CHECK(udSafeDeque_Create(&pPool->pThreadData[i].pQueuedTasks[lane], 32));
+  }
+
+  for (int i = 0; i < pPool->totalThreads; ++i)
+  {
     UD_ERROR_CHECK(udThread_Create(&pPool->pThreadData[i].pThread, udWorkerPool_DoWork, &pPool->pThreadData[i], udTCF_None, udTempStr("%s%d", pThreadNamePrefix, i)));
+
+    // Failure here only costs performance so it doesn't fail the pool
+    if (processorCount > 0 && pOptions->pinThreads)
+      udThread_SetAffinity(pPool->pThreadData[i].pThread, &pProcessors[i % processorCount], 1);
+    else if (processorCount > 0)
+      udThread_SetAffinity(pPool->pThreadData[i].pThread, pProcessors, processorCount);
   }
 
   result = udR_Success;
@@ -112,6 +497,7 @@ udResult udWorkerPool_Create(udWorkerPool **ppPool, uint8_t totalThreads, const
   pPool = nullptr;
 
 epilogue:
+  udFree(pProcessors);
   udWorkerPool_Destroy(&pPool);
 
   return result;
@@ -128,18 +514,31 @@ void udWorkerPool_Destroy(udWorkerPool **ppPool)
   *ppPool = nullptr;
 
   pPool->isRunning = false;
-
-  for (int i = 0; i < pPool->totalThreads; i++)
-  {
-    udThread_Join(pPool->pThreadData[i].pThread);
-    udThread_Destroy(&pPool->pThreadData[i].pThread);
-  }
+  if (pPool->pSemaphore)
+    udIncrementSemaphore(pPool->pSemaphore, pPool->totalThreads); // Each thread checks isRunning before sleeping again so one wake each is enough
 
   udWorkerPoolTask currentTask;
-  while (udSafeDeque_PopFront(pPool->pQueuedTasks, &currentTask) == udR_Success)
+
+  if (pPool->pThreadData)
   {
-    if (currentTask.freeDataBlock)
-      udFree(currentTask.pDataBlock);
+    for (int i = 0; i < pPool->totalThreads; i++)
+    {
+      udThread_Join(pPool->pThreadData[i].pThread);
+      udThread_Destroy(&pPool->pThreadData[i].pThread);
+    }
+
+    for (int i = 0; i < pPool->totalThreads; i++)
+    {
+      for (int lane = 0; lane < udWPP_Count; ++lane)
+      {
+        while (udSafeDeque_PopFront(pPool->pThreadData[i].pQueuedTasks[lane], &currentTask) == udR_Success)
+        {
+          udWorkerPool_DiscardTask(&currentTask);
+          udWorkerPool_FinishTask(pPool, &currentTask);
+        }
+        udSafeDeque_Destroy(&pPool->pThreadData[i].pQueuedTasks[lane]);
+      }
+    }
   }
 
   while (udSafeDeque_PopFront(pPool->pQueuedPostTasks, &currentTask) == udR_Success)
@@ -148,9 +547,9 @@ void udWorkerPool_Destroy(udWorkerPool **ppPool)
       udFree(currentTask.pDataBlock);
   }
 
-  udSafeDeque_Destroy(&pPool->pQueuedTasks);
   udSafeDeque_Destroy(&pPool->pQueuedPostTasks);
   udDestroySemaphore(&pPool->pSemaphore);
+  udWorkerPool_DeinitTaskGroup(&pPool->idleGroup);
 
   udFree(pPool->pThreadData);
   udFree(pPool);
@@ -158,54 +557,310 @@ void udWorkerPool_Destroy(udWorkerPool **ppPool)
 
 // ----------------------------------------------------------------------------
 // Author: Paul Fox, May 2015
-udResult udWorkerPool_AddTask(udWorkerPool *pPool, udWorkerPoolCallback func, void *pUserData /*= nullptr*/, bool clearMemory /*= true*/, udWorkerPoolCallback postFunction /*= nullptr*/)
+udResult udWorkerPool_AddTask(udWorkerPool *pPool, udWorkerPoolCallback func, void *pUserData /*= nullptr*/, bool clearMemory /*= true*/, udWorkerPoolCallback postFunction /*= nullptr*/, udWorkerPoolPriority priority /*= udWPP_Normal*/, udWorkerPoolTaskHandle **ppTaskHandle /*= nullptr*/, udWorkerPoolTaskGroup *pGroup /*= nullptr*/)
+{
+  udWorkerPoolTaskDesc task;
+
+  task.function = func;
+  task.pUserData = pUserData;
+  task.clearMemory = clearMemory;
+  task.postFunction = postFunction;
+
+  return udWorkerPool_AddTasks(pPool, &task, 1, priority, ppTaskHandle, pGroup);
+}
+
+// ----------------------------------------------------------------------------
+udResult udWorkerPool_AddTasks(udWorkerPool *pPool, const udWorkerPoolTaskDesc *pTasks, size_t taskCount, udWorkerPoolPriority priority /*= udWPP_Normal*/, udWorkerPoolTaskHandle **ppTaskHandles /*= nullptr*/, udWorkerPoolTaskGroup *pGroup /*= nullptr*/)
 {
   udResult result = udR_Failure_;
-  udWorkerPoolTask tempTask;
+  size_t published = 0;
+
+  if (ppTaskHandles)
+    memset(ppTaskHandles, 0, taskCount * sizeof(*ppTaskHandles));
 
   UD_ERROR_NULL(pPool, udR_InvalidParameter_);
-  UD_ERROR_NULL(pPool->pQueuedTasks, udR_NotInitialized_);
+  UD_ERROR_IF(pTasks == nullptr || taskCount == 0 || taskCount > INT32_MAX, udR_InvalidParameter_);
+  UD_ERROR_IF(priority < udWPP_High || priority >= udWPP_Count, udR_InvalidParameter_);
+  UD_ERROR_NULL(pPool->pThreadData, udR_NotInitialized_);
   UD_ERROR_NULL(pPool->pQueuedPostTasks, udR_NotInitialized_);
   UD_ERROR_NULL(pPool->pSemaphore, udR_NotInitialized_);
   UD_ERROR_IF(!pPool->isRunning, udR_NotAllowed);
 
-  tempTask.function = func;
-  tempTask.postFunction = postFunction;
-  tempTask.pDataBlock = pUserData;
-  tempTask.freeDataBlock = clearMemory;
+  if (s_pCurrentWorker != nullptr && s_pCurrentWorker->pPool == pPool)
+  {
+    // Tasks added from one of this pool's workers stay on that worker for the others to steal
+    UD_ERROR_CHECK(udWorkerPool_PublishTasks(pPool, s_pCurrentWorker, priority, pTasks, taskCount, ppTaskHandles, pGroup, &published));
+  }
+  else
+  {
+    // Others are split into one contiguous slice per thread, starting from the next round-robin queue
+    uint32_t firstQueue = (uint32_t)udInterlockedPostIncrement(&pPool->nextQueue);
+    size_t sliceLength = (taskCount + pPool->totalThreads - 1) / pPool->totalThreads;
+    for (size_t sliceStart = 0, i = 0; sliceStart < taskCount; sliceStart += sliceLength, ++i)
+    {
+      udWorkerPoolThread *pQueueOwner = &pPool->pThreadData[(firstQueue + i) % pPool->totalThreads];
+      UD_ERROR_CHECK(udWorkerPool_PublishTasks(pPool, pQueueOwner, priority, pTasks + sliceStart, udMin(sliceLength, taskCount - sliceStart), ppTaskHandles ? ppTaskHandles + sliceStart : nullptr, pGroup, &published));
+    }
+  }
+
+  result = udR_Success;
+
+epilogue:
+  // Slices published before a failure are runnable, and parked workers won't find them unless they're woken
+  if (published > 0)
+    udWorkerPool_WakeIdleThreads(pPool, published);
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+// Queue a single task whose predecessors have all completed
+static udResult udWorkerPool_QueueTask(udWorkerPool *pPool, udWorkerPoolPriority priority, const udWorkerPoolTask &task)
+{
+  udResult result;
+  udWorkerPoolThread *pQueueOwner;
+
+  UD_ERROR_IF(!pPool->isRunning, udR_NotAllowed);
+
+  if (s_pCurrentWorker != nullptr && s_pCurrentWorker->pPool == pPool)
+    pQueueOwner = s_pCurrentWorker; // Usually the worker that just completed the last predecessor, so the data is likely still in its cache
+  else
+    pQueueOwner = &pPool->pThreadData[(uint32_t)udInterlockedPostIncrement(&pPool->nextQueue) % pPool->totalThreads];
+
+  udInterlockedPreIncrement(&pPool->queuedTasks[priority]);
+  result = udSafeDeque_PushBack(pQueueOwner->pQueuedTasks[priority], task);
+  if (result != udR_Success)
+    udInterlockedPreDecrement(&pPool->queuedTasks[priority]);
+  UD_ERROR_HANDLE();
+
+  udWorkerPool_WakeIdleThreads(pPool, 1);
+
+epilogue:
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+udResult udWorkerPool_AddDependentTask(udWorkerPool *pPool, udWorkerPoolTaskHandle *const *ppPredecessors, size_t predecessorCount, udWorkerPoolCallback func, void *pUserData /*= nullptr*/, bool clearMemory /*= true*/, udWorkerPoolCallback postFunction /*= nullptr*/, udWorkerPoolPriority priority /*= udWPP_Normal*/, udWorkerPoolTaskHandle **ppTaskHandle /*= nullptr*/, udWorkerPoolTaskGroup *pGroup /*= nullptr*/)
+{
+  udResult result;
+  udWorkerPoolTaskHandle *pTaskHandle = nullptr;
+  udWorkerPoolTask *pTask = nullptr;
+  udWorkerPoolDependent *pDependents = nullptr;
+
+  if (ppTaskHandle)
+    *ppTaskHandle = nullptr;
+
+  UD_ERROR_NULL(pPool, udR_InvalidParameter_);
+  UD_ERROR_IF(ppPredecessors == nullptr && predecessorCount > 0, udR_InvalidParameter_);
+  UD_ERROR_IF(priority < udWPP_High || priority >= udWPP_Count, udR_InvalidParameter_);
+  UD_ERROR_NULL(pPool->pThreadData, udR_NotInitialized_);
+  UD_ERROR_IF(!pPool->isRunning, udR_NotAllowed);
+  for (size_t i = 0; i < predecessorCount; ++i)
+    UD_ERROR_NULL(ppPredecessors[i], udR_InvalidParameter_);
+
+  // Every edge is allocated before any is published, once the first is published nothing below can fail
+  for (size_t i = 0; i < predecessorCount; ++i)
+  {
+    udWorkerPoolDependent *pDependent = udAllocType(udWorkerPoolDependent, 1, udAF_Zero);
+    UD_ERROR_NULL(pDependent, udR_MemoryAllocationFailure);
+    pDependent->pNext = pDependents;
+    pDependents = pDependent;
+  }
+
+  pTaskHandle = udAllocType(udWorkerPoolTaskHandle, 1, udAF_Zero);
+  UD_ERROR_NULL(pTaskHandle, udR_MemoryAllocationFailure);
+  pTask = udAllocType(udWorkerPoolTask, 1, udAF_Zero);
+  UD_ERROR_NULL(pTask, udR_MemoryAllocationFailure);
+  pTask = new (pTask) udWorkerPoolTask();
+
+  pTask->function = func;
+  pTask->postFunction = postFunction;
+  pTask->pDataBlock = pUserData;
+  pTask->freeDataBlock = clearMemory;
+  pTask->pHandle = pTaskHandle;
+  pTask->pGroup = pGroup;
+
+  pTaskHandle->state = udWPTS_Queued;
+  pTaskHandle->refCount = ppTaskHandle ? 2 : 1;
+  pTaskHandle->pendingPredecessors = 1; // Held until all the edges are added so the task can't be queued early
+  pTaskHandle->pPool = pPool;
+  pTaskHandle->pWaitingTask = pTask;
+  pTaskHandle->priority = priority;
+  pTask = nullptr;
+
+  // Counted from now as the task will eventually be run or discarded
+  udWorkerPool_TaskGroupAdd(pGroup, 1);
+  udWorkerPool_TaskGroupAdd(&pPool->idleGroup, 1);
+
+  for (size_t i = 0; i < predecessorCount; ++i)
+  {
+    udWorkerPoolTaskHandle *pPredecessor = ppPredecessors[i];
+    udWorkerPoolDependent *pDependent = pDependents;
+    pDependents = pDependent->pNext;
+
+    pDependent->pTaskHandle = pTaskHandle;
+    udInterlockedPreIncrement(&pTaskHandle->pendingPredecessors);
+
+    udWorkerPoolDependent *pHead;
+    do
+    {
+      pHead = pPredecessor->pDependents;
+      if (pHead == &s_dependentsClosed)
+        break;
+      pDependent->pNext = pHead;
+    } while (udInterlockedCompareExchangePointer(&pPredecessor->pDependents, pDependent, pHead) != pHead);
+
+    if (pHead == &s_dependentsClosed)
+    {
+      // Predecessor has already completed, a cancelled predecessor still cancels this task
+      if (pPredecessor->state == udWPTS_Cancelled)
+        udInterlockedCompareExchange(&pTaskHandle->state, udWPTS_Cancelled, udWPTS_Queued);
+      udInterlockedPreDecrement(&pTaskHandle->pendingPredecessors);
+      udFree(pDependent);
+    }
+  }
+
+  if (ppTaskHandle)
+    *ppTaskHandle = pTaskHandle;
+  result = udR_Success;
 
-  UD_ERROR_CHECK(udSafeDeque_PushBack(pPool->pQueuedTasks, tempTask));
-  udIncrementSemaphore(pPool->pSemaphore);
+epilogue:
+  if (pTask)
+  {
+    pTask->~udWorkerPoolTask();
+    udFree(pTask);
+  }
+  if (pTaskHandle)
+  {
+    if (pTaskHandle->pWaitingTask)
+      udWorkerPool_ReleasePredecessor(pTaskHandle); // Drop the hold, queueing (or discarding if cancelled) once all the predecessors are done
+    else
+      udFree(pTaskHandle);
+  }
+
+  while (pDependents)
+  {
+    udWorkerPoolDependent *pNext = pDependents->pNext;
+    udFree(pDependents);
+    pDependents = pNext;
+  }
+
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+udResult udWorkerPool_CreateTaskGroup(udWorkerPoolTaskGroup **ppGroup)
+{
+  udResult result;
+  udWorkerPoolTaskGroup *pGroup = nullptr;
 
+  UD_ERROR_NULL(ppGroup, udR_InvalidParameter_);
+
+  pGroup = udAllocType(udWorkerPoolTaskGroup, 1, udAF_Zero);
+  UD_ERROR_NULL(pGroup, udR_MemoryAllocationFailure);
+  UD_ERROR_CHECK(udWorkerPool_InitTaskGroup(pGroup));
+
+  *ppGroup = pGroup;
+  pGroup = nullptr;
   result = udR_Success;
 
 epilogue:
+  udWorkerPool_DestroyTaskGroup(&pGroup);
+
   return result;
 }
 
+// ----------------------------------------------------------------------------
+void udWorkerPool_DestroyTaskGroup(udWorkerPoolTaskGroup **ppGroup)
+{
+  if (ppGroup == nullptr || *ppGroup == nullptr)
+    return;
+
+  udWorkerPoolTaskGroup *pGroup = *ppGroup;
+  *ppGroup = nullptr;
+
+  udWorkerPool_DeinitTaskGroup(pGroup);
+  udFree(pGroup);
+}
+
+// ----------------------------------------------------------------------------
+udResult udWorkerPool_JoinTaskGroup(udWorkerPoolTaskGroup *pGroup, int waitMs /*= UDTHREAD_WAIT_INFINITE*/)
+{
+  if (pGroup == nullptr)
+    return udR_InvalidParameter_;
+
+  return udWorkerPool_TaskGroupWait(pGroup, waitMs);
+}
+
+// ----------------------------------------------------------------------------
+udResult udWorkerPool_WaitForIdle(udWorkerPool *pPool, int waitMs /*= UDTHREAD_WAIT_INFINITE*/)
+{
+  if (pPool == nullptr)
+    return udR_InvalidParameter_;
+  if (pPool->idleGroup.pMutex == nullptr)
+    return udR_NotInitialized_;
+
+  return udWorkerPool_TaskGroupWait(&pPool->idleGroup, waitMs);
+}
+
+// ----------------------------------------------------------------------------
+udResult udWorkerPool_CancelTask(udWorkerPoolTaskHandle *pTaskHandle)
+{
+  if (pTaskHandle == nullptr)
+    return udR_InvalidParameter_;
+
+  if (udInterlockedCompareExchange(&pTaskHandle->state, udWPTS_Cancelled, udWPTS_Queued) == udWPTS_Queued)
+    return udR_Success;
+
+  return udR_NothingToDo;
+}
+
+// ----------------------------------------------------------------------------
+void udWorkerPool_ReleaseTaskHandle(udWorkerPoolTaskHandle **ppTaskHandle)
+{
+  if (ppTaskHandle == nullptr || *ppTaskHandle == nullptr)
+    return;
+
+  udWorkerPoolTaskHandle *pTaskHandle = *ppTaskHandle;
+  *ppTaskHandle = nullptr;
+
+  if (udInterlockedPreDecrement(&pTaskHandle->refCount) == 0)
+    udFree(pTaskHandle);
+}
+
 // ----------------------------------------------------------------------------
 // Author: Paul Fox, May 2015
 udResult udWorkerPool_DoPostWork(udWorkerPool *pPool, int processLimit /*= 0*/)
 {
-  udWorkerPoolTask currentTask;
+  udWorkerPoolTask currentTasks[POST_WORK_BATCH_SIZE];
   udResult result = udR_Success;
   int processedItems = 0;
+  size_t batchCount = 0;
 
   UD_ERROR_NULL(pPool, udR_InvalidParameter_);
-  UD_ERROR_NULL(pPool->pQueuedTasks, udR_NotInitialized_);
+  UD_ERROR_NULL(pPool->pThreadData, udR_NotInitialized_);
   UD_ERROR_NULL(pPool->pQueuedPostTasks, udR_NotInitialized_);
   UD_ERROR_NULL(pPool->pSemaphore, udR_NotInitialized_);
   UD_ERROR_IF(!pPool->isRunning, udR_NotAllowed);
 
-  while (udSafeDeque_PopFront(pPool->pQueuedPostTasks, &currentTask) == udR_Success)
+  for (;;)
   {
-    currentTask.postFunction(currentTask.pDataBlock);
+    // Never take more than processLimit allows, anything taken off the queue has to be run here
+    size_t batchLimit = POST_WORK_BATCH_SIZE;
+    if (processLimit > 0)
+      batchLimit = udMin(batchLimit, (size_t)(processLimit - processedItems));
 
-    if (currentTask.freeDataBlock)
-      udFree(currentTask.pDataBlock);
-
-    if (++processedItems == processLimit)
+    if (batchLimit == 0 || udSafeDeque_PopFrontRange(pPool->pQueuedPostTasks, currentTasks, batchLimit, &batchCount) != udR_Success)
       break;
+
+    for (size_t i = 0; i < batchCount; ++i)
+    {
+      currentTasks[i].postFunction(currentTasks[i].pDataBlock);
+
+      if (currentTasks[i].freeDataBlock)
+        udFree(currentTasks[i].pDataBlock);
+    }
+
+    processedItems += (int)batchCount;
   }
 
 epilogue:
@@ -215,6 +870,22 @@ epilogue:
   return result;
 }
 
+// ----------------------------------------------------------------------------
+void udWorkerPool_SetIdleSpinCount(udWorkerPool *pPool, uint32_t spinCount)
+{
+  if (pPool != nullptr)
+    pPool->idleSpinCount = spinCount;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t udWorkerPool_GetThreadCount(udWorkerPool *pPool)
+{
+  if (pPool == nullptr)
+    return 0;
+
+  return pPool->totalThreads;
+}
+
 // ----------------------------------------------------------------------------
 // Author: Paul Fox, May 2015
 bool udWorkerPool_HasActiveWorkers(udWorkerPool *pPool)
@@ -222,9 +893,6 @@ bool udWorkerPool_HasActiveWorkers(udWorkerPool *pPool)
   if (pPool == nullptr)
     return false;
 
-  udLockMutex(pPool->pQueuedTasks->pMutex);
-  bool isActive = (pPool->activeThreads > 0 || pPool->pQueuedTasks->chunkedArray.length > 0);
-  udReleaseMutex(pPool->pQueuedTasks->pMutex);
-
-  return isActive;
+  // Uses the same count as udWorkerPool_WaitForIdle, a task leaves it only once it has run (or been discarded)
+  return (pPool->idleGroup.pendingTasks > 0);
 }
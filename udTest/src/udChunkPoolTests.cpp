@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include "udChunkPool.h"
+#include "udWorkerPool.h"
+
+TEST(udChunkPoolTests, Recycling)
+{
+  udChunkPool *pPool = nullptr;
+
+  EXPECT_EQ(udR_InvalidParameter_, udChunkPool_Create(nullptr, 64));
+  EXPECT_EQ(udR_InvalidParameter_, udChunkPool_Create(&pPool, 0));
+  EXPECT_EQ(nullptr, udChunkPool_GetAllocator(nullptr));
+  EXPECT_EQ(0u, udChunkPool_GetCachedCount(nullptr));
+
+  ASSERT_EQ(udR_Success, udChunkPool_Create(&pPool, 64 * sizeof(uint32_t), 64));
+  udChunkAllocator *pAllocator = udChunkPool_GetAllocator(pPool);
+  ASSERT_NE(nullptr, pAllocator);
+
+  udChunkedArray<uint32_t> array;
+  ASSERT_EQ(udR_Success, array.Init(64, pAllocator));
+  for (uint32_t i = 0; i < 64 * 4; ++i)
+    EXPECT_EQ(udR_Success, array.PushBack(i));
+  for (uint32_t i = 0; i < 10; ++i)
+    EXPECT_EQ(udR_Success, array.PushFront(i));
+  EXPECT_EQ(0u, udChunkPool_GetCachedCount(pPool));
+
+  size_t chunkCount = array.chunkCount;
+  uint32_t *pLastChunk = array.ppChunks[chunkCount - 1]; // Freed last
+  array.Deinit();
+  EXPECT_EQ(chunkCount, udChunkPool_GetCachedCount(pPool));
+
+  // The next array on this thread gets the most recently freed chunk back
+  ASSERT_EQ(udR_Success, array.Init(64, pAllocator));
+  EXPECT_EQ(pLastChunk, array.ppChunks[0]);
+  EXPECT_EQ(chunkCount - 1, udChunkPool_GetCachedCount(pPool));
+  array.Deinit();
+
+  // Chunks bigger than the pool's go straight to the system allocator
+  udChunkedArray<uint64_t> bigArray;
+  ASSERT_EQ(udR_Success, bigArray.Init(64, pAllocator));
+  EXPECT_EQ(chunkCount, udChunkPool_GetCachedCount(pPool));
+  bigArray.Deinit();
+  EXPECT_EQ(chunkCount, udChunkPool_GetCachedCount(pPool));
+
+  // The cache is capped, the rest are freed
+  ASSERT_EQ(udR_Success, array.Init(64, pAllocator));
+  EXPECT_EQ(udR_Success, array.GrowBack(64 * 40));
+  array.Deinit();
+  EXPECT_GE(64u, udChunkPool_GetCachedCount(pPool));
+  EXPECT_LT(0u, udChunkPool_GetCachedCount(pPool));
+
+  udChunkPool_Destroy(&pPool);
+  EXPECT_EQ(nullptr, pPool);
+  udChunkPool_Destroy(&pPool);
+}
+
+TEST(udChunkPoolTests, Threaded)
+{
+  udChunkPool *pPool = nullptr;
+  udWorkerPool *pWorkers = nullptr;
+  ASSERT_EQ(udR_Success, udChunkPool_Create(&pPool, 32 * sizeof(uint32_t)));
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pWorkers, 4, "udChunkPoolTest"));
+
+  // Arrays built and torn down on many threads at once, each sees only its own data
+  volatile int32_t badArrays = 0;
+  udWorkerPoolCallback buildFunc = [pPool, &badArrays](void *)
+  {
+    for (int pass = 0; pass < 20; ++pass)
+    {
+      udChunkedArray<uint32_t> array;
+      array.Init(32, udChunkPool_GetAllocator(pPool));
+      for (uint32_t i = 0; i < 1000; ++i)
+        array.PushBack(i);
+
+      for (uint32_t i = 0; i < 1000; ++i)
+      {
+        if (array[i] != i)
+        {
+          udInterlockedPreIncrement(&badArrays);
+          break;
+        }
+      }
+      array.Deinit();
+    }
+  };
+
+  for (int i = 0; i < 32; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pWorkers, buildFunc, nullptr, false));
+  EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pWorkers, UDTHREAD_WAIT_INFINITE));
+  EXPECT_EQ(0, badArrays);
+
+  udWorkerPool_Destroy(&pWorkers);
+  udChunkPool_Destroy(&pPool);
+}
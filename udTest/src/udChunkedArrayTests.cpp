@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "udChunkedArray.h"
+#include "udPlatformUtil.h"
+#include "udDebug.h"
 
 TEST(udChunkedArrayTests, ToArray)
 {
@@ -187,3 +189,110 @@ TEST(udChunkedArrayTests, Iterator)
   array.Deinit();
 }
 
+
+TEST(udChunkedArrayTests, ShiftMaskIndexing)
+{
+  udChunkedArray<uint32_t> array;
+
+  // Indexing relies on power of two chunk sizes, anything else is rejected
+  EXPECT_EQ(udR_InvalidParameter_, array.Init(0));
+  EXPECT_EQ(udR_InvalidParameter_, array.Init(3));
+  EXPECT_EQ(udR_InvalidParameter_, array.Init(100));
+
+  // Agrees with the divide based lookup at every index, with an inset and across chunk boundaries
+  const size_t chunkSizes[] = { 1, 2, 8, 64 };
+  for (size_t chunkElementCount : chunkSizes)
+  {
+    ASSERT_EQ(udR_Success, array.Init(chunkElementCount));
+    for (uint32_t i = 0; i < 200; ++i)
+      ASSERT_EQ(udR_Success, array.PushBack(i));
+    array.PopFront();
+    array.PopFront();
+
+    for (size_t i = 0; i < array.length; ++i)
+    {
+      size_t index = i + array.inset;
+      EXPECT_EQ(&array.ppChunks[index / chunkElementCount][index % chunkElementCount], array.GetElement(i));
+      EXPECT_EQ(i + 2, array[i]);
+      EXPECT_EQ(udMin(chunkElementCount - index % chunkElementCount, array.length - i), array.GetElementRunLength(i));
+    }
+    array.Deinit();
+  }
+}
+
+static int udChunkedArrayTests_CompareInt(const void *pA, const void *pB)
+{
+  int a = *(const int*)pA;
+  int b = *(const int*)pB;
+  return (a > b) - (a < b);
+}
+
+TEST(udChunkedArrayTests, BulkOperations)
+{
+  int values[100];
+  int buffer[100];
+  udChunkedArray<int> array;
+  ASSERT_EQ(udR_Success, array.Init(16));
+
+  for (int i = 0; i < 100; ++i)
+    values[i] = i;
+
+  // Appending across chunk boundaries, starting from an inset
+  EXPECT_EQ(udR_Success, array.PushBack(-1));
+  EXPECT_EQ(udR_Success, array.PushBack(-2));
+  EXPECT_TRUE(array.PopFront());
+  EXPECT_EQ(udR_InvalidParameter_, array.AppendRange(nullptr, 10));
+  EXPECT_EQ(udR_Success, array.AppendRange(values, 0));
+  EXPECT_EQ(udR_Success, array.AppendRange(values, 100));
+  EXPECT_EQ(101, array.length);
+  EXPECT_EQ(-2, array[0]);
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(i, array[i + 1]);
+
+  // Fill a range then the rest
+  EXPECT_EQ(udR_OutOfRange, array.Fill(7, 102));
+  EXPECT_EQ(udR_OutOfRange, array.Fill(7, 50, 52));
+  EXPECT_EQ(udR_Success, array.Fill(7, 10, 40));
+  EXPECT_EQ(8, array[9]);
+  EXPECT_EQ(7, array[10]);
+  EXPECT_EQ(7, array[49]);
+  EXPECT_EQ(49, array[50]);
+  EXPECT_EQ(udR_Success, array.Fill(3, 90));
+  EXPECT_EQ(88, array[89]);
+  EXPECT_EQ(3, array[100]);
+
+  // Copy back in over part of the array
+  EXPECT_EQ(udR_OutOfRange, array.CopyFrom(values, 90, 12));
+  EXPECT_EQ(udR_Success, array.CopyFrom(values + 9, 10, 40));
+  EXPECT_EQ(udR_Success, array.CopyFrom(values + 89, 90, 11));
+  EXPECT_EQ(udR_Success, array.ToArray(buffer, UDARRAYSIZE(buffer), 1, 100));
+  EXPECT_EQ(0, memcmp(buffer, values, sizeof(values)));
+
+  // Sort, both spread over chunks and within a single chunk
+  EXPECT_EQ(udR_InvalidParameter_, array.Sort(nullptr));
+  for (int i = 0; i < 100; ++i)
+    buffer[i] = (i * 37) % 100;
+  EXPECT_EQ(udR_Success, array.CopyFrom(buffer, 1, 100));
+  EXPECT_EQ(udR_Success, array.Sort(udChunkedArrayTests_CompareInt));
+  EXPECT_EQ(-2, array[0]);
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(i, array[i + 1]);
+
+  array.Clear();
+  EXPECT_EQ(udR_Success, array.Sort(udChunkedArrayTests_CompareInt));
+  EXPECT_EQ(udR_Success, array.AppendRange(buffer, 16));
+  EXPECT_EQ(udR_Success, array.Sort(udChunkedArrayTests_CompareInt));
+  for (size_t i = 1; i < array.length; ++i)
+    EXPECT_LE(array[i - 1], array[i]);
+
+  // Duplicates over several chunks with an inset at the front
+  array.Clear();
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(udR_Success, array.PushFront((i * 7) % 13));
+  EXPECT_EQ(udR_Success, array.Sort(udChunkedArrayTests_CompareInt));
+  EXPECT_EQ(100u, array.length);
+  for (size_t i = 1; i < array.length; ++i)
+    EXPECT_LE(array[i - 1], array[i]);
+
+  array.Deinit();
+}
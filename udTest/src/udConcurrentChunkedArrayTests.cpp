@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include "udConcurrentChunkedArray.h"
+#include "udWorkerPool.h"
+
+TEST(udConcurrentChunkedArrayTests, Basic)
+{
+  udConcurrentChunkedArray<int> array;
+  EXPECT_EQ(udR_InvalidParameter_, array.Init(3));
+  ASSERT_EQ(udR_Success, array.Init(4));
+  EXPECT_EQ(0u, array.GetPublishedLength());
+  EXPECT_EQ(0u, array.GetElementRunLength(0));
+
+  size_t index = 0;
+  EXPECT_EQ(udR_Success, array.PushBack(5, &index));
+  EXPECT_EQ(0u, index);
+  EXPECT_EQ(udR_Success, array.PushBack(6, &index));
+  EXPECT_EQ(1u, index);
+
+  int values[10] = { 10, 11, 12, 13, 14, 15, 16, 17, 18, 19 };
+  EXPECT_EQ(udR_InvalidParameter_, array.AppendRange(nullptr, 2));
+  EXPECT_EQ(udR_Success, array.AppendRange(values, 10, &index));
+  EXPECT_EQ(2u, index);
+  EXPECT_EQ(12u, array.GetPublishedLength());
+  EXPECT_EQ(2u, array.GetElementRunLength(2));
+  EXPECT_EQ(4u, array.GetElementRunLength(4));
+
+  EXPECT_EQ(5, array[0]);
+  EXPECT_EQ(6, array[1]);
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(10 + i, array[2 + i]);
+
+  // Growing past the first pointer array keeps existing chunks where they are
+  int *pFirst = array.GetElement(0);
+  for (int i = 0; i < 1000; ++i)
+    EXPECT_EQ(udR_Success, array.PushBack(i));
+  EXPECT_EQ(pFirst, array.GetElement(0));
+  EXPECT_EQ(999, array[1011]);
+
+  array.Deinit();
+}
+
+TEST(udConcurrentChunkedArrayTests, ConcurrentAppend)
+{
+  const int TaskCount = 16;
+  const uint32_t PushesPerTask = 5000;
+
+  udWorkerPool *pPool = nullptr;
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udConcurrentArrayTest"));
+
+  udConcurrentChunkedArray<uint32_t> array;
+  ASSERT_EQ(udR_Success, array.Init(64));
+
+  // Each task pushes its own id in the top bits, with a mix of single pushes and ranges
+  udWorkerPoolCallback pushFunc = [&array](void *pTaskId)
+  {
+    uint32_t taskId = (uint32_t)(size_t)pTaskId;
+    uint32_t range[3];
+    for (uint32_t i = 0; i < PushesPerTask;)
+    {
+      if (i % 7 == 0 && i + 3 <= PushesPerTask)
+      {
+        for (uint32_t j = 0; j < 3; ++j)
+          range[j] = (taskId << 24) | (i + j);
+        array.AppendRange(range, 3);
+        i += 3;
+      }
+      else
+      {
+        array.PushBack((taskId << 24) | i);
+        ++i;
+      }
+    }
+  };
+
+  for (int i = 0; i < TaskCount; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, pushFunc, (void*)(size_t)i, false));
+
+  // Read what has been published while the pushes are still going, each task's values must appear in order
+  uint32_t nextExpected[TaskCount] = {};
+  size_t readLength = 0;
+  size_t wrongCount = 0;
+  while (readLength < TaskCount * PushesPerTask)
+  {
+    size_t publishedLength = array.GetPublishedLength();
+    for (; readLength < publishedLength; ++readLength)
+    {
+      uint32_t value = array[readLength];
+      uint32_t taskId = value >> 24;
+      if (taskId >= TaskCount || (value & 0xFFFFFF) != nextExpected[taskId])
+        ++wrongCount;
+      else
+        ++nextExpected[taskId];
+    }
+    udYield();
+  }
+
+  EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pPool, UDTHREAD_WAIT_INFINITE));
+  EXPECT_EQ(0u, wrongCount);
+  EXPECT_EQ(TaskCount * PushesPerTask, array.GetPublishedLength());
+  for (int i = 0; i < TaskCount; ++i)
+    EXPECT_EQ(PushesPerTask, nextExpected[i]);
+
+  udWorkerPool_Destroy(&pPool);
+  array.Deinit();
+}
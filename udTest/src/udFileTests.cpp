@@ -5,6 +5,9 @@
 #include "udPlatformUtil.h"
 #include "udStringUtil.h"
 #include "udMath.h"
+#include "udWorkerPool.h"
+#include "udSocket.h"
+#include "udThread.h"
 
 static const size_t s_QBF_Len = 43; // Not including NUL character
 static const char *s_pQBF_Text = "The quick brown fox jumps over the lazy dog";
@@ -109,6 +112,421 @@ TEST(udFileTests, BasicReadWriteLoadFILE)
   EXPECT_NE(udR_Success, udFileExists(pFilename));
 }
 
+TEST(udFileTests, MemoryMappedRead)
+{
+  const char *pFilename = "._donotcommit_MMapTest";
+  const size_t Length = 100000;
+  uint8_t *pData = udAllocType(uint8_t, Length, udAF_None);
+  ASSERT_NE(nullptr, pData);
+  for (size_t i = 0; i < Length; ++i)
+    pData[i] = (uint8_t)(i * 7);
+  ASSERT_EQ(udR_Success, udFile_Save(pFilename, pData, Length));
+
+  udFile *pFile = nullptr;
+  int64_t fileLength = 0;
+  const void *pBorrowed = nullptr;
+  size_t actualLength = 0;
+  uint8_t readBuffer[256];
+
+  // FILE can't lend out pointers
+  EXPECT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Read));
+  EXPECT_EQ(udR_Unsupported, udFile_Borrow(pFile, &pBorrowed, 16, 0));
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+
+  // Writing isn't mapped, it falls back to FILE
+  EXPECT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Read | udFOF_Write | udFOF_MemoryMap));
+  EXPECT_EQ(udR_Unsupported, udFile_Borrow(pFile, &pBorrowed, 16, 0));
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+
+  EXPECT_EQ(udR_OpenFailure, udFile_Open(&pFile, "._donotcommit_MMapTestMissing", udFOF_Read | udFOF_MemoryMap));
+
+  ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Read | udFOF_MemoryMap, &fileLength));
+  EXPECT_EQ((int64_t)Length, fileLength);
+
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, readBuffer, sizeof(readBuffer), 5000, udFSW_SeekSet));
+  EXPECT_EQ(0, memcmp(readBuffer, pData + 5000, sizeof(readBuffer)));
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, readBuffer, sizeof(readBuffer))); // Continues from the last read
+  EXPECT_EQ(0, memcmp(readBuffer, pData + 5000 + sizeof(readBuffer), sizeof(readBuffer)));
+
+  EXPECT_EQ(udR_ReadFailure, udFile_Read(pFile, readBuffer, sizeof(readBuffer), -10, udFSW_SeekEnd));
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, readBuffer, sizeof(readBuffer), -10, udFSW_SeekEnd, &actualLength));
+  EXPECT_EQ(10u, actualLength);
+  EXPECT_EQ(0, memcmp(readBuffer, pData + Length - 10, 10));
+
+  // Borrowed pointers are into the file data, without moving the file position
+  EXPECT_EQ(udR_Success, udFile_Borrow(pFile, &pBorrowed, 1000, 12345));
+  EXPECT_EQ(0, memcmp(pBorrowed, pData + 12345, 1000));
+  EXPECT_EQ(udR_ReadFailure, udFile_Borrow(pFile, &pBorrowed, 1000, Length - 10));
+  EXPECT_EQ(udR_Success, udFile_Borrow(pFile, &pBorrowed, 1000, Length + 10, &actualLength));
+  EXPECT_EQ(0u, actualLength);
+  EXPECT_EQ(udR_InvalidParameter_, udFile_Borrow(pFile, nullptr, 1000, 0));
+
+  udFile_SetSeekBase(pFile, 100);
+  EXPECT_EQ(udR_Success, udFile_Borrow(pFile, &pBorrowed, 10, 0));
+  EXPECT_EQ(0, memcmp(pBorrowed, pData + 100, 10));
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+
+  // Load works through the same handler
+  uint8_t *pLoaded = nullptr;
+  EXPECT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Read | udFOF_MemoryMap));
+  EXPECT_EQ(udR_Success, pFile->fpLoad(pFile, (void**)&pLoaded, &fileLength));
+  EXPECT_EQ((int64_t)Length, fileLength);
+  EXPECT_EQ(0, memcmp(pLoaded, pData, Length));
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+
+  udFree(pLoaded);
+  udFree(pData);
+  EXPECT_EQ(udR_Success, udFileDelete(pFilename));
+}
+
+TEST(udFileTests, MultithreadRead)
+{
+  const char *pFilename = "._donotcommit_MultithreadTest";
+  const size_t BlockSize = 4096;
+  const size_t BlockCount = 512;
+  const int TaskCount = 32;
+  const int ReadsPerTask = 256;
+
+  uint32_t *pData = udAllocType(uint32_t, BlockSize * BlockCount / sizeof(uint32_t), udAF_None);
+  ASSERT_NE(nullptr, pData);
+  for (size_t i = 0; i < BlockSize * BlockCount / sizeof(uint32_t); ++i)
+    pData[i] = (uint32_t)i;
+
+  // Writes through the multithread handler
+  udFile *pFile = nullptr;
+  ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Write | udFOF_Create | udFOF_Multithread));
+  EXPECT_EQ(udR_Success, udFile_Write(pFile, pData, BlockSize * BlockCount / 2));
+  EXPECT_EQ(udR_Success, udFile_Write(pFile, udAddBytes(pData, BlockSize * BlockCount / 2), BlockSize * BlockCount / 2));
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+
+  udWorkerPool *pPool = nullptr;
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udFileMultithreadTest"));
+
+  // FastOpen keeps the FILE handler (reads serialized on its mutex), so both handlers are checked
+  const udFileOpenFlags openFlags[] = { udFOF_Read | udFOF_Multithread | udFOF_FastOpen, udFOF_Read | udFOF_Multithread };
+  for (size_t h = 0; h < UDARRAYSIZE(openFlags); ++h)
+  {
+    int64_t fileLength = 0;
+    ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, openFlags[h], &fileLength));
+
+    volatile int32_t wrongCount = 0;
+    udWorkerPoolCallback readFunc = [pFile, pData, &wrongCount](void *pTaskId)
+    {
+      uint32_t seed = (uint32_t)(size_t)pTaskId + 1;
+      uint8_t buffer[BlockSize];
+      for (int i = 0; i < ReadsPerTask; ++i)
+      {
+        seed = seed * 1664525 + 1013904223;
+        size_t offset = ((seed >> 8) % BlockCount) * BlockSize + (seed & 63);
+        size_t actualRead = 0;
+        if (udFile_Read(pFile, buffer, BlockSize, offset, udFSW_SeekSet, &actualRead) != udR_Success || actualRead != udMin(BlockSize, BlockSize * BlockCount - offset) || memcmp(buffer, udAddBytes(pData, offset), actualRead) != 0)
+          udInterlockedPreIncrement(&wrongCount);
+      }
+    };
+
+    for (int i = 0; i < TaskCount; ++i)
+      EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, readFunc, (void*)(size_t)i, false));
+    EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pPool, UDTHREAD_WAIT_INFINITE));
+
+    udFilePerformance performance;
+    EXPECT_EQ(udR_Success, udFile_GetPerformance(pFile, &performance));
+    EXPECT_EQ(0, performance.requestsInFlight);
+    EXPECT_GE(performance.throughput, (uint64_t)(TaskCount * ReadsPerTask * (BlockSize - 63)));
+    EXPECT_NE(0.f, performance.mbPerSec);
+    EXPECT_EQ(0, wrongCount);
+
+    EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+  }
+
+  udWorkerPool_Destroy(&pPool);
+  udFree(pData);
+  EXPECT_EQ(udR_Success, udFileDelete(pFilename));
+}
+
+TEST(udFileTests, PipelinedReadLocal)
+{
+  const char *pFilename = "._donotcommit_PipelinedTest";
+  const size_t BlockSize = 1000;
+  const size_t BlockCount = 64;
+
+  uint8_t *pData = udAllocType(uint8_t, BlockSize * BlockCount, udAF_None);
+  ASSERT_NE(nullptr, pData);
+  for (size_t i = 0; i < BlockSize * BlockCount; ++i)
+    pData[i] = (uint8_t)(i * 13 + (i >> 8));
+  ASSERT_EQ(udR_Success, udFile_Save(pFilename, pData, BlockSize * BlockCount));
+
+  uint8_t *pBuffer = udAllocType(uint8_t, BlockSize * BlockCount, udAF_Zero);
+  ASSERT_NE(nullptr, pBuffer);
+  udFilePipelinedRequest requests[BlockCount + 1];
+  udFile *pFile = nullptr;
+  size_t actualRead = 0;
+  int64_t filePos = 0;
+  uint8_t pastEnd[16];
+
+  EXPECT_EQ(udR_InvalidParameter_, udFile_ConfigureAsyncReads(0));
+  EXPECT_EQ(udR_InvalidParameter_, udFile_ConfigureAsyncReads(256));
+  EXPECT_EQ(udR_Success, udFile_ConfigureAsyncReads(3)); // Fewer threads than outstanding reads
+
+  ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Read | udFOF_Multithread));
+  EXPECT_NE(nullptr, pFile->fpBlockPipedRequest);
+
+  // Issue everything back to front so the reads are all outstanding together, then receive them in a different order
+  for (size_t i = 0; i < BlockCount; ++i)
+  {
+    size_t block = BlockCount - 1 - i;
+    EXPECT_EQ(udR_Success, udFile_Read(pFile, pBuffer + block * BlockSize, BlockSize, block * BlockSize, udFSW_SeekSet, &actualRead, &filePos, &requests[block]));
+    EXPECT_EQ((int64_t)((block + 1) * BlockSize), filePos);
+  }
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, pastEnd, sizeof(pastEnd), 8, udFSW_SeekEnd, &actualRead, nullptr, &requests[BlockCount]));
+
+  for (size_t i = 0; i < BlockCount; i += 2)
+  {
+    EXPECT_EQ(udR_Success, udFile_BlockForPipelinedRequest(pFile, &requests[i], &actualRead));
+    EXPECT_EQ(BlockSize, actualRead);
+  }
+  EXPECT_EQ(udR_Success, udFile_BlockForPipelinedRequest(pFile, &requests[BlockCount], &actualRead));
+  EXPECT_EQ(0u, actualRead);
+  for (size_t i = 1; i < BlockCount; i += 2)
+  {
+    EXPECT_EQ(udR_Success, udFile_BlockForPipelinedRequest(pFile, &requests[i], &actualRead));
+    EXPECT_EQ(BlockSize, actualRead);
+  }
+  EXPECT_EQ(0, memcmp(pBuffer, pData, BlockSize * BlockCount));
+
+  udFilePerformance performance;
+  EXPECT_EQ(udR_Success, udFile_GetPerformance(pFile, &performance));
+  EXPECT_EQ(0, performance.requestsInFlight);
+  EXPECT_EQ((uint64_t)(BlockSize * BlockCount), performance.throughput);
+
+  EXPECT_EQ(udR_NotAllowed, udFile_ConfigureAsyncReads(8)); // The pool is in use
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+  EXPECT_EQ(udR_Success, udFile_ConfigureAsyncReads(8));
+
+  udFree(pBuffer);
+  udFree(pData);
+  EXPECT_EQ(udR_Success, udFileDelete(pFilename));
+}
+
+TEST(udFileTests, ReadV)
+{
+  const char *pFilename = "._donotcommit_ReadVTest";
+  const size_t Length = 10000;
+
+  uint8_t *pData = udAllocType(uint8_t, Length, udAF_None);
+  ASSERT_NE(nullptr, pData);
+  for (size_t i = 0; i < Length; ++i)
+    pData[i] = (uint8_t)(i * 31 + (i >> 8));
+  ASSERT_EQ(udR_Success, udFile_Save(pFilename, pData, Length));
+
+  // Generic implementation through FILE, and the pread handler's own
+  const udFileOpenFlags openFlags[] = { udFOF_Read, udFOF_Read | udFOF_Multithread };
+  for (size_t h = 0; h < UDARRAYSIZE(openFlags); ++h)
+  {
+    udFile *pFile = nullptr;
+    uint8_t contiguous[300] = {};
+    uint8_t separate[3][50] = {};
+    uint8_t scattered[2][40] = {};
+    uint8_t pastEnd[64] = {};
+    size_t pastEndRead = 0;
+    size_t scatteredRead = 0;
+    int64_t filePos = 0;
+
+    ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, openFlags[h]));
+
+    const udFileReadRequest requests[] = {
+      { contiguous, 100, 1000, nullptr },            // Adjacent in the file and in memory
+      { contiguous + 100, 200, 1100, nullptr },
+      { separate[0], 50, 5000, nullptr },            // Adjacent in the file, not in memory
+      { separate[1], 50, 5050, nullptr },
+      { separate[2], 50, 5100, nullptr },
+      { scattered[0], 40, 8000, &scatteredRead },
+      { scattered[1], 40, 20, nullptr },             // Going backwards
+      { pastEnd, sizeof(pastEnd), Length - 10, &pastEndRead },
+    };
+    EXPECT_EQ(udR_Success, udFile_ReadV(pFile, requests, UDARRAYSIZE(requests)));
+    EXPECT_EQ(0, memcmp(contiguous, pData + 1000, sizeof(contiguous)));
+    for (int i = 0; i < 3; ++i)
+      EXPECT_EQ(0, memcmp(separate[i], pData + 5000 + i * 50, 50));
+    EXPECT_EQ(0, memcmp(scattered[0], pData + 8000, 40));
+    EXPECT_EQ(0, memcmp(scattered[1], pData + 20, 40));
+    EXPECT_EQ(40u, scatteredRead);
+    EXPECT_EQ(10u, pastEndRead);
+    EXPECT_EQ(0, memcmp(pastEnd, pData + Length - 10, 10));
+
+    // File position is after the last request
+    EXPECT_EQ(udR_Success, udFile_Read(pFile, nullptr, 0, 0, udFSW_SeekCur, nullptr, &filePos));
+    EXPECT_EQ((int64_t)Length, filePos);
+
+    // Reading short without checking is an error, as with udFile_Read
+    const udFileReadRequest shortRequest = { pastEnd, sizeof(pastEnd), Length - 10, nullptr };
+    EXPECT_EQ(udR_ReadFailure, udFile_ReadV(pFile, &shortRequest, 1));
+    EXPECT_EQ(udR_Success, udFile_ReadV(pFile, nullptr, 0));
+    EXPECT_EQ(udR_InvalidParameter_, udFile_ReadV(pFile, nullptr, 1));
+
+    // Offsets are relative to the seek base
+    udFile_SetSeekBase(pFile, 1000);
+    EXPECT_EQ(udR_Success, udFile_ReadV(pFile, requests, 2));
+    EXPECT_EQ(0, memcmp(contiguous, pData + 2000, sizeof(contiguous)));
+
+    udFilePerformance performance;
+    EXPECT_EQ(udR_Success, udFile_GetPerformance(pFile, &performance));
+    EXPECT_EQ(0, performance.requestsInFlight);
+
+    EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+  }
+
+  udFree(pData);
+  EXPECT_EQ(udR_Success, udFileDelete(pFilename));
+}
+
+TEST(udFileTests, BlockCache)
+{
+  const char *pFilename = "._donotcommit_CacheTest";
+  const size_t BlockSize = 4096;
+  const size_t Length = 100000; // Not a multiple of the block size
+
+  uint8_t *pData = udAllocType(uint8_t, Length, udAF_None);
+  ASSERT_NE(nullptr, pData);
+  for (size_t i = 0; i < Length; ++i)
+    pData[i] = (uint8_t)(i * 17 + (i >> 9));
+  ASSERT_EQ(udR_Success, udFile_Save(pFilename, pData, Length));
+
+  udFile *pFileA = nullptr;
+  udFile *pFileB = nullptr;
+  udFilePerformance performance;
+  uint8_t buffer[10000];
+  size_t actualRead = 0;
+
+  // Without the cache configured the flag is ignored
+  ASSERT_EQ(udR_Success, udFile_Open(&pFileA, pFilename, udFOF_Read | udFOF_Cache));
+  EXPECT_EQ(udR_Success, udFile_Read(pFileA, buffer, 100, 0, udFSW_SeekSet));
+  EXPECT_EQ(udR_Success, udFile_GetPerformance(pFileA, &performance));
+  EXPECT_EQ(0u, performance.cacheHits + performance.cacheMisses);
+  EXPECT_EQ(udR_Success, udFile_Close(&pFileA));
+
+  EXPECT_EQ(udR_InvalidParameter_, udFile_ConfigureCache(0, 65536));
+  ASSERT_EQ(udR_Success, udFile_ConfigureCache(BlockSize, 65536));
+
+  ASSERT_EQ(udR_Success, udFile_Open(&pFileA, pFilename, udFOF_Read | udFOF_Cache));
+  ASSERT_EQ(udR_Success, udFile_Open(&pFileB, pFilename, udFOF_Read | udFOF_Multithread | udFOF_Cache));
+  EXPECT_EQ(udR_NotAllowed, udFile_ConfigureCache(BlockSize, 0));
+
+  // Straddles 3 blocks, all missing
+  EXPECT_EQ(udR_Success, udFile_Read(pFileA, buffer, 5000, 4000, udFSW_SeekSet));
+  EXPECT_EQ(0, memcmp(buffer, pData + 4000, 5000));
+  EXPECT_EQ(udR_Success, udFile_GetPerformance(pFileA, &performance));
+  EXPECT_EQ(0u, performance.cacheHits);
+  EXPECT_EQ(3u, performance.cacheMisses);
+
+  // The other handle shares the blocks, and the seek base doesn't matter
+  udFile_SetSeekBase(pFileB, 1000);
+  EXPECT_EQ(udR_Success, udFile_Read(pFileB, buffer, 9000, 3100, udFSW_SeekSet));
+  EXPECT_EQ(0, memcmp(buffer, pData + 4100, 9000));
+  EXPECT_EQ(udR_Success, udFile_GetPerformance(pFileB, &performance));
+  EXPECT_EQ(2u, performance.cacheHits);
+  EXPECT_EQ(1u, performance.cacheMisses);
+  udFile_SetSeekBase(pFileB, 0);
+
+  // The end of the file
+  EXPECT_EQ(udR_Success, udFile_Read(pFileA, buffer, sizeof(buffer), Length - 500, udFSW_SeekSet, &actualRead));
+  EXPECT_EQ(500u, actualRead);
+  EXPECT_EQ(0, memcmp(buffer, pData + Length - 500, 500));
+  EXPECT_EQ(udR_Success, udFile_Read(pFileB, buffer, sizeof(buffer), Length - 100, udFSW_SeekSet, &actualRead));
+  EXPECT_EQ(100u, actualRead);
+  EXPECT_EQ(udR_Success, udFile_Read(pFileB, buffer, 10, Length + 10, udFSW_SeekSet, &actualRead));
+  EXPECT_EQ(0u, actualRead);
+
+  // Reading the whole file is more than the budget, so the first blocks are evicted
+  for (size_t offset = 0; offset < Length; offset += sizeof(buffer))
+  {
+    EXPECT_EQ(udR_Success, udFile_Read(pFileA, buffer, sizeof(buffer), offset, udFSW_SeekSet, &actualRead));
+    EXPECT_EQ(0, memcmp(buffer, pData + offset, actualRead));
+  }
+  udFilePerformance before, after;
+  EXPECT_EQ(udR_Success, udFile_GetPerformance(pFileA, &before));
+  EXPECT_EQ(udR_Success, udFile_Read(pFileA, buffer, 100, 0, udFSW_SeekSet));
+  EXPECT_EQ(udR_Success, udFile_Read(pFileA, buffer, 100, Length - 100, udFSW_SeekSet));
+  EXPECT_EQ(udR_Success, udFile_GetPerformance(pFileA, &after));
+  EXPECT_EQ(before.cacheMisses + 1, after.cacheMisses);
+  EXPECT_EQ(before.cacheHits + 1, after.cacheHits);
+
+  // Batched reads go through the cache too
+  uint8_t batch[2][300];
+  const udFileReadRequest requests[] = { { batch[0], 300, 50000, nullptr }, { batch[1], 300, 50300, nullptr } };
+  EXPECT_EQ(udR_Success, udFile_ReadV(pFileB, requests, 2));
+  EXPECT_EQ(0, memcmp(batch, pData + 50000, 600));
+
+  EXPECT_EQ(udR_Success, udFile_Close(&pFileA));
+  EXPECT_EQ(udR_Success, udFile_Close(&pFileB));
+  EXPECT_EQ(udR_Success, udFile_ConfigureCache(BlockSize, 0));
+
+  udFree(pData);
+  EXPECT_EQ(udR_Success, udFileDelete(pFilename));
+}
+
+TEST(udFileTests, BlockCacheReadAhead)
+{
+  const char *pFilename = "._donotcommit_ReadAheadTest";
+  const size_t BlockSize = 4096;
+  const size_t BlockCount = 64;
+  const size_t Length = BlockSize * BlockCount - 1000;
+
+  uint8_t *pData = udAllocType(uint8_t, Length, udAF_None);
+  ASSERT_NE(nullptr, pData);
+  for (size_t i = 0; i < Length; ++i)
+    pData[i] = (uint8_t)(i * 29 + (i >> 10));
+  ASSERT_EQ(udR_Success, udFile_Save(pFilename, pData, Length));
+  ASSERT_EQ(udR_Success, udFile_ConfigureCache(BlockSize, 1024 * 1024));
+
+  // Background read-ahead for multithread files, otherwise reads from the handler are made larger
+  const udFileOpenFlags openFlags[] = { udFOF_Read | udFOF_Cache | udFOF_Multithread, udFOF_Read | udFOF_Cache };
+  for (size_t h = 0; h < UDARRAYSIZE(openFlags); ++h)
+  {
+    udFile *pFile = nullptr;
+    udFilePerformance performance;
+    uint8_t buffer[BlockSize];
+    size_t actualRead = 0;
+    size_t totalRead = 0;
+
+    ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, openFlags[h]));
+    do
+    {
+      EXPECT_EQ(udR_Success, udFile_Read(pFile, buffer, sizeof(buffer), 0, udFSW_SeekCur, &actualRead));
+      EXPECT_EQ(0, memcmp(buffer, pData + totalRead, actualRead));
+      totalRead += actualRead;
+    } while (actualRead == sizeof(buffer));
+    EXPECT_EQ(Length, totalRead);
+
+    EXPECT_EQ(udR_Success, udFile_GetPerformance(pFile, &performance));
+    EXPECT_EQ(0, performance.requestsInFlight);
+    EXPECT_GT(performance.cacheHits, BlockCount / 2); // Most reads found their block had already been read ahead
+    if (h == 0)
+    {
+      EXPECT_LT(performance.cacheMisses, BlockCount / 2); // Blocks read in the background aren't counted as misses
+    }
+    EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+  }
+
+  // Random access doesn't read ahead
+  udFile *pFile = nullptr;
+  udFilePerformance performance;
+  uint8_t buffer[100];
+  ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Read | udFOF_Cache | udFOF_Multithread));
+  for (size_t i = 0; i < 8; ++i)
+  {
+    size_t offset = ((i * 37) % BlockCount) * BlockSize + 50;
+    EXPECT_EQ(udR_Success, udFile_Read(pFile, buffer, sizeof(buffer), offset, udFSW_SeekSet));
+    EXPECT_EQ(0, memcmp(buffer, pData + offset, sizeof(buffer)));
+  }
+  EXPECT_EQ(udR_Success, udFile_GetPerformance(pFile, &performance));
+  EXPECT_EQ(8u, performance.cacheMisses);
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+
+  EXPECT_EQ(udR_Success, udFile_ConfigureCache(BlockSize, 0));
+  udFree(pData);
+  EXPECT_EQ(udR_Success, udFileDelete(pFilename));
+}
+
 TEST(udFileTests, EncryptedReadWriteFILE)
 {
   udCrypto_Init();
@@ -153,6 +571,444 @@ TEST(udFileTests, EncryptedReadWriteFILE)
   udCrypto_Deinit();
 }
 
+TEST(udFileTests, EncryptedParallelRead)
+{
+  udCrypto_Init();
+
+  const char *pFilename = "._donotcommit_EncryptedParallelTest";
+  const size_t FileSize = 4 * 1024 * 1024 + 11; // Not a whole number of cipher blocks
+  const size_t AlignedSize = (FileSize + 15) & ~(size_t)15; // Encrypt needs whole blocks
+  uint8_t *pPlainText = udAllocType(uint8_t, AlignedSize, udAF_Zero);
+  uint8_t *pCipherText = udAllocType(uint8_t, AlignedSize, udAF_None);
+  uint8_t *pReadBuffer = udAllocType(uint8_t, FileSize, udAF_None);
+  ASSERT_NE(nullptr, pPlainText);
+  ASSERT_NE(nullptr, pCipherText);
+  ASSERT_NE(nullptr, pReadBuffer);
+  for (size_t i = 0; i < FileSize; ++i)
+    pPlainText[i] = (uint8_t)(i * 7 + (i >> 12));
+
+  uint8_t *pKey = nullptr;
+  size_t keyLen = 0;
+  const char *pKeyBase64 = nullptr;
+  ASSERT_EQ(udR_Success, udCryptoKey_DeriveFromRandom(&pKeyBase64, udCCKL_AES256KeyLength));
+  EXPECT_EQ(udR_Success, udBase64Decode(&pKey, &keyLen, pKeyBase64));
+
+  udCryptoCipherContext *pCipherCtx = nullptr;
+  udCryptoIV iv;
+  EXPECT_EQ(udR_Success, udCryptoCipher_Create(&pCipherCtx, udCC_AES256, udCPM_None, pKeyBase64, udCCM_CTR));
+  EXPECT_EQ(udR_Success, udCrypto_CreateIVForCTRMode(pCipherCtx, &iv, 12, 0));
+  EXPECT_EQ(udR_Success, udCryptoCipher_Encrypt(pCipherCtx, &iv, pPlainText, AlignedSize, pCipherText, AlignedSize));
+  EXPECT_EQ(udR_Success, udCryptoCipher_Destroy(&pCipherCtx));
+  EXPECT_EQ(udR_Success, udFile_Save(pFilename, pCipherText, FileSize));
+
+  udWorkerPool *pPool = nullptr;
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udFileDecryptTest"));
+
+  // Unaligned starts and ends, reads inside a single block, and reads running past the end of the file
+  const struct { int64_t offset; size_t length; } reads[] = {
+    { 0, FileSize }, { 3, 5 }, { 7, 3 * 1024 * 1024 + 9 }, { 16, 32 }, { 17, 15 }, { 1000001, 2000003 }, { (int64_t)FileSize - 20, 40 },
+  };
+
+  for (int usePool = 0; usePool < 2; ++usePool)
+  {
+    udFile_SetWorkerPool(usePool ? pPool : nullptr);
+
+    udFile *pFile = nullptr;
+    ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Read));
+    EXPECT_EQ(udR_Success, udFile_SetEncryption(pFile, pKey, (int)keyLen, 12));
+    for (size_t r = 0; r < UDARRAYSIZE(reads); ++r)
+    {
+      size_t actualRead = 0;
+      size_t expectedRead = udMin(reads[r].length, FileSize - (size_t)reads[r].offset);
+      memset(pReadBuffer, 0, FileSize);
+      EXPECT_EQ(udR_Success, udFile_Read(pFile, pReadBuffer, udMin(reads[r].length, FileSize), reads[r].offset, udFSW_SeekSet, &actualRead));
+      EXPECT_EQ(expectedRead, actualRead);
+      EXPECT_EQ(0, memcmp(pReadBuffer, pPlainText + reads[r].offset, expectedRead)) << "Read " << r << (usePool ? " with pool" : " without pool");
+    }
+    EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+  }
+
+  udFile_SetWorkerPool(nullptr);
+  udWorkerPool_Destroy(&pPool);
+  udFree(pKey);
+  udFree(pKeyBase64);
+  udFree(pPlainText);
+  udFree(pCipherText);
+  udFree(pReadBuffer);
+  EXPECT_EQ(udR_Success, udFileDelete(pFilename));
+
+  udCrypto_Deinit();
+}
+
+TEST(udFileTests, EncryptedPipelinedRead)
+{
+  udCrypto_Init();
+
+  const char *pFilename = "._donotcommit_EncryptedPipelinedTest";
+  const size_t FileSize = 256 * 1024 + 5;
+  const size_t AlignedSize = (FileSize + 15) & ~(size_t)15; // Encrypt needs whole blocks
+  uint8_t *pPlainText = udAllocType(uint8_t, AlignedSize, udAF_Zero);
+  uint8_t *pCipherText = udAllocType(uint8_t, AlignedSize, udAF_None);
+  ASSERT_NE(nullptr, pPlainText);
+  ASSERT_NE(nullptr, pCipherText);
+  for (size_t i = 0; i < FileSize; ++i)
+    pPlainText[i] = (uint8_t)(i * 13 + (i >> 8));
+
+  uint8_t *pKey = nullptr;
+  size_t keyLen = 0;
+  const char *pKeyBase64 = nullptr;
+  ASSERT_EQ(udR_Success, udCryptoKey_DeriveFromRandom(&pKeyBase64, udCCKL_AES128KeyLength));
+  EXPECT_EQ(udR_Success, udBase64Decode(&pKey, &keyLen, pKeyBase64));
+
+  udCryptoCipherContext *pCipherCtx = nullptr;
+  udCryptoIV iv;
+  EXPECT_EQ(udR_Success, udCryptoCipher_Create(&pCipherCtx, udCC_AES128, udCPM_None, pKeyBase64, udCCM_CTR));
+  EXPECT_EQ(udR_Success, udCrypto_CreateIVForCTRMode(pCipherCtx, &iv, 7, 0));
+  EXPECT_EQ(udR_Success, udCryptoCipher_Encrypt(pCipherCtx, &iv, pPlainText, AlignedSize, pCipherText, AlignedSize));
+  EXPECT_EQ(udR_Success, udCryptoCipher_Destroy(&pCipherCtx));
+  EXPECT_EQ(udR_Success, udFile_Save(pFilename, pCipherText, FileSize));
+
+  // Every request is issued before any is blocked on, and they're received out of order
+  const struct { int64_t offset; size_t length; } reads[] = {
+    { 0, 4096 }, { 5, 11 }, { 4099, 70001 }, { 100000, 16 }, { (int64_t)FileSize - 9, 9 },
+  };
+  uint8_t *pBuffers[UDARRAYSIZE(reads)];
+  udFilePipelinedRequest requests[UDARRAYSIZE(reads)];
+
+  udFile *pFile = nullptr;
+  ASSERT_EQ(udR_Success, udFile_Open(&pFile, pFilename, udFOF_Read | udFOF_Multithread));
+  EXPECT_EQ(udR_Success, udFile_SetEncryption(pFile, pKey, (int)keyLen, 7));
+  for (size_t r = 0; r < UDARRAYSIZE(reads); ++r)
+  {
+    pBuffers[r] = udAllocType(uint8_t, reads[r].length, udAF_Zero);
+    ASSERT_NE(nullptr, pBuffers[r]);
+    EXPECT_EQ(udR_Success, udFile_Read(pFile, pBuffers[r], reads[r].length, reads[r].offset, udFSW_SeekSet, nullptr, nullptr, &requests[r]));
+  }
+  for (size_t i = 0; i < UDARRAYSIZE(reads); ++i)
+  {
+    size_t r = UDARRAYSIZE(reads) - 1 - i;
+    size_t actualRead = 0;
+    EXPECT_EQ(udR_Success, udFile_BlockForPipelinedRequest(pFile, &requests[r], &actualRead));
+    EXPECT_EQ(reads[r].length, actualRead);
+    EXPECT_EQ(0, memcmp(pBuffers[r], pPlainText + reads[r].offset, reads[r].length)) << "Read " << r;
+    udFree(pBuffers[r]);
+  }
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+
+  udFree(pKey);
+  udFree(pKeyBase64);
+  udFree(pPlainText);
+  udFree(pCipherText);
+  EXPECT_EQ(udR_Success, udFileDelete(pFilename));
+
+  udCrypto_Deinit();
+}
+
+#define UDFILETESTS_HTTP_MAX_CLIENTS 32
+#define UDFILETESTS_HTTP_WAIT_MS 5000 // Only reached if the test is failing, so it fails rather than hangs
+
+// A minimal keep-alive HTTP server for ranged GETs, counting connections and the most requests it has been serving at once
+// Requests are held until holdUntil requests have arrived, so the test can make reads overlap without relying on timing
+// Setting closeIdle has it close every connection that isn't in the middle of a request, as servers do after a timeout
+struct udFileTests_HTTPServer
+{
+  udSocket *pListenSocket;
+  udThread *pAcceptThread;
+  udThread *pClientThreads[UDFILETESTS_HTTP_MAX_CLIENTS];
+  udMutex *pMutex; // Guards the members below, pCondition is signalled whenever they change
+  udConditionVariable *pCondition;
+  int32_t connectionCount;
+  int32_t openConnections;
+  int32_t arrivedRequests;
+  int32_t activeRequests;
+  int32_t peakRequests;
+  int32_t holdUntil;
+  bool closeIdle;
+  bool notFound;
+  volatile int32_t stop;
+  const uint8_t *pData;
+  size_t dataLength;
+};
+
+struct udFileTests_HTTPClient
+{
+  udFileTests_HTTPServer *pServer;
+  udSocket *pSocket;
+};
+
+// Wait for the server's state to satisfy predicate, returning false if it doesn't in time
+template <typename Predicate>
+static bool udFileTests_HTTPWaitFor(udFileTests_HTTPServer *pServer, Predicate predicate)
+{
+  uint64_t startTime = udPerfCounterStart();
+  udLockMutex(pServer->pMutex);
+  while (!predicate() && udPerfCounterMilliseconds(startTime) < UDFILETESTS_HTTP_WAIT_MS)
+    udWaitConditionVariable(pServer->pCondition, pServer->pMutex, 100);
+  bool satisfied = predicate();
+  udReleaseMutex(pServer->pMutex);
+  return satisfied;
+}
+
+// Read one of the server's counters under its mutex
+static int32_t udFileTests_HTTPGet(udFileTests_HTTPServer *pServer, const int32_t &value)
+{
+  udLockMutex(pServer->pMutex);
+  int32_t result = value;
+  udReleaseMutex(pServer->pMutex);
+  return result;
+}
+
+// Change the server's state under its mutex and wake anything waiting on it
+template <typename Change>
+static void udFileTests_HTTPUpdate(udFileTests_HTTPServer *pServer, Change change)
+{
+  udLockMutex(pServer->pMutex);
+  change();
+  udSignalConditionVariable(pServer->pCondition, UDFILETESTS_HTTP_MAX_CLIENTS + 1);
+  udReleaseMutex(pServer->pMutex);
+}
+
+static uint32_t udFileTests_HTTPClientThread(void *pUserData)
+{
+  udFileTests_HTTPClient *pClient = (udFileTests_HTTPClient*)pUserData;
+  udFileTests_HTTPServer *pServer = pClient->pServer;
+  char request[1024];
+  size_t received = 0;
+  udSocketSet *pReadSet = nullptr;
+  udSocketSet_Create(&pReadSet);
+
+  for (;;)
+  {
+    size_t headerLength = 0;
+    while (received == 0 || udStrstr(request, received, "\r\n\r\n", &headerLength) == nullptr) // A length of zero would search to a terminator
+    {
+      udSocketSet_EmptySet(pReadSet);
+      udSocketSet_AddSocket(pReadSet, pClient->pSocket);
+      if (udSocketSet_Select(10, pReadSet) <= 0)
+      {
+        udLockMutex(pServer->pMutex);
+        bool closeIdle = pServer->closeIdle;
+        udReleaseMutex(pServer->pMutex);
+        if (received == 0 && closeIdle)
+          break;
+        continue;
+      }
+
+      int64_t actualReceived = 0;
+      if (received == sizeof(request) || udSocket_ReceiveData(pClient->pSocket, (uint8_t*)request + received, (int64_t)(sizeof(request) - received), &actualReceived) != udR_Success || actualReceived == 0)
+        break; // The client closed the connection
+      received += (size_t)actualReceived;
+    }
+    if (headerLength == 0)
+      break;
+    headerLength += 4;
+
+    bool notFound = false;
+    udFileTests_HTTPUpdate(pServer, [pServer, &notFound]() {
+      ++pServer->arrivedRequests;
+      pServer->peakRequests = udMax(pServer->peakRequests, ++pServer->activeRequests);
+      notFound = pServer->notFound;
+    });
+    udFileTests_HTTPWaitFor(pServer, [pServer]() { return pServer->arrivedRequests >= pServer->holdUntil; });
+
+    char response[256];
+    const char *pRange = udStrstr(request, headerLength, "Range: bytes=");
+    if (notFound)
+    {
+      int length = udSprintf(response, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+      udSocket_SendData(pClient->pSocket, (const uint8_t*)response, length);
+    }
+    else if (pRange)
+    {
+      int64_t first = udStrAtoi64(pRange + 13);
+      int64_t last = udMin(udStrAtoi64(udStrchr(pRange, "-") + 1), (int64_t)pServer->dataLength - 1);
+      int length = udSprintf(response, "HTTP/1.1 206 Partial Content\r\nContent-Length: %d\r\n\r\n", (int)(last - first + 1));
+      udSocket_SendData(pClient->pSocket, (const uint8_t*)response, length);
+      udSocket_SendData(pClient->pSocket, pServer->pData + first, last - first + 1);
+    }
+    else
+    {
+      int length = udSprintf(response, "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", (int)pServer->dataLength);
+      udSocket_SendData(pClient->pSocket, (const uint8_t*)response, length);
+    }
+    udFileTests_HTTPUpdate(pServer, [pServer]() { --pServer->activeRequests; });
+
+    received -= headerLength;
+    memmove(request, request + headerLength, received);
+  }
+
+  udSocketSet_Destroy(&pReadSet);
+  udSocket_Close(&pClient->pSocket);
+  udFileTests_HTTPUpdate(pServer, [pServer]() { --pServer->openConnections; });
+  return 0;
+}
+
+static uint32_t udFileTests_HTTPAcceptThread(void *pUserData)
+{
+  udFileTests_HTTPServer *pServer = (udFileTests_HTTPServer*)pUserData;
+  udFileTests_HTTPClient clients[UDFILETESTS_HTTP_MAX_CLIENTS];
+  int32_t clientCount = 0;
+  udSocketSet *pReadSet = nullptr;
+  udSocketSet_Create(&pReadSet);
+
+  while (!pServer->stop && clientCount < UDFILETESTS_HTTP_MAX_CLIENTS)
+  {
+    udSocketSet_EmptySet(pReadSet);
+    udSocketSet_AddSocket(pReadSet, pServer->pListenSocket);
+    if (udSocketSet_Select(10, pReadSet) <= 0)
+      continue;
+
+    udFileTests_HTTPClient *pClient = &clients[clientCount];
+    pClient->pServer = pServer;
+    if (udSocket_ServerAcceptClient(pServer->pListenSocket, &pClient->pSocket))
+    {
+      // Counted before the client thread starts, so a connection is always counted by the time a response arrives on it
+      udFileTests_HTTPUpdate(pServer, [pServer]() { ++pServer->connectionCount; ++pServer->openConnections; });
+      udThread_Create(&pServer->pClientThreads[clientCount++], udFileTests_HTTPClientThread, pClient);
+    }
+  }
+
+  // Connections are closed by the client, so wait for each one to finish
+  for (int32_t i = 0; i < clientCount; ++i)
+  {
+    udThread_Join(pServer->pClientThreads[i]);
+    udThread_Destroy(&pServer->pClientThreads[i]);
+  }
+  udSocketSet_Destroy(&pReadSet);
+
+  return 0;
+}
+
+// Read readCount slices of the file from threadCount threads at once, returning how many reads failed or got the wrong data
+static int32_t udFileTests_HTTPParallelReads(udFile *pFile, const uint8_t *pData, size_t readCount, size_t readLength, uint8_t threadCount)
+{
+  udWorkerPool *pPool = nullptr;
+  volatile int32_t failures = 0;
+
+  if (udWorkerPool_Create(&pPool, threadCount, "udFileHTTPTest") != udR_Success)
+    return (int32_t)readCount;
+
+  for (size_t r = 0; r < readCount; ++r)
+  {
+    if (udWorkerPool_AddTask(pPool, [pFile, pData, r, readLength, &failures](void *) {
+      uint8_t *pBuffer = udAllocType(uint8_t, readLength, udAF_None);
+      size_t actualRead = 0;
+      if (pBuffer == nullptr || udFile_Read(pFile, pBuffer, readLength, (int64_t)(r * readLength), udFSW_SeekSet, &actualRead) != udR_Success || actualRead != readLength || memcmp(pBuffer, pData + r * readLength, readLength) != 0)
+        udInterlockedPreIncrement(&failures);
+      udFree(pBuffer);
+    }, nullptr, false) != udR_Success)
+    {
+      udInterlockedPreIncrement(&failures);
+    }
+  }
+  udWorkerPool_WaitForIdle(pPool, UDTHREAD_WAIT_INFINITE);
+  udWorkerPool_Destroy(&pPool);
+
+  return failures;
+}
+
+TEST(udFileTests, HTTPConnectionPool)
+{
+  const size_t DataLength = 64 * 1024;
+  const int MaxConnections = 3;
+  uint8_t *pData = udAllocType(uint8_t, DataLength, udAF_None);
+  ASSERT_NE(nullptr, pData);
+  for (size_t i = 0; i < DataLength; ++i)
+    pData[i] = (uint8_t)(i * 31 + (i >> 9));
+
+  ASSERT_EQ(udR_Success, udFile_RegisterHTTP());
+  ASSERT_EQ(udR_Success, udSocket_InitSystem());
+  udFileTests_HTTPServer server = {};
+  server.pData = pData;
+  server.dataLength = DataLength;
+  server.pMutex = udCreateMutex();
+  server.pCondition = udCreateConditionVariable();
+  ASSERT_NE(nullptr, server.pMutex);
+  ASSERT_NE(nullptr, server.pCondition);
+
+  // Port zero has the system choose a free one
+  uint32_t port = 0;
+  char url[64];
+  ASSERT_EQ(udR_Success, udSocket_Open(&server.pListenSocket, "127.0.0.1", 0, udSCF_IsServer));
+  ASSERT_EQ(udR_Success, udSocket_GetLocalPort(server.pListenSocket, &port));
+  EXPECT_NE(0u, port);
+  udSprintf(url, "http://127.0.0.1:%d/data", (int)port);
+  ASSERT_EQ(udR_Success, udThread_Create(&server.pAcceptThread, udFileTests_HTTPAcceptThread, &server));
+
+  EXPECT_EQ(udR_InvalidParameter_, udFile_ConfigureHTTPConnections(-1, 1000));
+  EXPECT_EQ(udR_Success, udFile_ConfigureHTTPConnections(MaxConnections, 60000));
+
+  udFile *pFile = nullptr;
+  int64_t fileLength = 0;
+  ASSERT_EQ(udR_Success, udFile_Open(&pFile, url, udFOF_Read | udFOF_Multithread, &fileLength));
+  EXPECT_EQ((int64_t)DataLength, fileLength);
+
+  // Reads from many threads at once each lease a connection, up to the maximum
+  // The first MaxConnections requests are held until they have all arrived, so the pool has to have that many open together
+  const size_t ReadCount = 16;
+  const size_t ReadLength = DataLength / ReadCount;
+  udFileTests_HTTPUpdate(&server, [&server]() { server.holdUntil = server.arrivedRequests + MaxConnections; });
+  EXPECT_EQ(0, udFileTests_HTTPParallelReads(pFile, pData, ReadCount, ReadLength, 8));
+  EXPECT_EQ(MaxConnections, udFileTests_HTTPGet(&server, server.peakRequests));
+  EXPECT_EQ(MaxConnections + 1, udFileTests_HTTPGet(&server, server.connectionCount)); // Plus the file's own connection
+
+  // Connections idle longer than the timeout are replaced
+  int32_t connectionCount = udFileTests_HTTPGet(&server, server.connectionCount);
+  uint8_t buffer[16];
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, buffer, sizeof(buffer), 100, udFSW_SeekSet));
+  EXPECT_EQ(connectionCount, udFileTests_HTTPGet(&server, server.connectionCount));
+  EXPECT_EQ(udR_Success, udFile_ConfigureHTTPConnections(MaxConnections, 1));
+  udSleep(20); // The timeout is measured by the client, any sleep over 1ms expires them
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, buffer, sizeof(buffer), 200, udFSW_SeekSet));
+  EXPECT_EQ(0, memcmp(buffer, pData + 200, sizeof(buffer)));
+  EXPECT_EQ(connectionCount + 1, udFileTests_HTTPGet(&server, server.connectionCount));
+
+  // Once the server has closed the idle connections a read opens a new one rather than trying another closed one
+  EXPECT_EQ(udR_Success, udFile_ConfigureHTTPConnections(MaxConnections, 60000));
+  udFileTests_HTTPUpdate(&server, [&server]() { server.holdUntil = server.arrivedRequests + MaxConnections; });
+  EXPECT_EQ(0, udFileTests_HTTPParallelReads(pFile, pData, MaxConnections, ReadLength, MaxConnections));
+  EXPECT_TRUE(udFileTests_HTTPWaitFor(&server, [&server]() { return server.openConnections == MaxConnections + 1; })); // The pool's idle connections and the file's own, once the expired ones have been seen to close
+
+  udFileTests_HTTPUpdate(&server, [&server]() { server.closeIdle = true; });
+  EXPECT_TRUE(udFileTests_HTTPWaitFor(&server, [&server]() { return server.openConnections == 0; }));
+  udFileTests_HTTPUpdate(&server, [&server]() { server.closeIdle = false; });
+
+  connectionCount = udFileTests_HTTPGet(&server, server.connectionCount);
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, buffer, sizeof(buffer), 400, udFSW_SeekSet));
+  EXPECT_EQ(0, memcmp(buffer, pData + 400, sizeof(buffer)));
+  EXPECT_EQ(connectionCount + 1, udFileTests_HTTPGet(&server, server.connectionCount));
+
+  // The other closed connections were dropped with the first, so the new one is the only one left to reuse
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, buffer, sizeof(buffer), 500, udFSW_SeekSet));
+  EXPECT_EQ(0, memcmp(buffer, pData + 500, sizeof(buffer)));
+  EXPECT_EQ(connectionCount + 1, udFileTests_HTTPGet(&server, server.connectionCount));
+  EXPECT_EQ(1, udFileTests_HTTPGet(&server, server.openConnections));
+
+  // An error response isn't a closed connection, so the request isn't sent again
+  int32_t arrivedRequests = udFileTests_HTTPGet(&server, server.arrivedRequests);
+  udFileTests_HTTPUpdate(&server, [&server]() { server.notFound = true; });
+  EXPECT_NE(udR_Success, udFile_Read(pFile, buffer, sizeof(buffer), 600, udFSW_SeekSet));
+  udFileTests_HTTPUpdate(&server, [&server]() { server.notFound = false; });
+  EXPECT_EQ(arrivedRequests + 1, udFileTests_HTTPGet(&server, server.arrivedRequests));
+
+  // With the pool turned off reads go through the file's own connection, which the server has also closed
+  EXPECT_EQ(udR_Success, udFile_ConfigureHTTPConnections(0, 1000));
+  EXPECT_EQ(udR_Success, udFile_Read(pFile, buffer, sizeof(buffer), 300, udFSW_SeekSet));
+  EXPECT_EQ(0, memcmp(buffer, pData + 300, sizeof(buffer)));
+
+  EXPECT_EQ(udR_Success, udFile_Close(&pFile));
+  EXPECT_EQ(udR_Success, udFile_ConfigureHTTPConnections(6, 4000)); // Back to the defaults
+
+  server.stop = 1;
+  EXPECT_EQ(udR_Success, udThread_Join(server.pAcceptThread));
+  udThread_Destroy(&server.pAcceptThread);
+  udSocket_Close(&server.pListenSocket);
+  udDestroyConditionVariable(&server.pCondition);
+  udDestroyMutex(&server.pMutex);
+  udSocket_DeinitSystem();
+  udFree(pData);
+}
+
 static char s_customFileHandler_buffer[32];
 udResult udFileTests_CustomFileHandler_Open(udFile **ppFile, const char *pFilename, udFileOpenFlags /*flags*/)
 {
@@ -0,0 +1,121 @@
+#include "gtest/gtest.h"
+
+#include "udParallel.h"
+#include "udPlatformUtil.h"
+#include "udThread.h"
+
+TEST(udParallelTests, For)
+{
+  udWorkerPool *pPool = nullptr;
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udParallelForTest"));
+
+  const size_t Count = 100000;
+  uint8_t *pVisited = udAllocType(uint8_t, Count, udAF_Zero);
+  ASSERT_NE(nullptr, pVisited);
+
+  udCallback<void(size_t, size_t)> markFunc = [pVisited](size_t startIndex, size_t endIndex)
+  {
+    for (size_t i = startIndex; i < endIndex; ++i)
+      ++pVisited[i];
+  };
+
+  EXPECT_EQ(udR_InvalidParameter_, udParallelFor(pPool, 10, 5, 1, markFunc));
+  EXPECT_EQ(udR_Success, udParallelFor(pPool, 0, 0, 1, markFunc));
+
+  // Every index is visited exactly once, regardless of grain size, offset range or pool
+  EXPECT_EQ(udR_Success, udParallelFor(pPool, 0, Count, 0, markFunc));
+  EXPECT_EQ(udR_Success, udParallelFor(pPool, 7, Count - 3, 64, markFunc));
+  EXPECT_EQ(udR_Success, udParallelFor(pPool, 0, Count, Count * 2, markFunc));
+  EXPECT_EQ(udR_Success, udParallelFor(nullptr, 0, Count, 100, markFunc));
+
+  size_t wrongCount = 0;
+  for (size_t i = 0; i < Count; ++i)
+    wrongCount += (pVisited[i] != ((i >= 7 && i < Count - 3) ? 4 : 3));
+  EXPECT_EQ(0u, wrongCount);
+
+  // Grains other than at the ends of the range start on multiples of the grain size
+  volatile int32_t misaligned = 0;
+  udParallelRangeCallback alignFunc = [&misaligned](size_t startIndex, size_t endIndex, uint32_t participant)
+  {
+    if ((startIndex != 7 && startIndex % 64 != 0) || (endIndex != Count && endIndex % 64 != 0) || participant > 4)
+      udInterlockedPreIncrement(&misaligned);
+  };
+  EXPECT_EQ(udR_Success, udParallel_Run(pPool, 7, Count, 64, alignFunc));
+  EXPECT_EQ(0, misaligned);
+
+  udFree(pVisited);
+  udWorkerPool_Destroy(&pPool);
+}
+
+TEST(udParallelTests, ChunkedArray)
+{
+  udWorkerPool *pPool = nullptr;
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udParallelChunkedTest"));
+
+  udChunkedArray<uint32_t> array;
+  ASSERT_EQ(udR_Success, array.Init(64));
+  for (uint32_t i = 0; i < 10000; ++i)
+    array.PushBack(i);
+  array.PopFront(); // Leave an inset so runs don't line up with the indices
+  array.PopFront();
+
+  volatile int32_t badRuns = 0;
+  udCallback<void(uint32_t *, size_t, size_t)> doubleFunc = [&array, &badRuns](uint32_t *pElements, size_t startIndex, size_t count)
+  {
+    if (pElements != array.GetElement(startIndex) || count > array.GetElementRunLength(startIndex))
+      udInterlockedPreIncrement(&badRuns);
+    for (size_t i = 0; i < count; ++i)
+      pElements[i] *= 2;
+  };
+  EXPECT_EQ(udR_Success, udParallelFor(pPool, array, 1, doubleFunc));
+  EXPECT_EQ(0, badRuns);
+
+  size_t wrongCount = 0;
+  for (size_t i = 0; i < array.length; ++i)
+    wrongCount += (array[i] != (i + 2) * 2);
+  EXPECT_EQ(0u, wrongCount);
+
+  array.Deinit();
+  udWorkerPool_Destroy(&pPool);
+}
+
+TEST(udParallelTests, Reduce)
+{
+  udWorkerPool *pPool = nullptr;
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udParallelReduceTest"));
+
+  udCallback<uint64_t(size_t, size_t, uint64_t)> sumFunc = [](size_t startIndex, size_t endIndex, uint64_t partial)
+  {
+    for (size_t i = startIndex; i < endIndex; ++i)
+      partial += i;
+    return partial;
+  };
+  udCallback<uint64_t(uint64_t, uint64_t)> addFunc = [](uint64_t a, uint64_t b) { return a + b; };
+
+  const uint64_t Count = 1000000;
+  uint64_t sum = 0;
+  EXPECT_EQ(udR_InvalidParameter_, udParallelReduce<uint64_t>(pPool, 0, Count, 0, 0, sumFunc, addFunc, nullptr));
+  EXPECT_EQ(udR_Success, udParallelReduce<uint64_t>(pPool, 0, Count, 0, 0, sumFunc, addFunc, &sum));
+  EXPECT_EQ(Count * (Count - 1) / 2, sum);
+
+  EXPECT_EQ(udR_Success, udParallelReduce<uint64_t>(nullptr, 0, Count, 0, 0, sumFunc, addFunc, &sum));
+  EXPECT_EQ(Count * (Count - 1) / 2, sum);
+
+  // Works from inside a worker as the calling thread takes part
+  udSemaphore *pDone = udCreateSemaphore();
+  uint64_t nestedSums[4] = {};
+  udWorkerPoolCallback nestedFunc = [pPool, &sumFunc, &addFunc, pDone](void *pSum)
+  {
+    udParallelReduce<uint64_t>(pPool, 0, Count, 0, 0, sumFunc, addFunc, (uint64_t*)pSum);
+    udIncrementSemaphore(pDone);
+  };
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, nestedFunc, &nestedSums[i], false));
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(0, udWaitSemaphore(pDone));
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(Count * (Count - 1) / 2, nestedSums[i]);
+
+  udDestroySemaphore(&pDone);
+  udWorkerPool_Destroy(&pPool);
+}
@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "udSafeDeque.h"
+#include "udThread.h"
 
 TEST(udSafeDequeTests, ValidationTests)
 {
@@ -44,3 +45,113 @@ TEST(udSafeDequeTests, ValidationTests)
   udSafeDeque_Destroy(&pQueue);
   udSafeDeque_Destroy((udSafeDeque<int> **)nullptr);
 }
+
+TEST(udSafeDequeTests, RangeTests)
+{
+  udSafeDeque<int> *pQueue = nullptr;
+  int values[100];
+  int results[100] = {};
+  size_t poppedCount = 0;
+
+  for (int i = 0; i < 100; ++i)
+    values[i] = i;
+
+  EXPECT_EQ(udR_InvalidParameter_, udSafeDeque_PushBackRange(pQueue, values, 10));
+  EXPECT_EQ(udR_InvalidParameter_, udSafeDeque_PopFrontRange(pQueue, results, 10, &poppedCount));
+
+  EXPECT_EQ(udR_Success, udSafeDeque_Create(&pQueue, 8)); // Small chunks so ranges span several
+  ASSERT_NE(nullptr, pQueue);
+
+  EXPECT_EQ(udR_ObjectNotFound, udSafeDeque_PopFrontRange(pQueue, results, 10, &poppedCount));
+  EXPECT_EQ(0u, poppedCount);
+
+  // Mixed with single element operations so the range doesn't start on a chunk boundary
+  EXPECT_EQ(udR_Success, udSafeDeque_PushBack(pQueue, -1));
+  EXPECT_EQ(udR_Success, udSafeDeque_PushBack(pQueue, -2));
+  EXPECT_EQ(udR_Success, udSafeDeque_PopFront(pQueue, &results[0]));
+  EXPECT_EQ(-1, results[0]);
+
+  EXPECT_EQ(udR_Success, udSafeDeque_PushBackRange(pQueue, values, 0));
+  EXPECT_EQ(udR_Success, udSafeDeque_PushBackRange(pQueue, values, 50));
+  EXPECT_EQ(udR_Success, udSafeDeque_PushBackRange(pQueue, values + 50, 50));
+  EXPECT_EQ(101u, pQueue->chunkedArray.length);
+
+  EXPECT_EQ(udR_Success, udSafeDeque_PopFrontRange(pQueue, results, 1, &poppedCount));
+  EXPECT_EQ(1u, poppedCount);
+  EXPECT_EQ(-2, results[0]);
+
+  EXPECT_EQ(udR_Success, udSafeDeque_PopFrontRange(pQueue, results, 37, &poppedCount));
+  EXPECT_EQ(37u, poppedCount);
+  EXPECT_EQ(udR_Success, udSafeDeque_PopFrontRange(pQueue, results + 37, 100, &poppedCount));
+  EXPECT_EQ(63u, poppedCount);
+
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(i, results[i]);
+
+  EXPECT_EQ(udR_ObjectNotFound, udSafeDeque_PopFrontRange(pQueue, results, 100, &poppedCount));
+
+  // Emptied chunks were recycled rather than leaked, so the same amount again needs no new chunks
+  size_t chunkCount = pQueue->chunkedArray.chunkCount;
+  EXPECT_EQ(udR_Success, udSafeDeque_PushBackRange(pQueue, values, 100));
+  EXPECT_EQ(chunkCount, pQueue->chunkedArray.chunkCount);
+  EXPECT_EQ(udR_Success, udSafeDeque_PopFrontRange(pQueue, results, 100, &poppedCount));
+  EXPECT_EQ(100u, poppedCount);
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(i, results[i]);
+
+  udSafeDeque_Destroy(&pQueue);
+}
+
+TEST(udSafeDequeTests, WaitAndClose)
+{
+  udSafeDeque<int> *pQueue = nullptr;
+  int result = -1;
+
+  EXPECT_EQ(udR_InvalidParameter_, udSafeDeque_PopFrontWait(pQueue, &result, 0));
+  EXPECT_EQ(udR_InvalidParameter_, udSafeDeque_Close(pQueue));
+
+  EXPECT_EQ(udR_Success, udSafeDeque_Create(&pQueue, 32));
+  ASSERT_NE(nullptr, pQueue);
+
+  EXPECT_EQ(udR_Timeout, udSafeDeque_PopFrontWait(pQueue, &result, 0));
+  EXPECT_EQ(udR_Timeout, udSafeDeque_PopFrontWait(pQueue, &result, 10));
+
+  EXPECT_EQ(udR_Success, udSafeDeque_PushBack(pQueue, 5));
+  EXPECT_EQ(udR_Success, udSafeDeque_PopFrontWait(pQueue, &result, 0));
+  EXPECT_EQ(5, result);
+
+  // Consumers parked on the deque wake for pushes from another thread, and again when it's closed
+  udThreadStart consumerFunc = [](void *pUserData) -> uint32_t
+  {
+    udSafeDeque<int> *pDeque = (udSafeDeque<int>*)pUserData;
+    int value;
+
+    while (udSafeDeque_PopFrontWait(pDeque, &value, UDTHREAD_WAIT_INFINITE) == udR_Success)
+      udYield(); // Give the other consumers a turn
+
+    return 0;
+  };
+
+  udThread *pThreads[4] = {};
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(udR_Success, udThread_Create(&pThreads[i], consumerFunc, pQueue));
+
+  for (int i = 1; i <= 100; ++i)
+    EXPECT_EQ(udR_Success, udSafeDeque_PushBack(pQueue, i));
+
+  EXPECT_EQ(udR_Success, udSafeDeque_Close(pQueue));
+  EXPECT_EQ(udR_NotAllowed, udSafeDeque_PushBack(pQueue, 1));
+  EXPECT_EQ(udR_NotAllowed, udSafeDeque_PushFront(pQueue, 1));
+
+  for (int i = 0; i < 4; ++i)
+  {
+    EXPECT_EQ(udR_Success, udThread_Join(pThreads[i]));
+    udThread_Destroy(&pThreads[i]);
+  }
+
+  // Everything pushed before the close was consumed
+  EXPECT_EQ(0u, pQueue->chunkedArray.length);
+  EXPECT_EQ(udR_Cancelled, udSafeDeque_PopFrontWait(pQueue, &result, UDTHREAD_WAIT_INFINITE));
+
+  udSafeDeque_Destroy(&pQueue);
+}
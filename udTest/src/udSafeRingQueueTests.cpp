@@ -0,0 +1,156 @@
+#include "gtest/gtest.h"
+#include "udSafeRingQueue.h"
+#include "udThread.h"
+
+TEST(udSafeRingQueueTests, ValidationTests)
+{
+  udSafeRingQueue<int> *pQueue = nullptr;
+  int result = -1;
+
+  EXPECT_EQ(udR_InvalidParameter_, udSafeRingQueue_Create(&pQueue, 0));
+  EXPECT_EQ(udR_InvalidParameter_, udSafeRingQueue_Create((udSafeRingQueue<int> **)nullptr, 4));
+
+  EXPECT_EQ(udR_Success, udSafeRingQueue_Create(&pQueue, 3)); // Rounded up to 4
+  ASSERT_NE(nullptr, pQueue);
+
+  EXPECT_EQ(udR_ObjectNotFound, udSafeRingQueue_PopFront(pQueue, &result));
+  EXPECT_EQ(-1, result);
+
+  // Wrap around the ring a few times
+  for (int lap = 0; lap < 3; ++lap)
+  {
+    for (int i = 0; i < 4; ++i)
+      EXPECT_EQ(udR_Success, udSafeRingQueue_PushBack(pQueue, lap * 10 + i));
+    EXPECT_EQ(udR_CountExceeded, udSafeRingQueue_PushBack(pQueue, 99));
+    EXPECT_EQ(4u, udSafeRingQueue_Count(pQueue));
+
+    for (int i = 0; i < 4; ++i)
+    {
+      EXPECT_EQ(udR_Success, udSafeRingQueue_PopFront(pQueue, &result));
+      EXPECT_EQ(lap * 10 + i, result);
+    }
+    EXPECT_EQ(udR_ObjectNotFound, udSafeRingQueue_PopFront(pQueue, &result));
+    EXPECT_EQ(0u, udSafeRingQueue_Count(pQueue));
+  }
+
+  udSafeRingQueue_Destroy(&pQueue);
+  EXPECT_EQ(nullptr, pQueue);
+
+  // Additional destruction of non-existent objects
+  udSafeRingQueue_Destroy(&pQueue);
+  udSafeRingQueue_Destroy((udSafeRingQueue<int> **)nullptr);
+}
+
+TEST(udSafeRingQueueTests, PositionWrap)
+{
+  udSafeRingQueue<int> *pQueue = nullptr;
+  int result = -1;
+
+  ASSERT_EQ(udR_Success, udSafeRingQueue_Create(&pQueue, 4));
+
+  // Start just short of the 32-bit wrap, as if ~4 billion elements had already passed through
+  const uint32_t start = UINT32_MAX - 5;
+  pQueue->enqueuePos = start;
+  pQueue->dequeuePos = start;
+  for (uint32_t i = 0; i < 4; ++i)
+    pQueue->pCells[(start + i) & pQueue->mask].sequence = start + i;
+
+  for (int lap = 0; lap < 3; ++lap)
+  {
+    for (int i = 0; i < 4; ++i)
+      EXPECT_EQ(udR_Success, udSafeRingQueue_PushBack(pQueue, lap * 10 + i));
+    EXPECT_EQ(udR_CountExceeded, udSafeRingQueue_PushBack(pQueue, 99));
+    EXPECT_EQ(4u, udSafeRingQueue_Count(pQueue));
+
+    for (int i = 0; i < 4; ++i)
+    {
+      EXPECT_EQ(udR_Success, udSafeRingQueue_PopFront(pQueue, &result));
+      EXPECT_EQ(lap * 10 + i, result);
+    }
+    EXPECT_EQ(udR_ObjectNotFound, udSafeRingQueue_PopFront(pQueue, &result));
+    EXPECT_EQ(0u, udSafeRingQueue_Count(pQueue));
+  }
+  EXPECT_LT(pQueue->enqueuePos, start); // Wrapped
+
+  udSafeRingQueue_Destroy(&pQueue);
+}
+
+struct udSafeRingQueueTestData
+{
+  udSafeRingQueue<uint32_t> *pQueue;
+  volatile int32_t producersRemaining;
+  volatile int32_t popCount;
+  volatile int32_t sums[4];
+};
+
+TEST(udSafeRingQueueTests, MultiProducerMultiConsumer)
+{
+  const int ThreadCount = 4;
+  const uint32_t ItemsPerProducer = 20000;
+
+  udSafeRingQueueTestData data = {};
+  data.producersRemaining = ThreadCount;
+  ASSERT_EQ(udR_Success, udSafeRingQueue_Create(&data.pQueue, 64)); // Small so the producers regularly find it full
+
+  // Each producer pushes its index in the top bits so consumers can check the per-producer totals
+  udThreadStart producerFunc = [](void *pUserData) -> uint32_t
+  {
+    udSafeRingQueueTestData *pData = (udSafeRingQueueTestData*)pUserData;
+    static volatile int32_t nextProducer = 0;
+    uint32_t producer = (uint32_t)udInterlockedPostIncrement(&nextProducer) % ThreadCount;
+
+    for (uint32_t i = 1; i <= ItemsPerProducer; ++i)
+    {
+      while (udSafeRingQueue_PushBack(pData->pQueue, (producer << 24) | i) != udR_Success)
+        udYield();
+    }
+
+    udInterlockedPreDecrement(&pData->producersRemaining);
+    return 0;
+  };
+
+  udThreadStart consumerFunc = [](void *pUserData) -> uint32_t
+  {
+    udSafeRingQueueTestData *pData = (udSafeRingQueueTestData*)pUserData;
+    uint32_t value;
+
+    for (;;)
+    {
+      if (udSafeRingQueue_PopFront(pData->pQueue, &value) == udR_Success)
+      {
+        udInterlockedAdd(&pData->sums[value >> 24], (int32_t)(value & 0xFFFFFF));
+        udInterlockedPreIncrement(&pData->popCount);
+      }
+      else if (pData->producersRemaining == 0 && udSafeRingQueue_Count(pData->pQueue) == 0)
+      {
+        break;
+      }
+      else
+      {
+        udYield();
+      }
+    }
+
+    return 0;
+  };
+
+  udThread *pThreads[ThreadCount * 2] = {};
+  for (int i = 0; i < ThreadCount; ++i)
+  {
+    EXPECT_EQ(udR_Success, udThread_Create(&pThreads[i * 2], producerFunc, &data));
+    EXPECT_EQ(udR_Success, udThread_Create(&pThreads[i * 2 + 1], consumerFunc, &data));
+  }
+
+  for (int i = 0; i < ThreadCount * 2; ++i)
+  {
+    EXPECT_EQ(udR_Success, udThread_Join(pThreads[i]));
+    udThread_Destroy(&pThreads[i]);
+  }
+
+  // Every item came out exactly once
+  EXPECT_EQ((int32_t)(ItemsPerProducer * ThreadCount), data.popCount);
+  for (int i = 0; i < ThreadCount; ++i)
+    EXPECT_EQ((int32_t)(ItemsPerProducer * (ItemsPerProducer + 1) / 2), data.sums[i]);
+
+  udSafeRingQueue_Destroy(&data.pQueue);
+}
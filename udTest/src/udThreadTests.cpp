@@ -1,6 +1,7 @@
 #include "gtest/gtest.h"
 
 #include "udThread.h"
+#include "udPlatformUtil.h"
 
 TEST(udThreadTests, Mutex)
 {
@@ -62,6 +63,75 @@ TEST(udThreadTests, Thread)
   udThread_Destroy(nullptr);
 }
 
+TEST(udThreadTests, Topology)
+{
+  udHardwareTopology topology;
+  int threadCount = udGetHardwareThreadCount(&topology);
+
+  EXPECT_EQ(threadCount, udGetHardwareThreadCount());
+  EXPECT_GE(threadCount, topology.logicalProcessorCount);
+#if UDPLATFORM_LINUX
+  EXPECT_EQ(threadCount, topology.logicalProcessorCount); // Both come from the affinity mask
+#endif
+  EXPECT_GE(topology.logicalProcessorCount, topology.physicalCoreCount);
+  EXPECT_GE(topology.physicalCoreCount, topology.numaNodeCount);
+  EXPECT_GE(topology.numaNodeCount, 1);
+  EXPECT_GE(topology.maxSMTSiblings, 1);
+  EXPECT_LE(topology.logicalProcessorCount, topology.physicalCoreCount * topology.maxSMTSiblings);
+
+  // The first physicalCoreCount processors are all on different cores
+  int *pProcessors = udAllocType(int, topology.logicalProcessorCount, udAF_None);
+  EXPECT_EQ(topology.logicalProcessorCount, udGetHardwareProcessors(pProcessors, topology.logicalProcessorCount));
+  EXPECT_EQ(1, udGetHardwareProcessors(pProcessors, 1));
+  EXPECT_EQ(0, udGetHardwareProcessors(pProcessors, topology.logicalProcessorCount, 1 << 20)); // No such node
+  udFree(pProcessors);
+}
+
+TEST(udThreadTests, Affinity)
+{
+  int processor = -1;
+  ASSERT_EQ(1, udGetHardwareProcessors(&processor, 1));
+
+  int ranOn = -2;
+  udThread *pThread = nullptr;
+  udSemaphore *pPinned = udCreateSemaphore();
+  udSemaphore *pCheck = udCreateSemaphore();
+
+  // The thread waits until it has been pinned before checking where it's running
+  struct AffinityTestData { udSemaphore *pPinned; udSemaphore *pCheck; int *pRanOn; } data = { pPinned, pCheck, &ranOn };
+  udThreadStart startFunc = [](void *pDataPtr) -> unsigned int
+  {
+    AffinityTestData *pData = (AffinityTestData*)pDataPtr;
+    udWaitSemaphore(pData->pPinned);
+#if UDPLATFORM_LINUX
+    *pData->pRanOn = sched_getcpu();
+#endif
+    udIncrementSemaphore(pData->pCheck);
+    return 0;
+  };
+  ASSERT_EQ(udR_Success, udThread_Create(&pThread, startFunc, &data));
+
+  EXPECT_EQ(udR_InvalidParameter_, udThread_SetAffinity(nullptr, &processor, 1));
+  EXPECT_EQ(udR_InvalidParameter_, udThread_SetAffinity(pThread, nullptr, 1));
+  udResult result = udThread_SetAffinity(pThread, &processor, 1);
+  udIncrementSemaphore(pPinned);
+  udWaitSemaphore(pCheck);
+
+#if UDPLATFORM_LINUX || UDPLATFORM_WINDOWS
+  EXPECT_EQ(udR_Success, result);
+# if UDPLATFORM_LINUX
+  EXPECT_EQ(processor, ranOn);
+# endif
+#else
+  EXPECT_EQ(udR_Unsupported, result);
+#endif
+
+  EXPECT_EQ(udR_Success, udThread_Join(pThread));
+  udThread_Destroy(&pThread);
+  udDestroySemaphore(&pPinned);
+  udDestroySemaphore(&pCheck);
+}
+
 TEST(udThreadTests, ThreadConditionVariable)
 {
   struct TestStruct
@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include "udUnrolledArray.h"
+
+TEST(udUnrolledArrayTests, Basic)
+{
+  udUnrolledArray<int> array;
+  EXPECT_EQ(udR_InvalidParameter_, array.Init(1));
+  ASSERT_EQ(udR_Success, array.Init(8));
+  EXPECT_EQ(0, array.GetElementRunLength(0));
+
+  for (int i = 0; i < 32; ++i)
+    EXPECT_EQ(udR_Success, array.PushBack(i));
+  EXPECT_EQ(32, array.length);
+  EXPECT_EQ(4, array.chunkCount); // Pushing on the back fills chunks completely
+  EXPECT_EQ(5, array.GetElementRunLength(11));
+
+  // Inserting into a full chunk splits it, nothing else moves
+  int *pOtherChunk = array.GetElement(20);
+  int value = 100;
+  EXPECT_EQ(udR_Success, array.Insert(3, &value));
+  EXPECT_EQ(5, array.chunkCount);
+  EXPECT_EQ(pOtherChunk, array.GetElement(21));
+  EXPECT_EQ(100, array[3]);
+  EXPECT_EQ(2, array[2]);
+  EXPECT_EQ(3, array[4]);
+  EXPECT_EQ(31, array[32]);
+
+  array.RemoveAt(3);
+  for (int i = 0; i < 32; ++i)
+    EXPECT_EQ(i, array[i]);
+
+  // Emptying a chunk frees it
+  for (int i = 0; i < 8; ++i)
+    array.RemoveAt(24);
+  EXPECT_EQ(24, array.length);
+  EXPECT_EQ(23, array[23]);
+
+  array.Clear();
+  EXPECT_EQ(0, array.length);
+  EXPECT_EQ(0, array.chunkCount);
+  EXPECT_EQ(udR_Success, array.PushBack(5));
+  EXPECT_EQ(5, array[0]);
+
+  array.Deinit();
+}
+
+TEST(udUnrolledArrayTests, MatchesChunkedArray)
+{
+  // Random edits give the same result as the shuffling udChunkedArray implementation
+  udUnrolledArray<uint32_t> array;
+  udChunkedArray<uint32_t> reference;
+  ASSERT_EQ(udR_Success, array.Init(16));
+  ASSERT_EQ(udR_Success, reference.Init(16));
+
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < 20000; ++i)
+  {
+    seed = seed * 1664525 + 1013904223;
+    uint32_t op = (seed >> 24) % 8;
+    size_t index = reference.length ? (seed >> 4) % (reference.length + 1) : 0;
+
+    if (op < 5 || reference.length == 0)
+    {
+      ASSERT_EQ(udR_Success, array.Insert(index, &i));
+      ASSERT_EQ(udR_Success, reference.Insert(index, &i));
+    }
+    else
+    {
+      index = index % reference.length;
+      array.RemoveAt(index);
+      reference.RemoveAt(index);
+    }
+
+    // The count tree is only partly rebuilt on splits and merges, check it still matches the chunk counts
+    if (i % 1000 == 0)
+    {
+      size_t countBefore = 0;
+      for (size_t c = 0; c < array.chunkCount; ++c)
+      {
+        ASSERT_EQ(countBefore, array.CountBefore(c));
+        countBefore += array.pChunks[c].count;
+      }
+      ASSERT_EQ(array.length, countBefore);
+    }
+  }
+
+  ASSERT_EQ(reference.length, array.length);
+  size_t wrongCount = 0;
+  for (size_t i = 0; i < reference.length; ++i)
+    wrongCount += (array[i] != reference[i]);
+  EXPECT_EQ(0u, wrongCount);
+
+  // Walking contiguous runs visits every element once
+  size_t visited = 0;
+  for (size_t i = 0; i < array.length; i += array.GetElementRunLength(i))
+    visited += array.GetElementRunLength(i);
+  EXPECT_EQ(array.length, visited);
+
+  // Chunks don't become too sparse
+  EXPECT_GE(array.chunkCount * 16, array.length);
+  EXPECT_LE(array.chunkCount * 4, array.length);
+
+  reference.Deinit();
+  array.Deinit();
+}
@@ -116,3 +116,432 @@ TEST(udWorkerPoolTests, Validate)
   udWorkerPool_Destroy(&pPool);
   udWorkerPool_Destroy(nullptr);
 }
+
+struct WorkerStealTestData
+{
+  udWorkerPool *pPool;
+  volatile int32_t *pCounter;
+};
+
+void StealTestIncrement(void *pDataPtr)
+{
+  WorkerStealTestData *pData = (WorkerStealTestData*)pDataPtr;
+  udInterlockedPreIncrement(pData->pCounter);
+}
+
+void StealTestSpawn(void *pDataPtr)
+{
+  WorkerStealTestData *pData = (WorkerStealTestData*)pDataPtr;
+
+  // These are queued on the current worker and must be stolen by the others to spread out
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pData->pPool, StealTestIncrement, pData, false));
+
+  udInterlockedPreIncrement(pData->pCounter);
+}
+
+struct WorkerStealCheckData
+{
+  udWorkerPool *pPool;
+  int *pSpawnThread; // Address of the spawning worker's s_stealTestThreadMarker
+  volatile int32_t childrenRun;
+  volatile int32_t stolenCount;
+};
+
+static UDTHREADLOCAL int s_stealTestThreadMarker; // Only the address is used, it's different on every thread
+
+void StealCheckChild(void *pDataPtr)
+{
+  WorkerStealCheckData *pData = (WorkerStealCheckData*)pDataPtr;
+  if (&s_stealTestThreadMarker != pData->pSpawnThread)
+    udInterlockedPreIncrement(&pData->stolenCount);
+  udInterlockedPreIncrement(&pData->childrenRun);
+}
+
+void StealCheckSpawn(void *pDataPtr)
+{
+  WorkerStealCheckData *pData = (WorkerStealCheckData*)pDataPtr;
+  pData->pSpawnThread = &s_stealTestThreadMarker;
+
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pData->pPool, StealCheckChild, pData, false));
+
+  // The children are on this worker's queue and it stays busy here, so any child that runs in the meantime was stolen
+  uint64_t start = udPerfCounterStart();
+  while (pData->stolenCount == 0 && udPerfCounterMilliseconds(start) < 5000.f)
+    udYield();
+}
+
+TEST(udWorkerPoolTests, WorkStealing)
+{
+  udWorkerPool *pPool = nullptr;
+  volatile int32_t counter = 0;
+
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udWorkerPoolStealTest"));
+
+  WorkerStealTestData data;
+  data.pPool = pPool;
+  data.pCounter = &counter;
+
+  const int OuterTasks = 50;
+  for (int i = 0; i < OuterTasks; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, StealTestSpawn, &data, false));
+
+  while (udWorkerPool_HasActiveWorkers(pPool))
+    udYield();
+
+  EXPECT_EQ(OuterTasks * 11, counter);
+  EXPECT_EQ(udR_NothingToDo, udWorkerPool_DoPostWork(pPool));
+
+  WorkerStealCheckData checkData = {};
+  checkData.pPool = pPool;
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, StealCheckSpawn, &checkData, false));
+  EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pPool));
+
+  EXPECT_EQ(10, checkData.childrenRun);
+  EXPECT_GT(checkData.stolenCount, 0);
+
+  udWorkerPool_Destroy(&pPool);
+}
+
+TEST(udWorkerPoolTests, AddTasks)
+{
+  udWorkerPool *pPool = nullptr;
+  volatile int32_t counter = 0;
+
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udWorkerPoolBatchTest"));
+
+  WorkerStealTestData data;
+  data.pPool = pPool;
+  data.pCounter = &counter;
+
+  const int BatchSize = 1000;
+  udWorkerPoolTaskDesc *pTasks = udAllocType(udWorkerPoolTaskDesc, BatchSize, udAF_Zero);
+  ASSERT_NE(nullptr, pTasks);
+  udWorkerPoolCallback spawnFunc = StealTestSpawn;
+  udWorkerPoolCallback incrementFunc = StealTestIncrement;
+  for (int i = 0; i < BatchSize; ++i)
+  {
+    pTasks[i].function = (i % 100 == 0) ? spawnFunc : incrementFunc;
+    pTasks[i].pUserData = &data;
+    pTasks[i].clearMemory = false;
+    if (i % 2 == 0)
+      pTasks[i].postFunction = incrementFunc;
+  }
+
+  EXPECT_EQ(udR_InvalidParameter_, udWorkerPool_AddTasks(nullptr, pTasks, BatchSize));
+  EXPECT_EQ(udR_InvalidParameter_, udWorkerPool_AddTasks(pPool, nullptr, BatchSize));
+  EXPECT_EQ(udR_InvalidParameter_, udWorkerPool_AddTasks(pPool, pTasks, 0));
+
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTasks(pPool, pTasks, BatchSize));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTasks(pPool, pTasks, 3)); // Fewer tasks than threads
+
+  while (udWorkerPool_HasActiveWorkers(pPool))
+    udYield();
+
+  // Each spawning task adds 10 more
+  EXPECT_EQ(BatchSize + 3 + 11 * 10, counter);
+
+  EXPECT_EQ(udR_Success, udWorkerPool_DoPostWork(pPool));
+  EXPECT_EQ(BatchSize + 3 + 11 * 10 + BatchSize / 2 + 2, counter);
+
+  udFree(pTasks);
+  udWorkerPool_Destroy(&pPool);
+}
+
+struct WorkerPriorityTestData
+{
+  udSemaphore *pBlockSema;
+  volatile int32_t *pOrderCounter;
+  int order;
+};
+
+void PriorityTestBlock(void *pDataPtr)
+{
+  WorkerPriorityTestData *pData = (WorkerPriorityTestData*)pDataPtr;
+  udInterlockedPreIncrement(pData->pOrderCounter);
+  udWaitSemaphore(pData->pBlockSema);
+}
+
+void PriorityTestRecordOrder(void *pDataPtr)
+{
+  WorkerPriorityTestData *pData = (WorkerPriorityTestData*)pDataPtr;
+  pData->order = udInterlockedPostIncrement(pData->pOrderCounter);
+}
+
+TEST(udWorkerPoolTests, PriorityAndCancel)
+{
+  udWorkerPool *pPool = nullptr;
+  volatile int32_t orderCounter = 0;
+  udWorkerPoolTaskHandle *pHandle = nullptr;
+
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 1, "udWorkerPoolPriorityTest"));
+
+  volatile int32_t blockerStarted = 0;
+  WorkerPriorityTestData blocker = {};
+  blocker.pBlockSema = udCreateSemaphore();
+  blocker.pOrderCounter = &blockerStarted;
+
+  const int HighCount = 20;
+  WorkerPriorityTestData low = {}, normal = {}, cancelled = {};
+  WorkerPriorityTestData high[HighCount] = {};
+  low.pOrderCounter = normal.pOrderCounter = cancelled.pOrderCounter = &orderCounter;
+  cancelled.order = -1;
+
+  // Hold the only worker so everything else is queued before anything runs
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestBlock, &blocker, false));
+  while (blockerStarted == 0)
+    udYield();
+
+  EXPECT_EQ(udR_InvalidParameter_, udWorkerPool_AddTask(pPool, PriorityTestRecordOrder, &low, false, nullptr, udWPP_Count));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestRecordOrder, &low, false, nullptr, udWPP_Low));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestRecordOrder, &normal, false, nullptr, udWPP_Normal));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestRecordOrder, &cancelled, false, PriorityTestRecordOrder, udWPP_Normal, &pHandle));
+  for (int i = 0; i < HighCount; ++i)
+  {
+    high[i].pOrderCounter = &orderCounter;
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestRecordOrder, &high[i], false, nullptr, udWPP_High));
+  }
+
+  ASSERT_NE(nullptr, pHandle);
+  EXPECT_EQ(udR_Success, udWorkerPool_CancelTask(pHandle));
+  EXPECT_EQ(udR_NothingToDo, udWorkerPool_CancelTask(pHandle));
+  udWorkerPool_ReleaseTaskHandle(&pHandle);
+  EXPECT_EQ(nullptr, pHandle);
+
+  udIncrementSemaphore(blocker.pBlockSema);
+  while (udWorkerPool_HasActiveWorkers(pPool))
+    udYield();
+
+  EXPECT_EQ(HighCount + 2, orderCounter);
+  EXPECT_EQ(-1, cancelled.order);
+  EXPECT_EQ(udR_NothingToDo, udWorkerPool_DoPostWork(pPool)); // Post function of the cancelled task isn't run either
+
+  // High priority tasks are mostly served first, but the lower lanes still get a turn before they're all done
+  EXPECT_EQ(0, high[0].order);
+  EXPECT_LT(normal.order, HighCount);
+  EXPECT_LT(low.order, HighCount);
+
+  // Too late to cancel once it has run
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestRecordOrder, &cancelled, false, nullptr, udWPP_Normal, &pHandle));
+  while (udWorkerPool_HasActiveWorkers(pPool))
+    udYield();
+  EXPECT_EQ(udR_NothingToDo, udWorkerPool_CancelTask(pHandle));
+  EXPECT_EQ(HighCount + 2, cancelled.order);
+  udWorkerPool_ReleaseTaskHandle(&pHandle);
+
+  udWorkerPool_Destroy(&pPool);
+  udDestroySemaphore(&blocker.pBlockSema);
+}
+
+TEST(udWorkerPoolTests, Dependencies)
+{
+  udWorkerPool *pPool = nullptr;
+  volatile int32_t orderCounter = 0;
+  volatile int32_t blockerStarted = 0;
+
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udWorkerPoolDependencyTest"));
+
+  // Diamond: top -> (left, right) -> bottom
+  WorkerPriorityTestData top = {}, left = {}, right = {}, bottom = {};
+  top.pOrderCounter = left.pOrderCounter = right.pOrderCounter = bottom.pOrderCounter = &orderCounter;
+
+  WorkerPriorityTestData blocker = {};
+  blocker.pBlockSema = udCreateSemaphore();
+  blocker.pOrderCounter = &blockerStarted;
+
+  udWorkerPoolTaskHandle *pTop = nullptr;
+  udWorkerPoolTaskHandle *pSides[2] = {};
+  udWorkerPoolTaskHandle *pBottom = nullptr;
+
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestBlock, &blocker, false, nullptr, udWPP_Normal, &pTop));
+  EXPECT_EQ(udR_InvalidParameter_, udWorkerPool_AddDependentTask(pPool, nullptr, 1, PriorityTestRecordOrder, &left, false));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddDependentTask(pPool, &pTop, 1, PriorityTestRecordOrder, &left, false, nullptr, udWPP_Normal, &pSides[0]));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddDependentTask(pPool, &pTop, 1, PriorityTestRecordOrder, &right, false, nullptr, udWPP_Normal, &pSides[1]));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddDependentTask(pPool, pSides, 2, PriorityTestRecordOrder, &bottom, false, nullptr, udWPP_Normal, &pBottom));
+  udWorkerPool_ReleaseTaskHandle(&pSides[0]);
+  udWorkerPool_ReleaseTaskHandle(&pSides[1]);
+
+  // Nothing downstream can run while the top task is held
+  while (blockerStarted == 0)
+    udYield();
+  udSleep(10);
+  EXPECT_EQ(0, orderCounter);
+
+  udIncrementSemaphore(blocker.pBlockSema);
+  while (udWorkerPool_HasActiveWorkers(pPool))
+    udYield();
+
+  EXPECT_EQ(3, orderCounter);
+  EXPECT_LT(left.order, 2);
+  EXPECT_LT(right.order, 2);
+  EXPECT_EQ(2, bottom.order);
+  EXPECT_EQ(udR_NothingToDo, udWorkerPool_CancelTask(pBottom));
+
+  // Predecessors that have already completed don't hold the task back
+  EXPECT_EQ(udR_Success, udWorkerPool_AddDependentTask(pPool, &pBottom, 1, PriorityTestRecordOrder, &top, false));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddDependentTask(pPool, nullptr, 0, PriorityTestRecordOrder, &left, false));
+  while (udWorkerPool_HasActiveWorkers(pPool))
+    udYield();
+  EXPECT_EQ(5, orderCounter);
+  udWorkerPool_ReleaseTaskHandle(&pBottom);
+  udWorkerPool_ReleaseTaskHandle(&pTop);
+
+  // Cancelling a predecessor cancels everything downstream of it
+  blockerStarted = 0;
+  top.order = left.order = right.order = -1;
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestBlock, &blocker, false));
+  for (int i = 0; i < 3; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestBlock, &blocker, false)); // Occupy every worker
+  while (blockerStarted < 4)
+    udYield();
+
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestRecordOrder, &top, false, nullptr, udWPP_Normal, &pTop));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddDependentTask(pPool, &pTop, 1, PriorityTestRecordOrder, &left, false, nullptr, udWPP_Normal, &pSides[0]));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddDependentTask(pPool, pSides, 1, PriorityTestRecordOrder, &right, false, PriorityTestRecordOrder));
+  EXPECT_EQ(udR_Success, udWorkerPool_CancelTask(pTop));
+
+  udIncrementSemaphore(blocker.pBlockSema, 4);
+  while (udWorkerPool_HasActiveWorkers(pPool))
+    udYield();
+
+  EXPECT_EQ(-1, top.order);
+  EXPECT_EQ(-1, left.order);
+  EXPECT_EQ(-1, right.order);
+  EXPECT_EQ(udR_NothingToDo, udWorkerPool_DoPostWork(pPool));
+
+  udWorkerPool_ReleaseTaskHandle(&pSides[0]);
+  udWorkerPool_ReleaseTaskHandle(&pTop);
+
+  udWorkerPool_Destroy(&pPool);
+  udDestroySemaphore(&blocker.pBlockSema);
+}
+
+void GroupTestIncrement(void *pDataPtr)
+{
+  udSleep(1);
+  udInterlockedPreIncrement((volatile int32_t*)pDataPtr);
+}
+
+TEST(udWorkerPoolTests, TaskGroups)
+{
+  udWorkerPool *pPool = nullptr;
+  udWorkerPoolTaskGroup *pGroupA = nullptr;
+  udWorkerPoolTaskGroup *pGroupB = nullptr;
+  volatile int32_t countA = 0;
+  volatile int32_t blockerStarted = 0;
+
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udWorkerPoolGroupTest"));
+  ASSERT_EQ(udR_Success, udWorkerPool_CreateTaskGroup(&pGroupA));
+  ASSERT_EQ(udR_Success, udWorkerPool_CreateTaskGroup(&pGroupB));
+  EXPECT_EQ(udR_InvalidParameter_, udWorkerPool_JoinTaskGroup(nullptr));
+  EXPECT_EQ(udR_Success, udWorkerPool_JoinTaskGroup(pGroupA)); // Empty group
+
+  WorkerPriorityTestData blocker = {};
+  blocker.pBlockSema = udCreateSemaphore();
+  blocker.pOrderCounter = &blockerStarted;
+
+  // Group B can't finish until the blocker is released, which shouldn't hold up group A
+  udWorkerPoolTaskHandle *pBlocker = nullptr;
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, PriorityTestBlock, &blocker, false, nullptr, udWPP_Normal, &pBlocker, pGroupB));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddDependentTask(pPool, &pBlocker, 1, GroupTestIncrement, (void*)&countA, false, nullptr, udWPP_Normal, nullptr, pGroupB));
+  udWorkerPool_ReleaseTaskHandle(&pBlocker);
+
+  udWorkerPoolTaskDesc tasks[3];
+  udWorkerPoolCallback incrementFunc = GroupTestIncrement;
+  for (int i = 0; i < 3; ++i)
+  {
+    tasks[i].function = incrementFunc;
+    tasks[i].pUserData = (void*)&countA;
+    tasks[i].clearMemory = false;
+  }
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, incrementFunc, (void*)&countA, false, nullptr, udWPP_Normal, nullptr, pGroupA));
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTasks(pPool, tasks, 3, udWPP_Normal, nullptr, pGroupA));
+
+  EXPECT_EQ(udR_Success, udWorkerPool_JoinTaskGroup(pGroupA));
+  EXPECT_EQ(13, countA);
+
+  EXPECT_EQ(udR_Timeout, udWorkerPool_JoinTaskGroup(pGroupB, 10));
+  EXPECT_EQ(udR_Timeout, udWorkerPool_WaitForIdle(pPool, 0));
+  EXPECT_EQ(13, countA);
+
+  udIncrementSemaphore(blocker.pBlockSema);
+  EXPECT_EQ(udR_Success, udWorkerPool_JoinTaskGroup(pGroupB));
+  EXPECT_EQ(14, countA);
+  EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pPool));
+  EXPECT_FALSE(udWorkerPool_HasActiveWorkers(pPool));
+
+  udWorkerPool_DestroyTaskGroup(&pGroupA);
+  udWorkerPool_DestroyTaskGroup(&pGroupB);
+  EXPECT_EQ(nullptr, pGroupA);
+
+  udWorkerPool_Destroy(&pPool);
+  udDestroySemaphore(&blocker.pBlockSema);
+}
+
+TEST(udWorkerPoolTests, IdleWakeAndShutdown)
+{
+  udWorkerPool *pPool = nullptr;
+  volatile int32_t counter = 0;
+  udWorkerPoolCallback incrementFunc = GroupTestIncrement;
+
+  // Without spinning every task has to wake a sleeping thread
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, 4, "udWorkerPoolIdleTest"));
+  udWorkerPool_SetIdleSpinCount(pPool, 0);
+  for (int round = 0; round < 5; ++round)
+  {
+    udSleep(5); // Let the threads go back to sleep
+    for (int i = 0; i < 4; ++i)
+      EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, incrementFunc, (void*)&counter, false));
+    EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pPool));
+  }
+  EXPECT_EQ(20, counter);
+
+  udWorkerPool_SetIdleSpinCount(pPool, 100000);
+  EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, incrementFunc, (void*)&counter, false));
+  EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pPool));
+  EXPECT_EQ(21, counter);
+
+  // Sleeping threads are woken for shutdown rather than polling for it, parked threads have no timeout so Destroy would never return otherwise
+  udSleep(10);
+  udWorkerPool_Destroy(&pPool);
+  EXPECT_EQ(nullptr, pPool);
+}
+
+TEST(udWorkerPoolTests, Placement)
+{
+  udWorkerPool *pPool = nullptr;
+  udWorkerPoolOptions options;
+  udHardwareTopology topology;
+  volatile int32_t counter = 0;
+  udWorkerPoolCallback incrementFunc = GroupTestIncrement;
+
+  udGetHardwareThreadCount(&topology);
+
+  // One pinned thread per physical core
+  options.pinThreads = true;
+  ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, (uint8_t)udMin(topology.physicalCoreCount, 255), "udWorkerPoolPinnedTest", &options));
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, incrementFunc, (void*)&counter, false));
+  EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pPool));
+  EXPECT_EQ(10, counter);
+  udWorkerPool_Destroy(&pPool);
+
+  // Restricted to a node, with more threads than it has processors
+  options.pinThreads = false;
+  options.numaNode = 0;
+  int nodeProcessor = -1;
+  if (udGetHardwareProcessors(&nodeProcessor, 1, 0) == 1)
+  {
+    ASSERT_EQ(udR_Success, udWorkerPool_Create(&pPool, (uint8_t)udMin(topology.logicalProcessorCount + 1, 255), "udWorkerPoolNodeTest", &options));
+    EXPECT_EQ(udR_Success, udWorkerPool_AddTask(pPool, incrementFunc, (void*)&counter, false));
+    EXPECT_EQ(udR_Success, udWorkerPool_WaitForIdle(pPool));
+    EXPECT_EQ(11, counter);
+    udWorkerPool_Destroy(&pPool);
+  }
+
+  options.numaNode = 1 << 20;
+  EXPECT_EQ(udR_InvalidConfiguration, udWorkerPool_Create(&pPool, 1, "udWorkerPoolNoNodeTest", &options));
+  EXPECT_EQ(nullptr, pPool);
+}